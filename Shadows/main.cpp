@@ -11,8 +11,10 @@
 #include <glm/ext/matrix_transform.hpp>
 #include <glm/ext/matrix_clip_space.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/matrix_access.hpp>
 #include <glm/trigonometric.hpp>
 #include <glm/gtx/quaternion.hpp>
+#include <glm/gtc/packing.hpp>
 
 #include <iostream>
 #include <fstream>
@@ -20,12 +22,29 @@
 #include <string>
 #include <vector>
 #include <chrono>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <unordered_map>
+#include <map>
+#include <atomic>
+#include <cstring>
+#include <climits>
+#include <tuple>
+#include <random>
 
 #include "imgui.h"
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "imstb_rectpack.h"
 #include "imgui/backends/imgui_impl_glfw.h"
 #include "imgui/backends/imgui_impl_opengl3.h"
 
 #ifndef _WIN
+#define NOMINMAX
 #include <windows.h>
 extern "C" {
 	_declspec(dllexport) DWORD NvOptimusEnablement = 1;
@@ -33,6 +52,17 @@ extern "C" {
 }
 #endif
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+//NOMINMAX keeps glm::min and glm::max working, the plain calls use the standard ones
+using std::min;
+using std::max;
+
 static const int ONE_SECOND = 1000 * 1000 * 1000;
 
 static const int MODE_NORMAL = 0;
@@ -44,6 +74,120 @@ static const int SAMPLING_MODE_GRID = 0;
 static const int SAMPLING_MODE_POISSON = 1;
 static const int SAMPLING_MODE_VOGEL = 2;
 
+static const int MAX_CASCADE_COUNT = 8;
+
+static const int VIRTUAL_SHADOW_MAP_RESOLUTION = 16384;
+static const int VIRTUAL_PAGE_SIZE = 128;
+static const int VIRTUAL_PAGE_COUNT = VIRTUAL_SHADOW_MAP_RESOLUTION / VIRTUAL_PAGE_SIZE;
+//the physical pool is a square of pages
+static const int PHYSICAL_PAGE_COUNT = 32;
+static const GLuint INVALID_PAGE = 0xFFFFFFFFu;
+
+static const int LIGHT_TYPE_DIRECTIONAL = 0;
+static const int LIGHT_TYPE_SPOT = 1;
+static const int LIGHT_TYPE_POINT = 2;
+
+static const int SHADOW_ATLAS_SIZE = 4096;
+static const int SHADOW_ATLAS_MIN_TILE_SIZE = 64;
+//the tiles rendered by one draw, each has its own viewport
+static const int SHADOW_ATLAS_VIEWPORT_COUNT = 16;
+
+static const int POINT_SHADOW_MAP_RESOLUTION = 512;
+//the cube map array has a cube for this many point lights
+static const int POINT_SHADOW_MAP_COUNT = 8;
+
+//the view frustum is split into froxels, the depth slices are exponential
+static const int CLUSTER_COUNT_X = 16;
+static const int CLUSTER_COUNT_Y = 9;
+static const int CLUSTER_COUNT_Z = 24;
+static const int CLUSTER_COUNT = CLUSTER_COUNT_X * CLUSTER_COUNT_Y * CLUSTER_COUNT_Z;
+//the light index list has room for this many lights per cluster on average
+static const int LIGHT_INDEX_CAPACITY = CLUSTER_COUNT * 32;
+
+static const char COOKED_MESH_MAGIC[4] = {'M', 'E', 'S', 'H'};
+static const GLuint COOKED_MESH_VERSION = 6;
+//the streams start at multiples of this, so they can be uploaded straight from the mapped file
+static const int COOKED_MESH_ALIGNMENT = 64;
+static const GLuint COOKED_VERTEX_FORMAT_FLOAT = 0;
+static const GLuint COOKED_VERTEX_FORMAT_QUANTIZED = 1;
+//a flat mesh still gets an invertible dequantization
+static const float MIN_QUANTIZATION_EXTENT = 0.000001f;
+//the post transform cache the meshes are optimized for and measured with
+static const int VERTEX_CACHE_SIZE = 16;
+static const int MAX_MESH_LOD_COUNT = 4;
+//a mesh with fewer triangles isn't simplified further
+static const int MIN_LOD_TRIANGLE_COUNT = 64;
+//the usual mesh shader limits, so the same meshlets would work with mesh shaders too
+static const int MESHLET_MAX_VERTEX_COUNT = 64;
+static const int MESHLET_MAX_TRIANGLE_COUNT = 124;
+
+static const GLuint GLB_MAGIC = 0x46546C67;
+static const GLuint GLB_CHUNK_JSON = 0x4E4F534A;
+static const GLuint GLB_CHUNK_BIN = 0x004E4942;
+
+static const int JSON_TYPE_NULL = 0;
+static const int JSON_TYPE_BOOL = 1;
+static const int JSON_TYPE_NUMBER = 2;
+static const int JSON_TYPE_STRING = 3;
+static const int JSON_TYPE_ARRAY = 4;
+static const int JSON_TYPE_OBJECT = 5;
+
+static const int ASSET_STATE_LOADING = 0;
+static const int ASSET_STATE_IMPORTED = 1;
+static const int ASSET_STATE_UPLOADING = 2;
+static const int ASSET_STATE_RESIDENT = 3;
+static const int ASSET_STATE_FAILED = 4;
+static const int ASSET_STATE_UNLOADED = 5;
+//the assimp post processing of a mesh is part of its key, the same file imported differently is another mesh
+//identical meshes under different nodes are found, so they are cooked once
+static const unsigned int DEFAULT_MESH_IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_FindInstances;
+//the unreferenced meshes are evicted when the meshes' buffers take more than this
+static const GLsizeiptr DEFAULT_MESH_GPU_BUDGET = 256 * 1024 * 1024;
+//the imported meshes are copied through this, a bigger mesh is uploaded directly
+static const GLsizeiptr STAGING_BUFFER_SIZE = 8 * 1024 * 1024;
+//the imports run on their own threads, so a slow file doesn't stall the parallel loops of the frame
+static const int ASSET_WORKER_COUNT = 2;
+
+//a scene is a text manifest of meshes and a binary file of instances
+static const char SCENE_INSTANCES_MAGIC[4] = {'I', 'N', 'S', 'T'};
+static const GLuint SCENE_INSTANCES_VERSION = 1;
+static const GLuint SCENE_INSTANCE_FLAG_STATIC = 1;
+static const GLuint SCENE_INSTANCE_FLAG_SHADOW_CASTER = 2;
+//only set in the gpu copy of a loaded scene, the instance was turned into a renderable
+static const GLuint SCENE_INSTANCE_FLAG_EDITED = 4;
+//the instances of a mesh in a loaded scene are sorted into these ranges, so a shadow pass draws only its casters
+static const int SCENE_STORE_RANGE_RECEIVER = 0;
+static const int SCENE_STORE_RANGE_STATIC_CASTER = 1;
+static const int SCENE_STORE_RANGE_DYNAMIC_CASTER = 2;
+static const int SCENE_STORE_RANGE_COUNT = 3;
+static const int SCENE_LAYOUT_GRID = 0;
+static const int SCENE_LAYOUT_CLUSTERED = 1;
+static const int SCENE_LAYOUT_CITY = 2;
+static const int MIN_GENERATED_INSTANCE_COUNT = 10;
+static const int MAX_GENERATED_INSTANCE_COUNT = 1000000;
+//the world is split into square cells on the xz plane, the cells near the player are streamed in
+static const float STREAM_CELL_SIZE = 64.0f;
+static const int STREAM_CELLS_PER_FRAME = 4;
+static const GLsizeiptr DEFAULT_STREAMING_BUDGET = 128 * 1024 * 1024;
+static const int CELL_STATE_UNLOADED = 0;
+static const int CELL_STATE_LOADING = 1;
+static const int CELL_STATE_RESIDENT = 2;
+
+static const int GPU_CATEGORY_SHADOW_TARGETS = 0;
+static const int GPU_CATEGORY_SCENE_TARGETS = 1;
+static const int GPU_CATEGORY_MESHES = 2;
+static const int GPU_CATEGORY_BUFFERS = 3;
+static const int GPU_CATEGORY_COUNT = 4;
+//the render targets, the meshes and the buffers together, more is an error
+static const GLsizeiptr DEFAULT_GPU_MEMORY_BUDGET = 1024LL * 1024 * 1024;
+//a free render target unused for this many frames is deleted, the ones a settings change leaves behind are deleted right away
+static const int RENDER_TARGET_IDLE_FRAME_COUNT = 300;
+
+static const std::string CAMERA_PATH_PATH = "res/camera_path.txt";
+static const std::string SHADOW_PROFILE_PATH = "res/shadow_profile.txt";
+//the scaling benchmark saves every generated scene here and loads it back, so it measures the scene files' load path
+static const std::string BENCHMARK_SCENE_PATH = "res/benchmark.scene";
+
 static const glm::vec4 NDC_FRUSTUM_CORNER_POINTS[] = {
 	glm::vec4(-1, 1, 1, 1),
 	glm::vec4(1, 1, 1, 1),
@@ -65,17 +209,353 @@ struct time_handler_type {
 	double delta_time = 0.0;
 };
 
+//the lods of a mesh share its vertices, each is a range of the index buffer
+struct mesh_lod_type {
+	GLuint first_index = 0;
+	GLuint index_count = 0;
+	//the square root of the largest quadric error of a collapse, the summed squared distances to the merged vertices' planes, in the mesh's space
+	float error = 0.0f;
+	//the meshlets of the lod cover the same index range
+	GLuint first_meshlet = 0;
+	GLuint meshlet_count = 0;
+	GLuint padding[3] = {};
+};
+
+//a small cluster of consecutive triangles of a lod, the compute culling works with these
+struct meshlet_type {
+	//the bounding sphere and the normal cone are in the mesh's space before the quantization
+	glm::vec4 sphere = glm::vec4(0.0);
+	//the cone's axis and the sine of its angle, 1 or more if the triangles can't all face away at once
+	glm::vec4 cone = glm::vec4(0.0, 0.0, 0.0, 1.0);
+	GLuint first_index = 0;
+	GLuint index_count = 0;
+	GLuint padding[2] = {};
+};
+
 struct mesh_type {
 	GLuint vao = 0;
+	//the same buffers with only the positions, for the shadow passes
+	GLuint shadow_vao = 0;
+	GLsizei index_count = 0;
+	GLenum index_type = GL_UNSIGNED_INT;
+	glm::vec3 aabb_min = glm::vec3(0.0);
+	glm::vec3 aabb_max = glm::vec3(0.0);
+	//maps the quantized positions to the mesh's space, the aabb is in the quantized space
+	glm::mat4 dequantization = glm::mat4(1.0);
+	//0 if the mesh wasn't cooked, then it's drawn without meshlet culling
+	GLuint meshlet_buffer = 0;
+	//the meshes of a scene share the buffers, their indices are relative to their first vertex
+	GLint base_vertex = 0;
+	int lod_count = 1;
+	mesh_lod_type lods[MAX_MESH_LOD_COUNT];
+};
+
+//a cooked mesh file starts with this, followed by the position, normal, index, meshlet, submesh, and instance streams
+struct cooked_mesh_header_type {
+	char magic[4];
+	GLuint version;
+	//the hash of the source file the mesh was cooked from
+	unsigned long long source_hash;
+	GLuint vertex_count;
+	GLuint index_count;
+	//byte offsets from the start of the file
+	GLuint position_offset;
+	GLuint normal_offset;
+	GLuint index_offset;
+	GLuint meshlet_offset;
+	GLuint submesh_offset;
+	GLuint instance_offset;
+	GLuint vertex_format;
+	GLuint meshlet_count;
+	GLuint submesh_count;
+	GLuint instance_count;
+};
+
+//one mesh of a cooked scene, its vertices, indices, and meshlets are ranges of the shared streams
+struct cooked_submesh_type {
+	glm::vec3 aabb_min;
+	glm::vec3 aabb_max;
+	GLint base_vertex;
+	GLuint vertex_count;
+	GLuint lod_count;
+	GLuint padding;
+	mesh_lod_type lods[MAX_MESH_LOD_COUNT];
+};
+
+//a placement of a mesh, the node graph of a scene is flattened into these
+struct mesh_instance_type {
+	glm::mat4 transform = glm::mat4(1.0);
+	GLuint mesh = 0;
+	GLuint padding[3] = {};
+};
+
+struct scene_instances_header_type {
+	char magic[4];
+	GLuint version;
+	GLuint instance_count;
+	GLuint padding;
+};
+
+//a renderable in a scene file, the mesh indexes the manifest's mesh list
+struct scene_instance_type {
+	glm::vec3 position;
+	glm::quat rotation;
+	glm::vec3 scale;
+	GLuint color;
+	GLuint flags;
+	GLuint mesh;
+	GLint mesh_instance;
+};
+
+struct scene_settings_type {
+	int layout = SCENE_LAYOUT_GRID;
+	int instance_count = 1000;
+	int seed = 1;
+	//the fraction of the generated instances casting shadows, all of them receive shadows
+	float caster_density = 1.0f;
+	float spacing = 4.0f;
+	//moves the dynamic shadow casters, so the cached static shadows can be checked against them
+	bool spin_dynamic_renderables = false;
+	char path[256] = "res/stress.scene";
+	//command line
+	std::string load_path;
+	bool generate = false;
+	std::string save_path;
+	//stats
+	double load_time = 0.0;
+};
+
+//a labelled gl object, the vertex arrays, framebuffers and texture views hold no memory of their own
+struct gpu_resource_type {
+	GLenum type = GL_NONE;
+	std::string name;
+	int category = GPU_CATEGORY_BUFFERS;
+	GLenum format = GL_NONE;
+	std::string usage;
+	GLsizeiptr size = 0;
+};
+
+struct gpu_memory_registry_type {
+	//object type and name to resource
+	std::unordered_map<long long, gpu_resource_type> resources;
+	GLsizeiptr category_sizes[GPU_CATEGORY_COUNT] = {};
+	GLsizeiptr size = 0;
+	GLsizeiptr peak_size = 0;
+	//the free pooled render targets count too, the pool only keeps the ones the current settings can acquire, see trim_render_target_pool
+	GLsizeiptr budget = DEFAULT_GPU_MEMORY_BUDGET;
+	//a budget given on the command line ends the program when it's exceeded
+	bool strict = false;
+	bool over_budget = false;
+};
+
+//the textures with the same key are interchangeable
+struct render_target_key_type {
+	glm::ivec2 size = glm::ivec2(0);
+	//0 for a 2d texture, the number of layers for an array
+	GLsizei layers = 0;
+	GLenum format = GL_NONE;
+	GLsizei mip_count = 1;
+};
+
+struct pooled_render_target_type {
+	render_target_key_type key;
+	GLuint texture = 0;
+	//the label and the sampling of the last user, a user acquiring it every frame doesn't set them again
+	std::string name;
+	bool border = false;
+	bool in_use = false;
+	int last_used_frame = 0;
+};
+
+struct render_target_pool_type {
+	std::vector<pooled_render_target_type> targets;
+	int frame = 0;
+	//stats
+	int allocation_count = 0;
+	int reuse_count = 0;
+};
+
+struct mapped_file_type {
+	const char* data = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+#else
+	int file = -1;
+#endif
+};
+
+//a loaded scene file, the mapped instances are copied to the gpu as they are and drawn per mesh, they only become renderables when they are edited
+struct scene_store_type {
+	mapped_file_type file;
+	const scene_instance_type* instances = nullptr;
+	GLuint instance_count = 0;
+	//the manifest's meshes, each holds a reference while the scene is loaded
+	std::vector<int> mesh_assets;
+	std::vector<bool> pending_meshes;
+	int pending_mesh_count = 0;
+	//the instance indices sorted by mesh and range, the ranges of mesh i start at range_offsets[i * SCENE_STORE_RANGE_COUNT]
+	std::vector<GLuint> range_offsets;
+	//per mesh, the largest scale bounds the lod error of the static casters, and the mesh instances are checked when the mesh is resident
+	std::vector<float> max_scales;
+	std::vector<GLint> max_mesh_instances;
+	GLuint instance_buffer = 0;
+	GLuint index_buffer = 0;
+	//sorted, they are hidden on the gpu and saved as renderables
+	std::vector<GLuint> edited_instances;
+};
+
+//arrays only use the values, objects use the keys too
+struct json_value_type {
+	int type = JSON_TYPE_NULL;
+	double number = 0.0;
+	std::string string;
+	std::vector<std::string> keys;
+	std::vector<json_value_type> values;
+};
+
+struct glb_accessor_type {
+	int buffer_view = -1;
+	GLenum component_type = 0;
+	int component_count = 0;
+	int count = 0;
+	//the accessor's offset is relative to its buffer view, the view's offset is relative to the bin chunk
+	GLuint offset = 0;
+	GLuint view_offset = 0;
+	GLuint view_size = 0;
+	GLuint stride = 0;
+	bool has_bounds = false;
+	glm::vec3 min = glm::vec3(0.0);
+	glm::vec3 max = glm::vec3(0.0);
+};
+
+struct mesh_cache_type {
+	//without the cache every mesh is imported with assimp, to compare the startup times
+	bool enabled = true;
+	bool quantize_vertices = true;
+	//the asset workers count the meshes
+	std::atomic<int> glb_mesh_count{0};
+	std::atomic<int> cached_mesh_count{0};
+	std::atomic<int> imported_mesh_count{0};
+};
+
+//packed streams, the mesh optimizer works on these before cooking
+struct source_mesh_type {
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> normals;
+	std::vector<GLuint> indices;
+	std::vector<mesh_lod_type> lods;
+	std::vector<meshlet_type> meshlets;
+};
+
+struct source_scene_type {
+	std::vector<source_mesh_type> meshes;
+	std::vector<mesh_instance_type> instances;
+};
+
+struct quadric_type {
+	//the upper triangle of a symmetric 4x4 matrix: xx, xy, xz, xw, yy, yz, yw, zz, zw, ww
+	double values[10] = {};
+};
+
+struct mesh_simplifier_type {
+	std::vector<GLuint> indices;
+	std::vector<quadric_type> quadrics;
+	std::vector<bool> locked;
+	float error = 0.0f;
+};
+
+struct mesh_buffer_data_type {
+	const char* data = nullptr;
+	GLsizeiptr size = 0;
+};
+
+struct mesh_stream_type {
+	int buffer = 0;
+	GLintptr offset = 0;
+	GLsizei stride = 0;
+	GLint size = 3;
+	GLenum type = GL_FLOAT;
+	GLboolean normalized = GL_FALSE;
+};
+
+//an imported mesh before the upload, the buffers point into the mapped file or the cooked data
+struct mesh_data_type {
+	mapped_file_type mapped_file;
+	std::vector<char> cooked_data;
+	std::vector<mesh_buffer_data_type> buffers;
+	mesh_stream_type positions;
+	mesh_stream_type normals;
+	int index_buffer = 0;
+	int meshlet_buffer = -1;
+	GLsizei vertex_count = 0;
 	GLsizei index_count = 0;
+	GLenum index_type = GL_UNSIGNED_INT;
+	//the meshes get their vertex arrays and buffers when they are uploaded
+	std::vector<mesh_type> meshes;
+	std::vector<mesh_instance_type> instances;
 };
 
 struct renderable_type {
+	std::string name;
 	mesh_type mesh;
 	glm::vec3 position = glm::vec3(0.0);
 	glm::quat rotation = glm::angleAxis(0.0f, glm::vec3(1.0, 0.0, 0.0));
 	glm::vec3 scale = glm::vec3(1.0);
 	glm::vec3 diffuse_color = glm::vec3(0.5);
+	bool is_static = true;
+	bool casts_shadows = true;
+	//the renderable waits in the asset loader until this mesh is resident
+	int mesh_asset = -1;
+	//the asset's instance the renderable was created from, -1 places every instance of the asset
+	int mesh_instance = -1;
+	int lod = 0;
+	int shadow_lod = 0;
+	//the streamed cell the renderable belongs to, -1 if it's always resident
+	int cell = -1;
+};
+
+struct stream_cell_type {
+	std::vector<renderable_type> renderables;
+	//the renderables' positions, and their largest scale for the meshes around them
+	glm::vec3 aabb_min = glm::vec3(INFINITY);
+	glm::vec3 aabb_max = glm::vec3(-INFINITY);
+	float margin = 0.0f;
+	int state = CELL_STATE_UNLOADED;
+	int last_visible_frame = 0;
+};
+
+struct streaming_type {
+	bool enabled = false;
+	float load_radius = 200.0f;
+	//seconds of movement the cells are loaded ahead of the player
+	float lookahead = 1.0f;
+	//the gpu memory of the meshes' buffers, as counted by the asset loader, which is what evict_meshes works down to
+	GLsizeiptr budget = DEFAULT_STREAMING_BUDGET;
+	std::vector<stream_cell_type> cells;
+	std::unordered_map<unsigned long long, int> cell_keys;
+	glm::vec3 last_player_position = glm::vec3(0.0);
+	glm::vec3 velocity = glm::vec3(0.0);
+	//stats
+	int queue_depth = 0;
+	int resident_cell_count = 0;
+	int evicted_cell_count = 0;
+	GLsizeiptr bytes_in_flight = 0;
+	GLsizeiptr memory = 0;
+};
+
+struct lod_settings_type {
+	bool enabled = true;
+	//the allowed simplification error, in pixels for the camera and in shadow map texels for the shadows
+	float pixel_error = 1.0f;
+	float shadow_texel_error = 2.0f;
+	//a coarser lod is selected only below this fraction of the allowed error
+	float hysteresis = 0.25f;
+	//stats
+	long long triangle_count = 0;
+	long long shadow_triangle_count = 0;
+	long long full_triangle_count = 0;
 };
 
 struct player_type {
@@ -89,6 +569,24 @@ struct player_type {
 	glm::vec3 up = glm::vec3(0.0, 1.0, 0.0);
 	glm::mat4 view = glm::mat4(1.0);
 	glm::mat4 projection = glm::mat4(1.0);
+	float near_plane = 1.0;
+	float far_plane = 100.0;
+};
+
+struct cascade_type {
+	glm::mat4 view = glm::mat4(1.0);
+	glm::mat4 projection = glm::mat4(1.0);
+	//camera view space distances covered by the cascade
+	float split_near = 1.0;
+	float split_far = 100.0;
+	//pcss
+	float near_plane = 1.0;
+	float far_plane = 100.0;
+	float frustum_width = 100.0;
+	//stable fit
+	bool scrollable = false;
+	glm::ivec2 texel_origin = glm::ivec2(0);
+	float texel_size = 0.0;
 };
 
 struct light_type {
@@ -96,8 +594,10 @@ struct light_type {
 	glm::vec3 color = glm::vec3(1.0);
 	float size = 1.0;
 	float distance = 500.0;
-	glm::mat4 view = glm::mat4(1.0);
-	glm::mat4 projection = glm::mat4(1.0);
+	cascade_type cascades[MAX_CASCADE_COUNT];
+	//time of day, degrees per second
+	bool time_of_day = false;
+	float time_of_day_speed = 1.0;
 };
 
 struct window_type {
@@ -111,7 +611,22 @@ struct shadow_map_settings_type {
 	float bias = 0.003f;
 	float intensity = 0.5;
 	bool match_frustums = false;
+	bool stable_fit = true;
 	float scale = 1.0;
+	//cascades
+	int cascade_count = 4;
+	float cascade_split_lambda = 0.75;
+	float cascade_blend = 0.1f;
+	bool skip_contained_casters = false;
+	bool sdsm = false;
+	bool lispsm = false;
+	//virtual shadow map, the extent is the light space size it covers around the camera
+	bool virtual_shadow_map = false;
+	float virtual_shadow_map_extent = 512.0;
+	//amortized updates
+	bool amortized_updates = false;
+	int update_periods[MAX_CASCADE_COUNT] = {1, 2, 4, 4, 8, 8, 8, 8};
+	int max_updates_per_frame = 2;
 	//sampling
 	int sampling_mode = 0;
 	int grid_kernel_size = 5;
@@ -119,13 +634,379 @@ struct shadow_map_settings_type {
 	int vogel_sample_count = 25;
 	int gaussian_kernel_size = 5;
 	bool rotate_samples = false;
-	//pcss
-	float near_plane = 1.0;
-	float far_plane = 100.0;
-	float frustum_width = 100.0;
+	//multiplies the filter size the mode picks in set_scale
+	float filter_scale = 1.0;
 	//vsm
 	bool vsm_smoothstep_fix = false;
 	float vsm_smoothstep_fix_lower_bound = 0.1f;
+	//cache
+	bool cache_static_casters = true;
+	//dynamic resolution, the resolution above is the texture's size and the upper limit
+	bool dynamic_resolution = false;
+	float target_gpu_time = 8.0;
+	int min_resolution = 256;
+};
+
+struct shadow_cache_key_type {
+	glm::mat4 view = glm::mat4(1.0);
+	glm::mat4 projection = glm::mat4(1.0);
+	int resolution = 0;
+	int mode = -1;
+	int static_geometry_version = -1;
+	glm::ivec2 texel_origin = glm::ivec2(0);
+};
+
+struct shadow_composite_key_type {
+	float light_size = 0.0;
+	bool rotate_samples = false;
+	float scale = 0.0;
+	int gaussian_kernel_size = 0;
+};
+
+struct shadow_cache_layer_type {
+	bool valid = false;
+	shadow_cache_key_type key;
+};
+
+struct shadow_cache_type {
+	shadow_cache_layer_type layers[MAX_CASCADE_COUNT];
+	shadow_composite_key_type composite_key;
+	int static_geometry_version = 0;
+	double hit_count = 0.0;
+	double frame_count = 0.0;
+	double hit_rate = 0.0;
+	double rasterized_texel_count = 0.0;
+	double texel_count = 0.0;
+	double rasterized_texel_rate = 0.0;
+};
+
+struct shadow_update_scheduler_type {
+	long long frame_index = 0;
+	long long last_update_frames[MAX_CASCADE_COUNT] = {};
+	bool valid[MAX_CASCADE_COUNT] = {};
+	//the views as they were last rendered, receivers use these until the next update
+	cascade_type rendered_cascades[MAX_CASCADE_COUNT];
+	GLuint update_layer_mask = 0;
+	//stats
+	int update_count = 0;
+};
+
+struct gpu_timer_type {
+	//a few frames of queries in flight, so reading them back doesn't stall
+	GLuint queries[3] = {};
+	bool pending[3] = {};
+	int index = 0;
+	//milliseconds
+	double time = 0.0;
+};
+
+struct resolution_governor_type {
+	int rendered_resolution = 1024;
+	int frames_over_budget = 0;
+	int frames_under_budget = 0;
+	gpu_timer_type shadow_timer;
+	gpu_timer_type scene_timer;
+};
+
+struct camera_path_frame_type {
+	glm::vec3 position;
+	glm::quat rotation;
+};
+
+struct camera_path_recorder_type {
+	bool recording = false;
+	std::vector<camera_path_frame_type> frames;
+};
+
+struct tuning_result_type {
+	shadow_map_settings_type settings;
+	//milliseconds of gpu time per frame
+	double frame_time = 0.0;
+	//root mean square error against the reference, 0..1
+	double error = 0.0;
+};
+
+struct shader_pipeline_type {
+	GLuint pipeline = 0;
+	GLuint vertex_program = 0;
+	GLuint geometry_program = 0;
+	GLuint fragment_program = 0;
+	GLuint compute_program = 0;
+};
+
+struct sdsm_type {
+	//two buffers, so the reduction is read back one frame late without stalling
+	GLuint buffers[2] = {};
+	GLuint* mapped_buffers[2] = {};
+	GLsync fences[2] = {};
+	glm::vec3 light_directions[2];
+	int frame_index = 0;
+	//the latest finished reduction
+	bool valid = false;
+	float min_depth = 0.0;
+	float max_depth = 0.0;
+	glm::vec2 min_position = glm::vec2(0.0);
+	glm::vec2 max_position = glm::vec2(0.0);
+	glm::vec3 light_direction = glm::vec3(0.0);
+};
+
+struct shadow_draw_type {
+	glm::mat4 model;
+	GLint first_layer;
+	GLint padding[3];
+};
+
+struct draw_elements_indirect_command_type {
+	GLuint count;
+	GLuint instance_count;
+	GLuint first_index;
+	GLint base_vertex;
+	GLuint base_instance;
+};
+
+struct dynamic_buffer_type {
+	GLuint buffer = 0;
+	GLsizeiptr capacity = 0;
+};
+
+struct shadow_caster_culling_type {
+	//one draw list per cascade, filled in parallel
+	std::vector<std::vector<GLuint>> cascade_draw_lists;
+	//visible cascades of each renderable as a bit mask
+	std::vector<GLuint> layer_masks;
+	dynamic_buffer_type draw_buffer;
+	dynamic_buffer_type indirect_buffer;
+	//stats
+	int caster_counts[MAX_CASCADE_COUNT] = {};
+};
+
+struct physical_page_type {
+	bool resident = false;
+	//in light space pages, not relative to the virtual map's origin
+	glm::ivec2 virtual_page = glm::ivec2(0);
+	long long last_used_frame = -1;
+};
+
+struct virtual_page_draw_type {
+	glm::mat4 model;
+	//relative to the virtual map's origin
+	glm::ivec2 virtual_page;
+	glm::ivec2 physical_page;
+};
+
+struct virtual_shadow_map_type {
+	GLuint fbo = 0;
+	GLuint physical_texture = 0;
+	GLuint page_table_texture = 0;
+	//the marking pass' page requests, read back one frame late like the sdsm bounds
+	GLuint request_buffers[2] = {};
+	GLuint* mapped_request_buffers[2] = {};
+	GLsync fences[2] = {};
+	glm::ivec2 request_page_origins[2];
+	int frame_index = 0;
+	std::vector<glm::ivec2> requested_pages;
+	//the map's corner in light space pages, it's centered on the camera
+	glm::ivec2 page_origin = glm::ivec2(0);
+	//the cached pages are only valid with the same view and static geometry
+	glm::mat4 view = glm::mat4(1.0);
+	float extent = 0.0;
+	int static_geometry_version = -1;
+	std::vector<physical_page_type> physical_pages;
+	std::unordered_map<long long, int> resident_pages;
+	//pages under dynamic casters in the previous frame
+	std::vector<long long> dynamic_pages;
+	std::vector<GLuint> page_table;
+	long long frame = 0;
+	dynamic_buffer_type draw_buffer;
+	dynamic_buffer_type indirect_buffer;
+	//stats
+	int requested_page_count = 0;
+	int rendered_page_count = 0;
+	int resident_page_count = 0;
+	int missing_page_count = 0;
+};
+
+struct shadowed_light_type {
+	std::string name;
+	int type = LIGHT_TYPE_SPOT;
+	glm::vec3 position = glm::vec3(0.0);
+	glm::vec3 direction = glm::vec3(0.0, -1.0, 0.0);
+	glm::vec3 color = glm::vec3(1.0);
+	//spot: the cone's half angle in degrees and its reach, point: its reach, directional: the half size of the box around the position
+	float angle = 30.0;
+	float range = 50.0;
+	float bias = 0.002f;
+	//point: the world space radius of the filter kernel at the receivers
+	float filter_radius = 0.3f;
+	bool enabled = true;
+	//lights without shadows only take part in the clustered lighting
+	bool casts_shadow = true;
+	glm::mat4 view = glm::mat4(1.0);
+	glm::mat4 projection = glm::mat4(1.0);
+	float near_plane = 0.0;
+	float far_plane = 1.0;
+	//the tile's size in the atlas, or the cube's size for point lights, zero if the light doesn't need a shadow map in this frame
+	int resolution = 0;
+	//the point light's cube in the cube map array, -1 if it has none
+	int cube = -1;
+};
+
+//std430 layout of a light in the receivers' light buffer
+struct shadowed_light_data_type {
+	glm::mat4 view_projection;
+	glm::vec4 depth_row;
+	glm::vec4 position_type;
+	glm::vec4 direction_cos_angle;
+	glm::vec4 color_range;
+	//uv offset and size, zero size if the light has no tile
+	glm::vec4 tile;
+	glm::vec4 parameters;
+	//world space bounding sphere for the light culling, negative radius if the light reaches everything
+	glm::vec4 bounds;
+};
+
+struct shadow_atlas_tile_type {
+	int light = -1;
+	glm::ivec2 position = glm::ivec2(0);
+	int size = 0;
+	long long last_used_frame = 0;
+	//the tile's content is reused while the light and the static geometry don't change
+	bool valid = false;
+	glm::mat4 view_projection = glm::mat4(1.0);
+	int static_geometry_version = -1;
+};
+
+struct shadow_atlas_type {
+	GLuint fbo = 0;
+	GLuint depth_texture = 0;
+	//the packer can't free space, so it's reset and every tile is packed again when it's full
+	stbrp_context context;
+	std::vector<stbrp_node> nodes;
+	std::vector<shadow_atlas_tile_type> tiles;
+	long long frame = 0;
+	dynamic_buffer_type light_buffer;
+	dynamic_buffer_type draw_buffer;
+	dynamic_buffer_type indirect_buffer;
+	//stats
+	int rendered_tile_count = 0;
+	int repack_count = 0;
+	int evicted_tile_count = 0;
+};
+
+struct point_shadow_draw_type {
+	glm::mat4 model;
+	GLuint face_mask;
+	GLuint padding[3];
+};
+
+struct point_shadow_cube_type {
+	int light = -1;
+	//the cube's content is reused while the light and the static geometry don't change
+	bool valid = false;
+	glm::vec3 position = glm::vec3(0.0);
+	float range = 0.0;
+	int static_geometry_version = -1;
+};
+
+struct point_shadow_maps_type {
+	GLuint fbo = 0;
+	GLuint depth_texture = 0;
+	point_shadow_cube_type cubes[POINT_SHADOW_MAP_COUNT];
+	dynamic_buffer_type draw_buffer;
+	dynamic_buffer_type indirect_buffer;
+	//stats, the naive count is the caster and face pairs that rendering the whole scene to every face would take
+	int rendered_cube_count = 0;
+	int rendered_face_count = 0;
+	int naive_face_count = 0;
+};
+
+struct meshlet_draw_buffers_type {
+	dynamic_buffer_type command_buffer;
+	//the number of surviving meshlets per draw
+	dynamic_buffer_type count_buffer;
+};
+
+struct meshlet_culling_type {
+	bool enabled = true;
+	//the camera and the shadow passes have their own buffers, so they don't wait for each other
+	meshlet_draw_buffers_type camera_buffers;
+	meshlet_draw_buffers_type shadow_buffers;
+	//stats
+	int camera_meshlet_count = 0;
+	int shadow_meshlet_count = 0;
+};
+
+//the meshlets of a renderable's lod culled against a range of frusta, the survivors are one multi draw
+struct meshlet_draw_type {
+	int renderable = 0;
+	int lod = 0;
+	int first_frustum = 0;
+	int frustum_count = 1;
+	GLuint instance_count = 1;
+	GLuint base_instance = 0;
+	GLuint first_command = 0;
+};
+
+struct light_clusters_type {
+	GLuint cluster_buffer = 0;
+	GLuint light_index_buffer = 0;
+	GLuint light_index_count_buffer = 0;
+};
+
+struct worker_pool_type {
+	std::vector<std::thread> threads;
+	std::deque<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool stopping = false;
+};
+
+struct mesh_asset_type {
+	std::string path;
+	unsigned int import_flags = DEFAULT_MESH_IMPORT_FLAGS;
+	int state = ASSET_STATE_UNLOADED;
+	std::string error;
+	//the worker's messages, printed by the main thread, so the lines of parallel imports don't interleave
+	std::vector<std::string> log;
+	mesh_data_type data;
+	//the meshes share the vertex arrays and the buffers
+	std::vector<mesh_type> meshes;
+	std::vector<mesh_instance_type> instances;
+	//the buffers are owned by the asset, so they are deleted exactly once, no matter how many renderables share them
+	std::vector<GLuint> buffers;
+	GLsizeiptr gpu_size = 0;
+	GLsizeiptr vertex_gpu_size = 0;
+	//the renderables using the mesh, an unreferenced mesh stays resident until it's evicted
+	int reference_count = 0;
+	int last_used_frame = 0;
+};
+
+//a part of the staging buffer, reusable when the fence signals that its copies are done
+struct staging_region_type {
+	GLintptr offset = 0;
+	GLsizeiptr size = 0;
+	GLsync fence = nullptr;
+	int asset = -1;
+};
+
+struct asset_loader_type {
+	//a deque, so the workers' pointers stay valid while new assets are added
+	std::deque<mesh_asset_type> mesh_assets;
+	//canonical path and import flags to asset index
+	std::unordered_map<std::string, int> mesh_asset_keys;
+	GLsizeiptr gpu_size = 0;
+	GLsizeiptr gpu_budget = DEFAULT_MESH_GPU_BUDGET;
+	int frame = 0;
+	int evicted_mesh_count = 0;
+	std::vector<renderable_type> pending_renderables;
+	std::mutex mutex;
+	std::vector<int> imported_assets;
+	std::deque<int> upload_queue;
+	GLuint staging_buffer = 0;
+	char* staging_data = nullptr;
+	std::deque<staging_region_type> staging_regions;
+	std::chrono::time_point<std::chrono::steady_clock> start_time;
+	bool logged = false;
 };
 
 time_handler_type time_handler;
@@ -133,10 +1014,44 @@ player_type player;
 light_type light;
 window_type window;
 shadow_map_settings_type shadow_map_settings;
+shadow_cache_type shadow_cache;
+shadow_caster_culling_type shadow_caster_culling;
+shadow_update_scheduler_type shadow_update_scheduler;
+resolution_governor_type resolution_governor;
+camera_path_recorder_type camera_path_recorder;
+worker_pool_type worker_pool;
+worker_pool_type asset_worker_pool;
+bool vertex_shader_layer_supported = false;
 
-GLuint lambertian_program = 0;
-GLuint shadow_map_program = 0;
-GLuint gaussian_blur_program = 0;
+shader_pipeline_type lambertian_pipeline;
+shader_pipeline_type shadow_map_pipeline;
+//only the vertex programs are their own, the other stages are the lambertian and shadow map pipelines' programs
+shader_pipeline_type scene_store_pipeline;
+shader_pipeline_type scene_store_shadow_pipeline;
+shader_pipeline_type gaussian_blur_pipeline;
+shader_pipeline_type sdsm_pipeline;
+shader_pipeline_type virtual_shadow_map_pipeline;
+shader_pipeline_type virtual_page_marking_pipeline;
+sdsm_type sdsm;
+virtual_shadow_map_type virtual_shadow_map;
+shader_pipeline_type shadow_atlas_pipeline;
+shadow_atlas_type shadow_atlas;
+std::vector<shadowed_light_type> shadowed_lights;
+int shadowed_light_count = 0;
+shader_pipeline_type point_shadow_map_pipeline;
+point_shadow_maps_type point_shadow_maps;
+shader_pipeline_type light_culling_pipeline;
+light_clusters_type light_clusters;
+shader_pipeline_type meshlet_culling_pipeline;
+meshlet_culling_type meshlet_culling;
+mesh_cache_type mesh_cache;
+lod_settings_type lod_settings;
+scene_settings_type scene_settings;
+scene_store_type scene_store;
+streaming_type streaming;
+gpu_memory_registry_type gpu_memory_registry;
+render_target_pool_type render_target_pool;
+asset_loader_type asset_loader;
 
 mesh_type quad_mesh;
 std::vector<renderable_type> renderables;
@@ -144,10 +1059,19 @@ std::vector<renderable_type> renderables;
 GLuint shadow_map_fbo = 0;
 
 GLuint shadow_color_texture = 0;
-GLuint shadow_color_texture_2 = 0;
 GLuint shadow_depth_texture = 0;
+std::vector<GLuint> shadow_map_preview_textures;
+GLuint blur_fbo = 0;
+
+GLuint static_shadow_map_fbo = 0;
+GLuint static_shadow_color_texture = 0;
+GLuint static_shadow_depth_texture = 0;
 
-GLFWwindow* create_glfw_window(const std::string& title) {
+GLuint scene_fbo = 0;
+GLuint scene_color_texture = 0;
+GLuint scene_depth_texture = 0;
+
+GLFWwindow* create_glfw_window(const std::string& title, const bool headless) {
 	glfwSetErrorCallback([](int type, const char* message) {
 		std::string error = "";
 		switch(type) {
@@ -189,21 +1113,24 @@ GLFWwindow* create_glfw_window(const std::string& title) {
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
 	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+	if(headless) {
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	}
 #ifdef _DEBUG
 	glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);
 	window.size = glm::ivec2(1280, 720);
 	auto window_handler = glfwCreateWindow(window.size.x, window.size.y, title.c_str(), nullptr, nullptr);
 #else
-	window.size = screen_size;
-	auto window_handler = glfwCreateWindow(window.size.x, window.size.y, title.c_str(), glfwGetPrimaryMonitor(), nullptr);
+	window.size = headless ? glm::ivec2(1280, 720) : screen_size;
+	auto window_handler = glfwCreateWindow(window.size.x, window.size.y, title.c_str(), headless ? nullptr : glfwGetPrimaryMonitor(), nullptr);
 #endif
 	glfwMakeContextCurrent(window_handler);
 	glfwSwapInterval(0);
 	return window_handler;
 }
 
-void create_window() {
-	window.handler = create_glfw_window("Shadow maps example");
+void create_window(const bool headless) {
+	window.handler = create_glfw_window("Shadow maps example", headless);
 }
 
 std::string get_message_source(const GLenum source) {
@@ -248,6 +1175,17 @@ void message_callback(GLenum source, GLenum type, GLuint id, GLenum severity, GL
 	std::cout << src_str << ", " << type_str << ", " << severity_str << ", " << id << ": " << message << std::endl;
 }
 
+bool is_extension_supported(const std::string& name) {
+	GLint extension_count;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &extension_count);
+	for(int i = 0; i < extension_count; i++) {
+		if(name == reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i))) {
+			return true;
+		}
+	}
+	return false;
+}
+
 void initialize_opengl() {
 	gladLoadGLLoader((GLADloadproc) glfwGetProcAddress);
 	int flags;
@@ -259,6 +1197,7 @@ void initialize_opengl() {
 	}
 	glEnable(GL_CULL_FACE);
 	glEnable(GL_DEPTH_TEST);
+	vertex_shader_layer_supported = is_extension_supported("GL_ARB_shader_viewport_layer_array");
 }
 
 void initialize_imgui() {
@@ -269,6 +1208,72 @@ void initialize_imgui() {
 	ImGui_ImplOpenGL3_Init("#version 460");
 }
 
+void create_worker_pool(worker_pool_type& pool, const unsigned int thread_count) {
+	for(unsigned int i = 0; i < thread_count; i++) {
+		pool.threads.push_back(std::thread([&pool]() {
+			while(true) {
+				std::function<void()> task;
+				{
+					std::unique_lock<std::mutex> lock(pool.mutex);
+					pool.condition.wait(lock, [&pool]() {
+						return pool.stopping || !pool.tasks.empty();
+					});
+					if(pool.stopping && pool.tasks.empty()) {
+						return;
+					}
+					task = std::move(pool.tasks.front());
+					pool.tasks.pop_front();
+				}
+				task();
+			}
+		}));
+	}
+}
+
+void submit_task(worker_pool_type& pool, std::function<void()> task) {
+	{
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		pool.tasks.push_back(std::move(task));
+	}
+	pool.condition.notify_one();
+}
+
+void parallel_for(const int count, const std::function<void(int)>& task) {
+	if(count <= 0) {
+		return;
+	}
+	//the calling thread runs the first iteration, so it doesn't just sit idle while waiting
+	std::atomic<int> remaining(count - 1);
+	std::mutex mutex;
+	std::condition_variable condition;
+	for(int i = 1; i < count; i++) {
+		submit_task(worker_pool, [&, i]() {
+			task(i);
+			std::lock_guard<std::mutex> lock(mutex);
+			if(--remaining == 0) {
+				condition.notify_one();
+			}
+		});
+	}
+	task(0);
+	std::unique_lock<std::mutex> lock(mutex);
+	condition.wait(lock, [&]() {
+		return remaining == 0;
+	});
+}
+
+void destroy_worker_pool(worker_pool_type& pool) {
+	{
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		pool.stopping = true;
+	}
+	pool.condition.notify_all();
+	for(auto& thread : pool.threads) {
+		thread.join();
+	}
+	pool.threads.clear();
+}
+
 GLuint create_shader(const std::string& path, const GLenum type, const std::vector<std::string> defines = {}) {
 	std::stringstream stringstream;
 	try {
@@ -305,26 +1310,18 @@ GLuint create_shader(const std::string& path, const GLenum type, const std::vect
 	return shader;
 }
 
-GLuint create_shader_program(const std::string& vertex_path, const std::string& fragment_path, const std::string& name, const std::vector<std::string> additional_shaders_paths = {}, const std::vector<std::string> defines = {}) {
-	auto vertex_shader = create_shader(vertex_path, GL_VERTEX_SHADER, defines);
-	auto fragment_shader = create_shader(fragment_path, GL_FRAGMENT_SHADER, defines);
-	std::vector<GLuint> additional_shaders = {};
-	if(!additional_shaders_paths.empty()) {
-		for(auto& shader_path : additional_shaders_paths) {
-			auto shader = create_shader(shader_path.c_str(), GL_FRAGMENT_SHADER, defines);
-			additional_shaders.push_back(shader);
-		}
+GLuint create_shader_program(const std::vector<std::string>& paths, const GLenum type, const std::string& name, const std::vector<std::string> defines = {}) {
+	std::vector<GLuint> shaders = {};
+	for(auto& path : paths) {
+		shaders.push_back(create_shader(path, type, defines));
 	}
 
 	auto program = glCreateProgram();
 	glObjectLabel(GL_PROGRAM, program, name.length(), name.c_str());
-	if(!additional_shaders_paths.empty()) {
-		for(auto shader : additional_shaders) {
-			glAttachShader(program, shader);
-		}
+	glProgramParameteri(program, GL_PROGRAM_SEPARABLE, GL_TRUE);
+	for(auto shader : shaders) {
+		glAttachShader(program, shader);
 	}
-	glAttachShader(program, vertex_shader);
-	glAttachShader(program, fragment_shader);
 	glLinkProgram(program);
 	GLint result;
 	glGetProgramiv(program, GL_LINK_STATUS, &result);
@@ -336,27 +1333,76 @@ GLuint create_shader_program(const std::string& vertex_path, const std::string&
 		std::cout << log << std::endl;
 		delete[] log;
 	}
-	glDeleteShader(vertex_shader);
-	glDeleteShader(fragment_shader);
-	for(auto additional_shader : additional_shaders) {
-		glDeleteShader(additional_shader);
+	for(auto shader : shaders) {
+		glDetachShader(program, shader);
+		glDeleteShader(shader);
 	}
 	return program;
 }
 
-void create_shader_programs() {
-	glDeleteProgram(lambertian_program);
-	glDeleteProgram(shadow_map_program);
-	glDeleteProgram(gaussian_blur_program);
-	std::vector<std::string> additional_shaders_paths;
-	std::vector<std::string> defines = {};
+shader_pipeline_type create_pipeline(const std::string& name) {
+	shader_pipeline_type pipeline;
+	glCreateProgramPipelines(1, &pipeline.pipeline);
+	glObjectLabel(GL_PROGRAM_PIPELINE, pipeline.pipeline, name.length(), name.c_str());
+	return pipeline;
+}
+
+void set_vertex_program(shader_pipeline_type& pipeline, const GLuint program) {
+	glDeleteProgram(pipeline.vertex_program);
+	pipeline.vertex_program = program;
+	glUseProgramStages(pipeline.pipeline, GL_VERTEX_SHADER_BIT, program);
+}
+
+void set_geometry_program(shader_pipeline_type& pipeline, const GLuint program) {
+	glDeleteProgram(pipeline.geometry_program);
+	pipeline.geometry_program = program;
+	glUseProgramStages(pipeline.pipeline, GL_GEOMETRY_SHADER_BIT, program);
+}
+
+void set_fragment_program(shader_pipeline_type& pipeline, const GLuint program) {
+	glDeleteProgram(pipeline.fragment_program);
+	pipeline.fragment_program = program;
+	glUseProgramStages(pipeline.pipeline, GL_FRAGMENT_SHADER_BIT, program);
+}
+
+void set_compute_program(shader_pipeline_type& pipeline, const GLuint program) {
+	glDeleteProgram(pipeline.compute_program);
+	pipeline.compute_program = program;
+	glUseProgramStages(pipeline.pipeline, GL_COMPUTE_SHADER_BIT, program);
+}
+
+void destroy_pipeline(shader_pipeline_type& pipeline) {
+	glDeleteProgram(pipeline.vertex_program);
+	glDeleteProgram(pipeline.geometry_program);
+	glDeleteProgram(pipeline.fragment_program);
+	glDeleteProgram(pipeline.compute_program);
+	glDeleteProgramPipelines(1, &pipeline.pipeline);
+	pipeline = shader_pipeline_type();
+}
+
+bool is_virtual_shadow_map_active() {
+	//the variance map would need a blur across page borders
+	return shadow_map_settings.match_frustums && shadow_map_settings.virtual_shadow_map && shadow_map_settings.mode != MODE_VSM;
+}
+
+std::vector<std::string> get_cluster_defines() {
+	return {"CLUSTER_COUNT_X " + std::to_string(CLUSTER_COUNT_X), "CLUSTER_COUNT_Y " + std::to_string(CLUSTER_COUNT_Y), "CLUSTER_COUNT_Z " + std::to_string(CLUSTER_COUNT_Z)};
+}
+
+void create_lambertian_fragment_program() {
+	std::vector<std::string> paths = {"res/shader/lambertian.frag", "res/shader/point_shadow_map.frag"};
+	auto defines = get_cluster_defines();
+	if(is_virtual_shadow_map_active()) {
+		defines.push_back("VIRTUAL_SHADOW_MAP 1");
+	}
 	if(shadow_map_settings.mode == MODE_NORMAL) {
-		additional_shaders_paths = {"res/shader/normal_shadow_map.frag"};
+		paths.push_back("res/shader/normal_shadow_map.frag");
 	} else if(shadow_map_settings.mode == MODE_PCF || shadow_map_settings.mode == MODE_PCSS) {
+		paths.push_back("res/shader/sampling.frag");
 		if(shadow_map_settings.mode == MODE_PCF) {
-			additional_shaders_paths = {"res/shader/sampling.frag", "res/shader/pcf_shadow_map.frag"};
+			paths.push_back("res/shader/pcf_shadow_map.frag");
 		} else {
-			additional_shaders_paths = {"res/shader/sampling.frag", "res/shader/pcss_shadow_map.frag"};
+			paths.push_back("res/shader/pcss_shadow_map.frag");
 		}
 		if(shadow_map_settings.sampling_mode == SAMPLING_MODE_GRID) {
 			defines.push_back("SAMPLING_MODE_GRID 1");
@@ -367,402 +1413,4900 @@ void create_shader_programs() {
 			defines.push_back("SAMPLING_MODE_VOGEL 1");
 		}
 	} else if(shadow_map_settings.mode == MODE_VSM) {
-		additional_shaders_paths = {"res/shader/sampling.frag", "res/shader/vsm_shadow_map.frag"};
+		paths.push_back("res/shader/sampling.frag");
+		paths.push_back("res/shader/vsm_shadow_map.frag");
 	}
-	lambertian_program = create_shader_program("res/shader/lambertian.vert", "res/shader/lambertian.frag", "<lambertian>", additional_shaders_paths, defines);
-	auto shadow_map_frag = shadow_map_settings.mode == MODE_VSM ? "res/shader/shadow_map_vsm.frag" : "res/shader/shadow_map.frag";
-	shadow_map_program = create_shader_program("res/shader/shadow_map.vert", shadow_map_frag, "<shadow map>");
-	gaussian_blur_program = create_shader_program("res/shader/gaussian_blur.vert", "res/shader/gaussian_blur.frag", "<gaussian blur>", {"res/shader/sampling.frag"}, {"GAUSSIAN_" + std::to_string(shadow_map_settings.gaussian_kernel_size) + " 1"});
+	set_fragment_program(lambertian_pipeline, create_shader_program(paths, GL_FRAGMENT_SHADER, "<lambertian fragment>", defines));
+	glUseProgramStages(scene_store_pipeline.pipeline, GL_FRAGMENT_SHADER_BIT, lambertian_pipeline.fragment_program);
 }
 
-GLuint create_and_attach_vbo(const GLuint vao, const GLuint index, const std::vector<float> data, const std::string& name, const GLuint vertex_size = 3) {
-	GLuint vbo;
-	glCreateBuffers(1, &vbo);
-	glObjectLabel(GL_BUFFER, vbo, name.length(), name.c_str());
-	glNamedBufferStorage(vbo, data.size() * sizeof(float), &data[0], GL_NONE);
-	glEnableVertexArrayAttrib(vao, index);
-	glVertexArrayVertexBuffer(vao, index, vbo, 0, vertex_size * sizeof(float));
-	glVertexArrayAttribFormat(vao, index, vertex_size, GL_FLOAT, GL_FALSE, 0);
-	glVertexArrayAttribBinding(vao, index, index);
-	return vbo;
+void create_shadow_map_fragment_program() {
+	auto path = shadow_map_settings.mode == MODE_VSM ? "res/shader/shadow_map_vsm.frag" : "res/shader/shadow_map.frag";
+	std::vector<std::string> defines = {};
+	if(shadow_map_settings.lispsm) {
+		defines.push_back("WARPED_DEPTH 1");
+	}
+	set_fragment_program(shadow_map_pipeline, create_shader_program({path}, GL_FRAGMENT_SHADER, "<shadow map fragment>", defines));
+	glUseProgramStages(scene_store_shadow_pipeline.pipeline, GL_FRAGMENT_SHADER_BIT, shadow_map_pipeline.fragment_program);
 }
 
-GLuint create_and_attach_ebo(const GLuint vao, const std::vector<GLuint> indices, const std::string& name) {
-	GLuint ebo;
-	glCreateBuffers(1, &ebo);
-	glObjectLabel(GL_BUFFER, ebo, name.length(), name.c_str());
-	glNamedBufferStorage(ebo, indices.size() * sizeof(GLuint), &indices[0], GL_NONE);
-	glVertexArrayElementBuffer(vao, ebo);
-	return ebo;
+void create_gaussian_blur_fragment_program() {
+	auto define = "GAUSSIAN_" + std::to_string(shadow_map_settings.gaussian_kernel_size) + " 1";
+	set_fragment_program(gaussian_blur_pipeline, create_shader_program({"res/shader/gaussian_blur.frag", "res/shader/sampling.frag"}, GL_FRAGMENT_SHADER, "<gaussian blur fragment>", {define}));
 }
 
-GLuint create_vao(const std::string name) {
-	GLuint vao;
-	glCreateVertexArrays(1, &vao);
-	glObjectLabel(GL_VERTEX_ARRAY, vao, name.length(), name.c_str());
-	return vao;
+void create_shader_programs() {
+	lambertian_pipeline = create_pipeline("<lambertian>");
+	shadow_map_pipeline = create_pipeline("<shadow map>");
+	scene_store_pipeline = create_pipeline("<scene store>");
+	scene_store_shadow_pipeline = create_pipeline("<scene store shadow map>");
+	gaussian_blur_pipeline = create_pipeline("<gaussian blur>");
+	sdsm_pipeline = create_pipeline("<sdsm>");
+	virtual_shadow_map_pipeline = create_pipeline("<virtual shadow map>");
+	virtual_page_marking_pipeline = create_pipeline("<virtual page marking>");
+	shadow_atlas_pipeline = create_pipeline("<shadow atlas>");
+	point_shadow_map_pipeline = create_pipeline("<point shadow map>");
+	light_culling_pipeline = create_pipeline("<light culling>");
+	meshlet_culling_pipeline = create_pipeline("<meshlet culling>");
+	set_vertex_program(lambertian_pipeline, create_shader_program({"res/shader/lambertian.vert"}, GL_VERTEX_SHADER, "<lambertian vertex>"));
+	if(vertex_shader_layer_supported) {
+		set_vertex_program(shadow_map_pipeline, create_shader_program({"res/shader/shadow_map.vert"}, GL_VERTEX_SHADER, "<shadow map vertex>", {"VERTEX_SHADER_LAYER 1"}));
+	} else {
+		set_vertex_program(shadow_map_pipeline, create_shader_program({"res/shader/shadow_map.vert"}, GL_VERTEX_SHADER, "<shadow map vertex>"));
+		set_geometry_program(shadow_map_pipeline, create_shader_program({"res/shader/shadow_map.geom"}, GL_GEOMETRY_SHADER, "<shadow map geometry>"));
+	}
+	set_vertex_program(scene_store_pipeline, create_shader_program({"res/shader/lambertian.vert", "res/shader/scene_instance.vert"}, GL_VERTEX_SHADER, "<scene store vertex>", {"SCENE_INSTANCES 1"}));
+	if(vertex_shader_layer_supported) {
+		set_vertex_program(scene_store_shadow_pipeline, create_shader_program({"res/shader/shadow_map.vert", "res/shader/scene_instance.vert"}, GL_VERTEX_SHADER, "<scene store shadow map vertex>", {"VERTEX_SHADER_LAYER 1", "SCENE_INSTANCES 1"}));
+	} else {
+		set_vertex_program(scene_store_shadow_pipeline, create_shader_program({"res/shader/shadow_map.vert", "res/shader/scene_instance.vert"}, GL_VERTEX_SHADER, "<scene store shadow map vertex>", {"SCENE_INSTANCES 1"}));
+		glUseProgramStages(scene_store_shadow_pipeline.pipeline, GL_GEOMETRY_SHADER_BIT, shadow_map_pipeline.geometry_program);
+	}
+	if(vertex_shader_layer_supported) {
+		set_vertex_program(shadow_atlas_pipeline, create_shader_program({"res/shader/shadow_map.vert"}, GL_VERTEX_SHADER, "<shadow atlas vertex>", {"VERTEX_SHADER_LAYER 1", "SHADOW_ATLAS 1"}));
+	} else {
+		set_vertex_program(shadow_atlas_pipeline, create_shader_program({"res/shader/shadow_map.vert"}, GL_VERTEX_SHADER, "<shadow atlas vertex>", {"SHADOW_ATLAS 1"}));
+		set_geometry_program(shadow_atlas_pipeline, create_shader_program({"res/shader/shadow_map.geom"}, GL_GEOMETRY_SHADER, "<shadow atlas geometry>", {"SHADOW_ATLAS 1"}));
+	}
+	//spot lights are perspective, so the linear depth is written explicitly
+	set_fragment_program(shadow_atlas_pipeline, create_shader_program({"res/shader/shadow_map.frag"}, GL_FRAGMENT_SHADER, "<shadow atlas fragment>", {"WARPED_DEPTH 1"}));
+	//the geometry shader is needed even if the vertex shader could select the layer, because it culls the triangles per face
+	set_vertex_program(point_shadow_map_pipeline, create_shader_program({"res/shader/cube_shadow_map.vert"}, GL_VERTEX_SHADER, "<point shadow map vertex>"));
+	set_geometry_program(point_shadow_map_pipeline, create_shader_program({"res/shader/cube_shadow_map.geom"}, GL_GEOMETRY_SHADER, "<point shadow map geometry>"));
+	set_fragment_program(point_shadow_map_pipeline, create_shader_program({"res/shader/cube_shadow_map.frag"}, GL_FRAGMENT_SHADER, "<point shadow map fragment>"));
+	set_compute_program(light_culling_pipeline, create_shader_program({"res/shader/light_culling.comp"}, GL_COMPUTE_SHADER, "<light culling compute>", get_cluster_defines()));
+	set_compute_program(meshlet_culling_pipeline, create_shader_program({"res/shader/meshlet_culling.comp"}, GL_COMPUTE_SHADER, "<meshlet culling compute>", {"MAX_FRUSTUM_COUNT " + std::to_string(MAX_CASCADE_COUNT)}));
+	set_vertex_program(gaussian_blur_pipeline, create_shader_program({"res/shader/gaussian_blur.vert"}, GL_VERTEX_SHADER, "<gaussian blur vertex>"));
+	set_compute_program(sdsm_pipeline, create_shader_program({"res/shader/sdsm_reduction.comp"}, GL_COMPUTE_SHADER, "<sdsm compute>"));
+	set_vertex_program(virtual_shadow_map_pipeline, create_shader_program({"res/shader/virtual_shadow_map.vert"}, GL_VERTEX_SHADER, "<virtual shadow map vertex>"));
+	set_fragment_program(virtual_shadow_map_pipeline, create_shader_program({"res/shader/shadow_map.frag"}, GL_FRAGMENT_SHADER, "<virtual shadow map fragment>"));
+	set_compute_program(virtual_page_marking_pipeline, create_shader_program({"res/shader/virtual_page_marking.comp"}, GL_COMPUTE_SHADER, "<virtual page marking compute>"));
+	create_lambertian_fragment_program();
+	create_shadow_map_fragment_program();
+	create_gaussian_blur_fragment_program();
 }
 
-mesh_type create_quad() {
-	std::vector<float> vertices = {
-		-1.0, 1.0, 0.0,		//top-left
-		1.0, 1.0, 0.0,		//top-right
-		-1.0, -1.0, 0.0,	//bottom-left
-		1.0, -1.0, 0.0		//bottom-right
-	};
-	std::vector<float> normals = {
-		0.0, 0.0, 1.0,
-		0.0, 0.0, 1.0,
-		0.0, 0.0, 1.0,
-		0.0, 0.0, 1.0
-	};
-	std::vector<float> uvs = {
-		0.0, 1.0,
-		1.0, 1.0,
-		0.0, 0.0,
-		1.0, 0.0
-	};
-	std::vector<GLuint> indices = {
-		0, 2, 3,
-		1, 0, 3
+std::string get_gpu_category_name(const int category) {
+	switch(category) {
+		case GPU_CATEGORY_SHADOW_TARGETS: return "shadow targets";
+		case GPU_CATEGORY_SCENE_TARGETS: return "scene targets";
+		case GPU_CATEGORY_MESHES: return "meshes";
+		case GPU_CATEGORY_BUFFERS: return "buffers";
+		default: return "unknown";
+	}
+}
+
+std::string get_format_name(const GLenum format) {
+	switch(format) {
+		case GL_NONE: return "-";
+		case GL_RGBA8: return "RGBA8";
+		case GL_R32F: return "R32F";
+		case GL_RG32F: return "RG32F";
+		case GL_R32UI: return "R32UI";
+		case GL_DEPTH_COMPONENT32F: return "DEPTH32F";
+		default: return "unknown";
+	}
+}
+
+GLsizeiptr get_texel_size(const GLenum format) {
+	switch(format) {
+		case GL_RGBA8: return 4;
+		case GL_R32F: return 4;
+		case GL_RG32F: return 8;
+		case GL_R32UI: return 4;
+		case GL_DEPTH_COMPONENT32F: return 4;
+		default:
+			std::cout << "The size of format " << format << " is unknown" << std::endl;
+			return 0;
+	}
+}
+
+std::string get_buffer_usage(const GLbitfield flags) {
+	if(flags & GL_MAP_READ_BIT) {
+		return "mapped readback";
+	}
+	if(flags & GL_MAP_WRITE_BIT) {
+		return "mapped upload";
+	}
+	return flags & GL_DYNAMIC_STORAGE_BIT ? "dynamic" : "static";
+}
+
+long long get_gpu_resource_key(const GLenum type, const GLuint object) {
+	return (static_cast<long long>(type) << 32) | object;
+}
+
+void log_gpu_memory() {
+	auto& registry = gpu_memory_registry;
+	for(int i = 0; i < GPU_CATEGORY_COUNT; i++) {
+		std::cout << "GPU MEMORY, " << get_gpu_category_name(i) << ": " << registry.category_sizes[i] / (1024.0 * 1024.0) << " MB" << std::endl;
+	}
+}
+
+void register_gpu_resource(const GLenum type, const GLuint object, const std::string& name, const int category, const GLenum format, const std::string& usage, const GLsizeiptr size) {
+	//every created object is labelled and counted here, so the debugger and the memory table show the same names
+	auto& registry = gpu_memory_registry;
+	glObjectLabel(type, object, name.length(), name.c_str());
+	gpu_resource_type resource;
+	resource.type = type;
+	resource.name = name;
+	resource.category = category;
+	resource.format = format;
+	resource.usage = usage;
+	resource.size = size;
+	registry.resources[get_gpu_resource_key(type, object)] = resource;
+	registry.category_sizes[category] += size;
+	registry.size += size;
+	registry.peak_size = max(registry.peak_size, registry.size);
+	if(registry.size > registry.budget && !registry.over_budget) {
+		registry.over_budget = true;
+		std::cout << "GPU MEMORY, ERROR, " << name << " goes over the budget: " << registry.size / (1024.0 * 1024.0) << " MB of " << registry.budget / (1024.0 * 1024.0) << " MB" << std::endl;
+		log_gpu_memory();
+		if(registry.strict) {
+			exit(1);
+		}
+	}
+}
+
+void rename_gpu_resource(const GLenum type, const GLuint object, const std::string& name) {
+	glObjectLabel(type, object, name.length(), name.c_str());
+	auto iterator = gpu_memory_registry.resources.find(get_gpu_resource_key(type, object));
+	if(iterator != gpu_memory_registry.resources.end()) {
+		iterator->second.name = name;
+	}
+}
+
+void delete_gpu_resources(const GLenum type, const GLsizei count, const GLuint* objects) {
+	auto& registry = gpu_memory_registry;
+	for(int i = 0; i < count; i++) {
+		auto iterator = registry.resources.find(get_gpu_resource_key(type, objects[i]));
+		if(iterator != registry.resources.end()) {
+			registry.category_sizes[iterator->second.category] -= iterator->second.size;
+			registry.size -= iterator->second.size;
+			registry.resources.erase(iterator);
+		}
+	}
+	registry.over_budget = registry.size > registry.budget;
+	switch(type) {
+		case GL_TEXTURE: glDeleteTextures(count, objects); break;
+		case GL_BUFFER: glDeleteBuffers(count, objects); break;
+		case GL_FRAMEBUFFER: glDeleteFramebuffers(count, objects); break;
+		case GL_VERTEX_ARRAY: glDeleteVertexArrays(count, objects); break;
+	}
+}
+
+GLuint create_buffer(const void* data, const GLsizeiptr size, const std::string& name, const GLbitfield flags = GL_NONE, const int category = GPU_CATEGORY_MESHES) {
+	GLuint buffer;
+	glCreateBuffers(1, &buffer);
+	glNamedBufferStorage(buffer, size, data, flags);
+	register_gpu_resource(GL_BUFFER, buffer, name, category, GL_NONE, get_buffer_usage(flags), size);
+	return buffer;
+}
+
+void attach_vbo(const GLuint vao, const GLuint index, const GLuint vbo, const GLintptr offset, const GLsizei stride, const GLuint vertex_size = 3, const GLenum type = GL_FLOAT, const GLboolean normalized = GL_FALSE) {
+	glEnableVertexArrayAttrib(vao, index);
+	glVertexArrayVertexBuffer(vao, index, vbo, offset, stride);
+	glVertexArrayAttribFormat(vao, index, vertex_size, type, normalized, 0);
+	glVertexArrayAttribBinding(vao, index, index);
+}
+
+GLuint create_and_attach_vbo(const GLuint vao, const GLuint index, const void* data, const GLsizeiptr size, const std::string& name, const GLuint vertex_size = 3) {
+	auto vbo = create_buffer(data, size, name);
+	attach_vbo(vao, index, vbo, 0, vertex_size * sizeof(float), vertex_size);
+	return vbo;
+}
+
+GLuint create_and_attach_vbo(const GLuint vao, const GLuint index, const std::vector<float>& data, const std::string& name, const GLuint vertex_size = 3) {
+	return create_and_attach_vbo(vao, index, data.data(), data.size() * sizeof(float), name, vertex_size);
+}
+
+GLuint create_and_attach_ebo(const GLuint vao, const void* data, const GLsizeiptr size, const std::string& name) {
+	auto ebo = create_buffer(data, size, name);
+	glVertexArrayElementBuffer(vao, ebo);
+	return ebo;
+}
+
+GLuint create_and_attach_ebo(const GLuint vao, const std::vector<GLuint>& indices, const std::string& name) {
+	return create_and_attach_ebo(vao, indices.data(), indices.size() * sizeof(GLuint), name);
+}
+
+GLuint get_index_size(const GLenum index_type) {
+	return index_type == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(GLuint);
+}
+
+GLuint create_vao(const std::string name) {
+	GLuint vao;
+	glCreateVertexArrays(1, &vao);
+	register_gpu_resource(GL_VERTEX_ARRAY, vao, name, GPU_CATEGORY_MESHES, GL_NONE, "vertex array", 0);
+	return vao;
+}
+
+void unmap_file(mapped_file_type& mapped_file);
+
+bool map_file(const std::string& path, mapped_file_type& mapped_file) {
+#ifdef _WIN32
+	mapped_file.file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if(mapped_file.file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER size;
+	GetFileSizeEx(mapped_file.file, &size);
+	mapped_file.size = size.QuadPart;
+	mapped_file.mapping = mapped_file.size > 0 ? CreateFileMappingA(mapped_file.file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+	if(mapped_file.mapping) {
+		mapped_file.data = static_cast<const char*>(MapViewOfFile(mapped_file.mapping, FILE_MAP_READ, 0, 0, 0));
+	}
+#else
+	mapped_file.file = open(path.c_str(), O_RDONLY);
+	if(mapped_file.file == -1) {
+		return false;
+	}
+	struct stat status;
+	fstat(mapped_file.file, &status);
+	mapped_file.size = status.st_size;
+	if(mapped_file.size > 0) {
+		auto data = mmap(nullptr, mapped_file.size, PROT_READ, MAP_PRIVATE, mapped_file.file, 0);
+		mapped_file.data = data == MAP_FAILED ? nullptr : static_cast<const char*>(data);
+	}
+#endif
+	if(!mapped_file.data) {
+		unmap_file(mapped_file);
+		return false;
+	}
+	return true;
+}
+
+void unmap_file(mapped_file_type& mapped_file) {
+#ifdef _WIN32
+	if(mapped_file.data) {
+		UnmapViewOfFile(mapped_file.data);
+	}
+	if(mapped_file.mapping) {
+		CloseHandle(mapped_file.mapping);
+	}
+	if(mapped_file.file != INVALID_HANDLE_VALUE) {
+		CloseHandle(mapped_file.file);
+	}
+#else
+	if(mapped_file.data) {
+		munmap(const_cast<char*>(mapped_file.data), mapped_file.size);
+	}
+	if(mapped_file.file != -1) {
+		close(mapped_file.file);
+	}
+#endif
+	mapped_file = mapped_file_type();
+}
+
+unsigned long long hash_bytes(const char* data, const size_t size) {
+	//64 bit fnv-1a
+	unsigned long long hash = 14695981039346656037ull;
+	for(size_t i = 0; i < size; i++) {
+		hash ^= static_cast<unsigned char>(data[i]);
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+GLuint get_cooked_mesh_aligned_offset(const size_t offset) {
+	return (offset + COOKED_MESH_ALIGNMENT - 1) / COOKED_MESH_ALIGNMENT * COOKED_MESH_ALIGNMENT;
+}
+
+GLuint get_cooked_index_size(const GLuint vertex_count) {
+	return vertex_count <= 65536 ? sizeof(unsigned short) : sizeof(GLuint);
+}
+
+bool is_cooked_range_valid(const mapped_file_type& mapped_file, const GLuint offset, const uint64_t count, const uint64_t element_size) {
+	//in 64 bits, so a corrupt count can't wrap around
+	return offset + count * element_size <= mapped_file.size;
+}
+
+bool is_cooked_mesh_valid(const mapped_file_type& mapped_file, const unsigned long long source_hash) {
+	if(mapped_file.size < sizeof(cooked_mesh_header_type)) {
+		return false;
+	}
+	auto header = reinterpret_cast<const cooked_mesh_header_type*>(mapped_file.data);
+	if(std::memcmp(header->magic, COOKED_MESH_MAGIC, sizeof(header->magic)) != 0 || header->version != COOKED_MESH_VERSION || header->source_hash != source_hash) {
+		return false;
+	}
+	if(header->vertex_format != COOKED_VERTEX_FORMAT_QUANTIZED && header->vertex_format != COOKED_VERTEX_FORMAT_FLOAT) {
+		return false;
+	}
+	auto quantized = header->vertex_format == COOKED_VERTEX_FORMAT_QUANTIZED;
+	if(!is_cooked_range_valid(mapped_file, header->position_offset, header->vertex_count, quantized ? sizeof(GLuint64) : sizeof(glm::vec3)) || !is_cooked_range_valid(mapped_file, header->normal_offset, header->vertex_count, quantized ? sizeof(GLuint) : sizeof(glm::vec3))) {
+		return false;
+	}
+	if(!is_cooked_range_valid(mapped_file, header->submesh_offset, header->submesh_count, sizeof(cooked_submesh_type)) || !is_cooked_range_valid(mapped_file, header->meshlet_offset, header->meshlet_count, sizeof(meshlet_type)) || !is_cooked_range_valid(mapped_file, header->instance_offset, header->instance_count, sizeof(mesh_instance_type))) {
+		return false;
+	}
+	//the index size depends on the largest submesh, so the submeshes are checked before the indices
+	auto submeshes = reinterpret_cast<const cooked_submesh_type*>(mapped_file.data + header->submesh_offset);
+	GLuint max_vertex_count = 0;
+	for(int i = 0; i < header->submesh_count; i++) {
+		auto& submesh = submeshes[i];
+		if(submesh.base_vertex < 0 || submesh.base_vertex + static_cast<uint64_t>(submesh.vertex_count) > header->vertex_count || submesh.lod_count > MAX_MESH_LOD_COUNT) {
+			return false;
+		}
+		for(int j = 0; j < submesh.lod_count; j++) {
+			auto& lod = submesh.lods[j];
+			if(static_cast<uint64_t>(lod.first_index) + lod.index_count > header->index_count || static_cast<uint64_t>(lod.first_meshlet) + lod.meshlet_count > header->meshlet_count) {
+				return false;
+			}
+		}
+		max_vertex_count = max(max_vertex_count, submesh.vertex_count);
+	}
+	auto instances = reinterpret_cast<const mesh_instance_type*>(mapped_file.data + header->instance_offset);
+	for(int i = 0; i < header->instance_count; i++) {
+		if(instances[i].mesh >= header->submesh_count) {
+			return false;
+		}
+	}
+	return is_cooked_range_valid(mapped_file, header->index_offset, header->index_count, get_cooked_index_size(max_vertex_count));
+}
+
+void append_assimp_mesh(const aiMesh* ai_mesh, source_mesh_type& mesh) {
+	//assimp's vectors are three floats, missing normals stay zero, the points and lines left by the triangulation are skipped
+	auto base_vertex = static_cast<GLuint>(mesh.positions.size());
+	auto vertices = reinterpret_cast<const glm::vec3*>(ai_mesh->mVertices);
+	mesh.positions.insert(mesh.positions.end(), vertices, vertices + ai_mesh->mNumVertices);
+	if(ai_mesh->HasNormals()) {
+		auto normals = reinterpret_cast<const glm::vec3*>(ai_mesh->mNormals);
+		mesh.normals.insert(mesh.normals.end(), normals, normals + ai_mesh->mNumVertices);
+	} else {
+		mesh.normals.resize(mesh.positions.size(), glm::vec3(0.0));
+	}
+	for(int i = 0; i < ai_mesh->mNumFaces; i++) {
+		auto& face = ai_mesh->mFaces[i];
+		if(face.mNumIndices == 3) {
+			mesh.indices.insert(mesh.indices.end(), {base_vertex + face.mIndices[0], base_vertex + face.mIndices[1], base_vertex + face.mIndices[2]});
+		}
+	}
+}
+
+bool read_assimp_scene(const std::string& path, const unsigned int import_flags, source_scene_type& scene, std::string& error) {
+	Assimp::Importer importer;
+	auto ai_scene = importer.ReadFile(path, import_flags);
+	if(!ai_scene || ai_scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !ai_scene->mRootNode || ai_scene->mNumMeshes == 0) {
+		error = ai_scene ? "the file has no complete mesh" : importer.GetErrorString();
+		return false;
+	}
+
+	//the node graph is flattened into world transforms, the nodes with the same meshes share their submeshes
+	std::map<std::vector<unsigned int>, std::vector<GLuint>> node_submeshes;
+	std::vector<std::pair<const aiNode*, glm::mat4>> nodes = {{ai_scene->mRootNode, glm::mat4(1.0)}};
+	while(!nodes.empty()) {
+		auto node = nodes.back().first;
+		//assimp's matrices are row major
+		auto transform = nodes.back().second * glm::transpose(glm::make_mat4(&node->mTransformation.a1));
+		nodes.pop_back();
+		for(int i = node->mNumChildren - 1; i >= 0; i--) {
+			nodes.push_back({node->mChildren[i], transform});
+		}
+		if(node->mNumMeshes == 0) {
+			continue;
+		}
+		std::vector<unsigned int> key(node->mMeshes, node->mMeshes + node->mNumMeshes);
+		auto iterator = node_submeshes.find(key);
+		if(iterator == node_submeshes.end()) {
+			//the node's meshes with the same material are merged, so they are one range of the shared buffers
+			std::map<unsigned int, GLuint> material_submeshes;
+			std::vector<GLuint> submeshes;
+			for(auto mesh_index : key) {
+				auto ai_mesh = ai_scene->mMeshes[mesh_index];
+				if(!(ai_mesh->mPrimitiveTypes & aiPrimitiveType_TRIANGLE)) {
+					continue;
+				}
+				auto material = material_submeshes.find(ai_mesh->mMaterialIndex);
+				if(material == material_submeshes.end()) {
+					material = material_submeshes.emplace(ai_mesh->mMaterialIndex, static_cast<GLuint>(scene.meshes.size())).first;
+					submeshes.push_back(scene.meshes.size());
+					scene.meshes.emplace_back();
+				}
+				append_assimp_mesh(ai_mesh, scene.meshes[material->second]);
+			}
+			iterator = node_submeshes.emplace(key, submeshes).first;
+		}
+		for(auto submesh : iterator->second) {
+			mesh_instance_type instance;
+			instance.transform = transform;
+			instance.mesh = submesh;
+			scene.instances.push_back(instance);
+		}
+	}
+	if(scene.instances.empty()) {
+		error = "the file has no triangle mesh";
+		return false;
+	}
+	return true;
+}
+
+void read_mesh_data_streams(const mesh_data_type& data, source_scene_type& scene) {
+	//the streams of the mapped file may be interleaved or offset, the optimizer needs them packed
+	scene.meshes.resize(1);
+	scene.instances = data.instances;
+	auto& mesh = scene.meshes[0];
+	auto vertex_count = data.vertex_count;
+	for(auto stream : {std::make_pair(&data.positions, &mesh.positions), std::make_pair(&data.normals, &mesh.normals)}) {
+		auto base = data.buffers[stream.first->buffer].data + stream.first->offset;
+		stream.second->resize(vertex_count);
+		for(int i = 0; i < vertex_count; i++) {
+			std::memcpy(&(*stream.second)[i], base + i * stream.first->stride, sizeof(glm::vec3));
+		}
+	}
+	auto indices = data.buffers[data.index_buffer].data;
+	mesh.indices.resize(data.index_count);
+	for(int i = 0; i < data.index_count; i++) {
+		mesh.indices[i] = data.index_type == GL_UNSIGNED_SHORT ? reinterpret_cast<const unsigned short*>(indices)[i] : reinterpret_cast<const GLuint*>(indices)[i];
+	}
+}
+
+int get_vertex_cache_miss_count(const std::vector<GLuint>& indices, const int vertex_count) {
+	//a fifo cache, a vertex is a hit if fewer than the cache's size misses happened since it was loaded
+	std::vector<int> load_times(vertex_count, -VERTEX_CACHE_SIZE - 1);
+	auto miss_count = 0;
+	for(auto index : indices) {
+		if(miss_count - load_times[index] > VERTEX_CACHE_SIZE) {
+			load_times[index] = miss_count;
+			miss_count++;
+		}
+	}
+	return miss_count;
+}
+
+void weld_vertices(source_mesh_type& mesh) {
+	//the vertices are sorted, so the identical ones are next to each other
+	auto vertex_key = [&mesh](const GLuint vertex) {
+		auto& p = mesh.positions[vertex];
+		auto& n = mesh.normals[vertex];
+		return std::make_tuple(p.x, p.y, p.z, n.x, n.y, n.z);
 	};
+	std::vector<GLuint> order(mesh.positions.size());
+	for(int i = 0; i < order.size(); i++) {
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [&vertex_key](const GLuint a, const GLuint b) {
+		return vertex_key(a) < vertex_key(b);
+	});
+	std::vector<GLuint> remap(order.size());
+	source_mesh_type welded;
+	for(int i = 0; i < order.size(); i++) {
+		if(i == 0 || vertex_key(order[i - 1]) != vertex_key(order[i])) {
+			welded.positions.push_back(mesh.positions[order[i]]);
+			welded.normals.push_back(mesh.normals[order[i]]);
+		}
+		remap[order[i]] = welded.positions.size() - 1;
+	}
+	for(auto& index : mesh.indices) {
+		index = remap[index];
+	}
+	mesh.positions.swap(welded.positions);
+	mesh.normals.swap(welded.normals);
+}
+
+void optimize_vertex_cache(std::vector<GLuint>& indices, const int vertex_count) {
+	//tipsify, fans around the vertices and prefers the next one that's still in the cache
+	int triangle_count = indices.size() / 3;
+	std::vector<int> live_counts(vertex_count, 0);
+	for(auto index : indices) {
+		live_counts[index]++;
+	}
+	std::vector<int> adjacency_offsets(vertex_count + 1, 0);
+	for(int i = 0; i < vertex_count; i++) {
+		adjacency_offsets[i + 1] = adjacency_offsets[i] + live_counts[i];
+	}
+	std::vector<int> adjacency(indices.size());
+	auto fill_offsets = adjacency_offsets;
+	for(int i = 0; i < indices.size(); i++) {
+		adjacency[fill_offsets[indices[i]]++] = i / 3;
+	}
+
+	std::vector<int> cache_times(vertex_count, 0);
+	std::vector<bool> emitted(triangle_count, false);
+	std::vector<GLuint> dead_ends;
+	std::vector<GLuint> candidates;
+	std::vector<GLuint> result;
+	result.reserve(indices.size());
+	auto time = VERTEX_CACHE_SIZE + 1;
+	auto cursor = 0;
+	auto fanning = -1;
+	while(cursor < vertex_count && live_counts[cursor] == 0) {
+		cursor++;
+	}
+	if(cursor < vertex_count) {
+		fanning = cursor;
+	}
+	while(fanning != -1) {
+		candidates.clear();
+		for(int i = adjacency_offsets[fanning]; i < adjacency_offsets[fanning + 1]; i++) {
+			auto triangle = adjacency[i];
+			if(emitted[triangle]) {
+				continue;
+			}
+			for(int j = 0; j < 3; j++) {
+				auto vertex = indices[triangle * 3 + j];
+				result.push_back(vertex);
+				dead_ends.push_back(vertex);
+				candidates.push_back(vertex);
+				live_counts[vertex]--;
+				if(time - cache_times[vertex] > VERTEX_CACHE_SIZE) {
+					cache_times[vertex] = time;
+					time++;
+				}
+			}
+			emitted[triangle] = true;
+		}
+
+		//a candidate that stays in the cache while its remaining triangles are emitted, then the dead end stack, then the next unused vertex
+		fanning = -1;
+		auto best_priority = -1;
+		for(auto vertex : candidates) {
+			if(live_counts[vertex] == 0) {
+				continue;
+			}
+			auto priority = 0;
+			if(time - cache_times[vertex] + 2 * live_counts[vertex] <= VERTEX_CACHE_SIZE) {
+				priority = time - cache_times[vertex];
+			}
+			if(priority > best_priority) {
+				best_priority = priority;
+				fanning = vertex;
+			}
+		}
+		while(fanning == -1 && !dead_ends.empty()) {
+			auto vertex = dead_ends.back();
+			dead_ends.pop_back();
+			if(live_counts[vertex] > 0) {
+				fanning = vertex;
+			}
+		}
+		while(fanning == -1 && cursor < vertex_count) {
+			if(live_counts[cursor] > 0) {
+				fanning = cursor;
+			}
+			cursor++;
+		}
+	}
+	indices.swap(result);
+}
+
+void optimize_overdraw(const std::vector<glm::vec3>& positions, std::vector<GLuint>& indices) {
+	//the cache optimized order is split where every vertex of a triangle misses the cache, so moving the clusters keeps the cache efficiency
+	std::vector<int> cluster_starts;
+	std::vector<int> load_times(positions.size(), -VERTEX_CACHE_SIZE - 1);
+	auto miss_count = 0;
+	for(int i = 0; i < indices.size(); i += 3) {
+		auto triangle_misses = 0;
+		for(int j = 0; j < 3; j++) {
+			auto index = indices[i + j];
+			if(miss_count - load_times[index] > VERTEX_CACHE_SIZE) {
+				load_times[index] = miss_count;
+				miss_count++;
+				triangle_misses++;
+			}
+		}
+		if(triangle_misses == 3 || i == 0) {
+			cluster_starts.push_back(i);
+		}
+	}
+	cluster_starts.push_back(indices.size());
+
+	//the clusters facing outwards go first, they are likely to occlude the others
+	glm::vec3 mesh_centroid = glm::vec3(0.0);
+	for(auto& position : positions) {
+		mesh_centroid += position / static_cast<float>(positions.size());
+	}
+	std::vector<std::pair<float, int>> cluster_keys;
+	for(int i = 0; i + 1 < cluster_starts.size(); i++) {
+		auto centroid = glm::vec3(0.0);
+		auto normal = glm::vec3(0.0);
+		auto area = 0.0f;
+		for(int j = cluster_starts[i]; j < cluster_starts[i + 1]; j += 3) {
+			auto& a = positions[indices[j]];
+			auto& b = positions[indices[j + 1]];
+			auto& c = positions[indices[j + 2]];
+			auto cross = glm::cross(b - a, c - a);
+			auto triangle_area = glm::length(cross);
+			centroid += (a + b + c) / 3.0f * triangle_area;
+			normal += cross;
+			area += triangle_area;
+		}
+		centroid = area > 0.0f ? centroid / area : mesh_centroid;
+		auto normal_length = glm::length(normal);
+		auto key = normal_length > 0.0f ? glm::dot(centroid - mesh_centroid, normal / normal_length) : 0.0f;
+		cluster_keys.push_back(std::make_pair(-key, i));
+	}
+	std::stable_sort(cluster_keys.begin(), cluster_keys.end(), [](const std::pair<float, int>& a, const std::pair<float, int>& b) {
+		return a.first < b.first;
+	});
+	std::vector<GLuint> result;
+	result.reserve(indices.size());
+	for(auto& cluster_key : cluster_keys) {
+		auto cluster = cluster_key.second;
+		result.insert(result.end(), indices.begin() + cluster_starts[cluster], indices.begin() + cluster_starts[cluster + 1]);
+	}
+	indices.swap(result);
+}
+
+void optimize_vertex_fetch(source_mesh_type& mesh) {
+	//the vertices are stored in the order of their first use, the unused ones are dropped
+	std::vector<int> remap(mesh.positions.size(), -1);
+	source_mesh_type result;
+	for(auto& index : mesh.indices) {
+		if(remap[index] == -1) {
+			remap[index] = result.positions.size();
+			result.positions.push_back(mesh.positions[index]);
+			result.normals.push_back(mesh.normals[index]);
+		}
+		index = remap[index];
+	}
+	mesh.positions.swap(result.positions);
+	mesh.normals.swap(result.normals);
+}
+
+void add_quadric(quadric_type& quadric, const quadric_type& other) {
+	for(int i = 0; i < 10; i++) {
+		quadric.values[i] += other.values[i];
+	}
+}
+
+double evaluate_quadric(const quadric_type& quadric, const glm::vec3& position) {
+	auto& q = quadric.values;
+	double x = position.x;
+	double y = position.y;
+	double z = position.z;
+	return q[0] * x * x + 2.0 * q[1] * x * y + 2.0 * q[2] * x * z + 2.0 * q[3] * x + q[4] * y * y + 2.0 * q[5] * y * z + 2.0 * q[6] * y + q[7] * z * z + 2.0 * q[8] * z + q[9];
+}
+
+void create_mesh_simplifier(const source_mesh_type& mesh, mesh_simplifier_type& simplifier) {
+	int vertex_count = mesh.positions.size();
+	simplifier.indices = mesh.indices;
+	simplifier.quadrics.assign(vertex_count, quadric_type());
+	simplifier.locked.assign(vertex_count, false);
+	simplifier.error = 0.0f;
+
+	//the quadrics sum the squared distances to the planes of the original triangles
+	for(int i = 0; i < mesh.indices.size(); i += 3) {
+		auto& a = mesh.positions[mesh.indices[i]];
+		auto normal = glm::cross(mesh.positions[mesh.indices[i + 1]] - a, mesh.positions[mesh.indices[i + 2]] - a);
+		auto length = glm::length(normal);
+		if(length == 0.0f) {
+			continue;
+		}
+		auto n = glm::dvec3(normal / length);
+		auto d = -glm::dot(n, glm::dvec3(a));
+		quadric_type quadric;
+		double plane_values[10] = {n.x * n.x, n.x * n.y, n.x * n.z, n.x * d, n.y * n.y, n.y * n.z, n.y * d, n.z * n.z, n.z * d, d * d};
+		std::copy(std::begin(plane_values), std::end(plane_values), quadric.values);
+		for(int j = 0; j < 3; j++) {
+			add_quadric(simplifier.quadrics[mesh.indices[i + j]], quadric);
+		}
+	}
+
+	//the vertices on normal seams and on borders stay, so the lods don't tear apart
+	std::vector<GLuint> order(vertex_count);
+	for(int i = 0; i < vertex_count; i++) {
+		order[i] = i;
+	}
+	auto position_key = [&mesh](const GLuint vertex) {
+		auto& p = mesh.positions[vertex];
+		return std::make_tuple(p.x, p.y, p.z);
+	};
+	std::sort(order.begin(), order.end(), [&position_key](const GLuint a, const GLuint b) {
+		return position_key(a) < position_key(b);
+	});
+	std::vector<GLuint> position_ids(vertex_count);
+	for(int i = 0; i < vertex_count; i++) {
+		auto seam = (i > 0 && position_key(order[i - 1]) == position_key(order[i])) || (i + 1 < vertex_count && position_key(order[i + 1]) == position_key(order[i]));
+		simplifier.locked[order[i]] = seam;
+		position_ids[order[i]] = i > 0 && position_key(order[i - 1]) == position_key(order[i]) ? position_ids[order[i - 1]] : i;
+	}
+	std::unordered_map<unsigned long long, int> edge_counts;
+	for(int i = 0; i < mesh.indices.size(); i++) {
+		auto a = position_ids[mesh.indices[i]];
+		auto b = position_ids[mesh.indices[i % 3 == 2 ? i - 2 : i + 1]];
+		edge_counts[(static_cast<unsigned long long>(min(a, b)) << 32) | max(a, b)]++;
+	}
+	for(int i = 0; i < mesh.indices.size(); i++) {
+		auto a = position_ids[mesh.indices[i]];
+		auto b = position_ids[mesh.indices[i % 3 == 2 ? i - 2 : i + 1]];
+		if(edge_counts[(static_cast<unsigned long long>(min(a, b)) << 32) | max(a, b)] == 1) {
+			simplifier.locked[mesh.indices[i]] = true;
+			simplifier.locked[mesh.indices[i % 3 == 2 ? i - 2 : i + 1]] = true;
+		}
+	}
+}
+
+bool does_collapse_flip(const std::vector<glm::vec3>& positions, const std::vector<GLuint>& indices, const std::vector<int>& adjacency, const int begin, const int end, const GLuint source, const GLuint target) {
+	for(int i = begin; i < end; i++) {
+		auto triangle = adjacency[i] * 3;
+		GLuint vertices[3] = {indices[triangle], indices[triangle + 1], indices[triangle + 2]};
+		if(vertices[0] == target || vertices[1] == target || vertices[2] == target) {
+			continue;
+		}
+		auto old_normal = glm::cross(positions[vertices[1]] - positions[vertices[0]], positions[vertices[2]] - positions[vertices[0]]);
+		for(auto& vertex : vertices) {
+			vertex = vertex == source ? target : vertex;
+		}
+		auto new_normal = glm::cross(positions[vertices[1]] - positions[vertices[0]], positions[vertices[2]] - positions[vertices[0]]);
+		if(glm::dot(old_normal, new_normal) <= 0.0f) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void simplify_mesh(const std::vector<glm::vec3>& positions, mesh_simplifier_type& simplifier, const int target_index_count) {
+	//edge collapses onto existing vertices, so every lod shares the vertex buffer
+	int vertex_count = positions.size();
+	auto& indices = simplifier.indices;
+	while(indices.size() > target_index_count) {
+		std::vector<int> adjacency_offsets(vertex_count + 1, 0);
+		for(auto index : indices) {
+			adjacency_offsets[index + 1]++;
+		}
+		for(int i = 0; i < vertex_count; i++) {
+			adjacency_offsets[i + 1] += adjacency_offsets[i];
+		}
+		std::vector<int> adjacency(indices.size());
+		auto fill_offsets = adjacency_offsets;
+		for(int i = 0; i < indices.size(); i++) {
+			adjacency[fill_offsets[indices[i]]++] = i / 3;
+		}
+
+		//every edge in its cheaper direction, the cheapest ones are collapsed first
+		std::vector<std::pair<double, std::pair<GLuint, GLuint>>> collapses;
+		for(int i = 0; i < indices.size(); i++) {
+			auto a = indices[i];
+			auto b = indices[i % 3 == 2 ? i - 2 : i + 1];
+			if(a > b) {
+				continue;
+			}
+			auto quadric = simplifier.quadrics[a];
+			add_quadric(quadric, simplifier.quadrics[b]);
+			auto cost_to_b = simplifier.locked[a] ? INFINITY : evaluate_quadric(quadric, positions[b]);
+			auto cost_to_a = simplifier.locked[b] ? INFINITY : evaluate_quadric(quadric, positions[a]);
+			if(cost_to_b != INFINITY || cost_to_a != INFINITY) {
+				collapses.push_back(cost_to_b <= cost_to_a ? std::make_pair(cost_to_b, std::make_pair(a, b)) : std::make_pair(cost_to_a, std::make_pair(b, a)));
+			}
+		}
+		std::sort(collapses.begin(), collapses.end());
+
+		//a collapse changes the triangles around its source, so their vertices wait for the next pass
+		std::vector<bool> touched(vertex_count, false);
+		std::vector<GLuint> remap(vertex_count);
+		for(int i = 0; i < vertex_count; i++) {
+			remap[i] = i;
+		}
+		int removed_index_count = 0;
+		int needed_index_count = indices.size() - target_index_count;
+		for(auto& collapse : collapses) {
+			if(removed_index_count >= needed_index_count) {
+				break;
+			}
+			auto source = collapse.second.first;
+			auto target = collapse.second.second;
+			if(touched[source] || touched[target] || does_collapse_flip(positions, indices, adjacency, adjacency_offsets[source], adjacency_offsets[source + 1], source, target)) {
+				continue;
+			}
+			remap[source] = target;
+			add_quadric(simplifier.quadrics[target], simplifier.quadrics[source]);
+			simplifier.error = max(simplifier.error, static_cast<float>(glm::sqrt(max(collapse.first, 0.0))));
+			for(int i = adjacency_offsets[source]; i < adjacency_offsets[source + 1]; i++) {
+				auto triangle = adjacency[i] * 3;
+				auto degenerate = false;
+				for(int j = 0; j < 3; j++) {
+					touched[indices[triangle + j]] = true;
+					degenerate = degenerate || indices[triangle + j] == target;
+				}
+				removed_index_count += degenerate ? 3 : 0;
+			}
+		}
+		if(removed_index_count == 0) {
+			return;
+		}
+		std::vector<GLuint> result;
+		result.reserve(indices.size() - removed_index_count);
+		for(int i = 0; i < indices.size(); i += 3) {
+			auto a = remap[indices[i]];
+			auto b = remap[indices[i + 1]];
+			auto c = remap[indices[i + 2]];
+			if(a != b && b != c && c != a) {
+				result.insert(result.end(), {a, b, c});
+			}
+		}
+		indices.swap(result);
+	}
+}
+
+meshlet_type create_meshlet(const source_mesh_type& mesh, const GLuint first_index, const GLuint index_count) {
+	meshlet_type meshlet;
+	meshlet.first_index = first_index;
+	meshlet.index_count = index_count;
+	auto aabb_min = glm::vec3(INFINITY);
+	auto aabb_max = glm::vec3(-INFINITY);
+	for(GLuint i = first_index; i < first_index + index_count; i++) {
+		aabb_min = glm::min(aabb_min, mesh.positions[mesh.indices[i]]);
+		aabb_max = glm::max(aabb_max, mesh.positions[mesh.indices[i]]);
+	}
+	auto center = (aabb_min + aabb_max) / 2.0f;
+	auto radius = 0.0f;
+	for(GLuint i = first_index; i < first_index + index_count; i++) {
+		radius = max(radius, glm::distance(center, mesh.positions[mesh.indices[i]]));
+	}
+	meshlet.sphere = glm::vec4(center, radius);
+
+	//the cone around the average normal contains every triangle's normal, degenerate triangles don't count
+	std::vector<glm::vec3> normals;
+	auto axis = glm::vec3(0.0);
+	for(GLuint i = first_index; i < first_index + index_count; i += 3) {
+		auto& a = mesh.positions[mesh.indices[i]];
+		auto normal = glm::cross(mesh.positions[mesh.indices[i + 1]] - a, mesh.positions[mesh.indices[i + 2]] - a);
+		auto length = glm::length(normal);
+		if(length > 0.0f) {
+			normals.push_back(normal / length);
+			axis += normal / length;
+		}
+	}
+	auto axis_length = glm::length(axis);
+	if(axis_length == 0.0f) {
+		return meshlet;
+	}
+	axis /= axis_length;
+	auto min_dot = 1.0f;
+	for(auto& normal : normals) {
+		min_dot = min(min_dot, glm::dot(normal, axis));
+	}
+	//a cone wider than a hemisphere always has a triangle facing the view
+	if(min_dot > 0.0f) {
+		meshlet.cone = glm::vec4(axis, glm::sqrt(1.0f - min_dot * min_dot));
+	}
+	return meshlet;
+}
+
+void build_meshlets(source_mesh_type& mesh) {
+	//consecutive triangles are grouped until the vertex or the triangle limit, so the meshlets keep the optimized order
+	std::vector<int> vertex_meshlets(mesh.positions.size(), -1);
+	mesh.meshlets.clear();
+	for(auto& lod : mesh.lods) {
+		lod.first_meshlet = mesh.meshlets.size();
+		auto first_index = lod.first_index;
+		auto vertex_count = 0;
+		for(GLuint i = lod.first_index; i < lod.first_index + lod.index_count; i += 3) {
+			auto meshlet = static_cast<int>(mesh.meshlets.size());
+			auto new_vertex_count = 0;
+			for(int j = 0; j < 3; j++) {
+				auto index = mesh.indices[i + j];
+				if(vertex_meshlets[index] != meshlet && (j < 1 || index != mesh.indices[i]) && (j < 2 || index != mesh.indices[i + 1])) {
+					new_vertex_count++;
+				}
+			}
+			if(vertex_count + new_vertex_count > MESHLET_MAX_VERTEX_COUNT || (i - first_index) / 3 >= MESHLET_MAX_TRIANGLE_COUNT) {
+				mesh.meshlets.push_back(create_meshlet(mesh, first_index, i - first_index));
+				first_index = i;
+				vertex_count = 0;
+				meshlet++;
+			}
+			for(int j = 0; j < 3; j++) {
+				auto index = mesh.indices[i + j];
+				if(vertex_meshlets[index] != meshlet) {
+					vertex_meshlets[index] = meshlet;
+					vertex_count++;
+				}
+			}
+		}
+		if(first_index < lod.first_index + lod.index_count) {
+			mesh.meshlets.push_back(create_meshlet(mesh, first_index, lod.first_index + lod.index_count - first_index));
+		}
+		lod.meshlet_count = mesh.meshlets.size() - lod.first_meshlet;
+	}
+}
+
+void optimize_mesh(const std::string& path, source_mesh_type& mesh, std::vector<std::string>& log) {
+	int vertex_count = mesh.positions.size();
+	auto triangle_count = max(static_cast<int>(mesh.indices.size() / 3), 1);
+	auto miss_count = get_vertex_cache_miss_count(mesh.indices, vertex_count);
+	weld_vertices(mesh);
+
+	//every lod halves the triangles of the previous one, until the simplification can't keep up
+	std::vector<std::vector<GLuint>> lod_indices = {mesh.indices};
+	std::vector<float> lod_errors = {0.0f};
+	mesh_simplifier_type simplifier;
+	create_mesh_simplifier(mesh, simplifier);
+	while(lod_indices.size() < MAX_MESH_LOD_COUNT && lod_indices.back().size() / 6 >= MIN_LOD_TRIANGLE_COUNT) {
+		simplify_mesh(mesh.positions, simplifier, lod_indices.back().size() / 6 * 3);
+		if(simplifier.indices.size() > lod_indices.back().size() * 3 / 4) {
+			break;
+		}
+		lod_indices.push_back(simplifier.indices);
+		lod_errors.push_back(simplifier.error);
+	}
+	mesh.indices.clear();
+	mesh.lods.clear();
+	for(int i = 0; i < lod_indices.size(); i++) {
+		optimize_vertex_cache(lod_indices[i], mesh.positions.size());
+		if(i == 0) {
+			optimize_overdraw(mesh.positions, lod_indices[i]);
+		}
+		mesh_lod_type lod;
+		lod.first_index = mesh.indices.size();
+		lod.index_count = lod_indices[i].size();
+		lod.error = lod_errors[i];
+		mesh.lods.push_back(lod);
+		mesh.indices.insert(mesh.indices.end(), lod_indices[i].begin(), lod_indices[i].end());
+	}
+	//the first lod decides the vertex order, the others fetch the same vertices
+	optimize_vertex_fetch(mesh);
+	build_meshlets(mesh);
+	int optimized_vertex_count = mesh.positions.size();
+	std::vector<GLuint> first_lod(mesh.indices.begin(), mesh.indices.begin() + mesh.lods[0].index_count);
+	auto optimized_miss_count = get_vertex_cache_miss_count(first_lod, optimized_vertex_count);
+
+	//acmr is the cache misses per triangle, atvr is the misses per vertex, 1.0 is the best possible atvr
+	std::stringstream stream;
+	stream << "MESH, optimized " << path << ": " << vertex_count << " -> " << optimized_vertex_count << " vertices, ";
+	stream << "acmr " << static_cast<float>(miss_count) / triangle_count << " -> " << static_cast<float>(optimized_miss_count) / triangle_count << ", ";
+	stream << "atvr " << static_cast<float>(miss_count) / max(vertex_count, 1) << " -> " << static_cast<float>(optimized_miss_count) / max(optimized_vertex_count, 1) << ", lods:";
+	for(auto& lod : mesh.lods) {
+		stream << " " << lod.index_count / 3 << " triangles in " << lod.meshlet_count << " meshlets (error " << lod.error << ")";
+	}
+	log.push_back(stream.str());
+}
+
+std::vector<char> cook_mesh(const source_scene_type& scene, const unsigned long long source_hash, const GLuint vertex_format) {
+	//the meshes are concatenated, their lods and meshlets are moved to their ranges of the shared streams
+	cooked_mesh_header_type header = {};
+	std::memcpy(header.magic, COOKED_MESH_MAGIC, sizeof(header.magic));
+	header.version = COOKED_MESH_VERSION;
+	header.source_hash = source_hash;
+	header.vertex_format = vertex_format;
+	std::vector<cooked_submesh_type> submeshes;
+	std::vector<meshlet_type> meshlets;
+	GLuint max_vertex_count = 0;
+	for(auto& mesh : scene.meshes) {
+		cooked_submesh_type submesh = {};
+		submesh.base_vertex = header.vertex_count;
+		submesh.vertex_count = mesh.positions.size();
+		submesh.lod_count = mesh.lods.size();
+		submesh.aabb_min = glm::vec3(INFINITY);
+		submesh.aabb_max = glm::vec3(-INFINITY);
+		for(auto& position : mesh.positions) {
+			submesh.aabb_min = glm::min(submesh.aabb_min, position);
+			submesh.aabb_max = glm::max(submesh.aabb_max, position);
+		}
+		for(int i = 0; i < mesh.lods.size(); i++) {
+			submesh.lods[i] = mesh.lods[i];
+			submesh.lods[i].first_index += header.index_count;
+			submesh.lods[i].first_meshlet += meshlets.size();
+		}
+		for(auto meshlet : mesh.meshlets) {
+			meshlet.first_index += header.index_count;
+			meshlets.push_back(meshlet);
+		}
+		submeshes.push_back(submesh);
+		header.vertex_count += mesh.positions.size();
+		header.index_count += mesh.indices.size();
+		max_vertex_count = max(max_vertex_count, submesh.vertex_count);
+	}
+	header.meshlet_count = meshlets.size();
+	header.submesh_count = submeshes.size();
+	header.instance_count = scene.instances.size();
+	auto quantized = vertex_format == COOKED_VERTEX_FORMAT_QUANTIZED;
+	auto position_size = quantized ? sizeof(GLuint64) : sizeof(glm::vec3);
+	auto normal_size = quantized ? sizeof(GLuint) : sizeof(glm::vec3);
+	//the indices are relative to their mesh's first vertex, so 16 bits are enough if every mesh is small enough
+	auto index_size = get_cooked_index_size(max_vertex_count);
+	header.position_offset = get_cooked_mesh_aligned_offset(sizeof(cooked_mesh_header_type));
+	header.normal_offset = get_cooked_mesh_aligned_offset(header.position_offset + header.vertex_count * position_size);
+	header.index_offset = get_cooked_mesh_aligned_offset(header.normal_offset + header.vertex_count * normal_size);
+	header.meshlet_offset = get_cooked_mesh_aligned_offset(header.index_offset + header.index_count * index_size);
+	header.submesh_offset = get_cooked_mesh_aligned_offset(header.meshlet_offset + header.meshlet_count * sizeof(meshlet_type));
+	header.instance_offset = get_cooked_mesh_aligned_offset(header.submesh_offset + header.submesh_count * sizeof(cooked_submesh_type));
+
+	std::vector<char> data(get_cooked_mesh_aligned_offset(header.instance_offset + header.instance_count * sizeof(mesh_instance_type)));
+	std::memcpy(data.data(), &header, sizeof(cooked_mesh_header_type));
+	GLuint first_index = 0;
+	for(int i = 0; i < scene.meshes.size(); i++) {
+		auto& mesh = scene.meshes[i];
+		auto& submesh = submeshes[i];
+		auto positions = data.data() + header.position_offset + submesh.base_vertex * position_size;
+		auto normals = data.data() + header.normal_offset + submesh.base_vertex * normal_size;
+		if(quantized) {
+			//16 bit positions in the unit cube of the mesh's aabb, padded to 8 bytes, and 10:10:10:2 normals
+			auto extent = glm::max(submesh.aabb_max - submesh.aabb_min, glm::vec3(MIN_QUANTIZATION_EXTENT));
+			for(int j = 0; j < submesh.vertex_count; j++) {
+				auto position = glm::packUnorm4x16(glm::vec4((mesh.positions[j] - submesh.aabb_min) / extent, 0.0));
+				auto normal = glm::packSnorm3x10_1x2(glm::vec4(mesh.normals[j], 0.0));
+				std::memcpy(positions + j * position_size, &position, position_size);
+				std::memcpy(normals + j * normal_size, &normal, normal_size);
+			}
+		} else {
+			std::memcpy(positions, mesh.positions.data(), submesh.vertex_count * position_size);
+			std::memcpy(normals, mesh.normals.data(), submesh.vertex_count * normal_size);
+		}
+		for(int j = 0; j < mesh.indices.size(); j++) {
+			auto index = mesh.indices[j];
+			auto short_index = static_cast<unsigned short>(index);
+			std::memcpy(data.data() + header.index_offset + (first_index + j) * index_size, index_size == sizeof(GLuint) ? static_cast<const void*>(&index) : &short_index, index_size);
+		}
+		first_index += mesh.indices.size();
+	}
+	std::memcpy(data.data() + header.meshlet_offset, meshlets.data(), header.meshlet_count * sizeof(meshlet_type));
+	std::memcpy(data.data() + header.submesh_offset, submeshes.data(), header.submesh_count * sizeof(cooked_submesh_type));
+	std::memcpy(data.data() + header.instance_offset, scene.instances.data(), header.instance_count * sizeof(mesh_instance_type));
+	return data;
+}
+
+void read_cooked_mesh(const char* cooked_data, mesh_data_type& data) {
+	auto header = reinterpret_cast<const cooked_mesh_header_type*>(cooked_data);
+	auto submeshes = reinterpret_cast<const cooked_submesh_type*>(cooked_data + header->submesh_offset);
+	auto instances = reinterpret_cast<const mesh_instance_type*>(cooked_data + header->instance_offset);
+	auto quantized = header->vertex_format == COOKED_VERTEX_FORMAT_QUANTIZED;
+	auto position_size = quantized ? sizeof(GLuint64) : sizeof(glm::vec3);
+	auto normal_size = quantized ? sizeof(GLuint) : sizeof(glm::vec3);
+	GLuint max_vertex_count = 0;
+	for(int i = 0; i < header->submesh_count; i++) {
+		max_vertex_count = max(max_vertex_count, submeshes[i].vertex_count);
+	}
+	auto index_size = get_cooked_index_size(max_vertex_count);
+	data.buffers.push_back({cooked_data + header->position_offset, static_cast<GLsizeiptr>(header->vertex_count * position_size)});
+	data.buffers.push_back({cooked_data + header->normal_offset, static_cast<GLsizeiptr>(header->vertex_count * normal_size)});
+	data.buffers.push_back({cooked_data + header->index_offset, static_cast<GLsizeiptr>(header->index_count * index_size)});
+	data.index_buffer = 2;
+	if(header->meshlet_count > 0) {
+		data.buffers.push_back({cooked_data + header->meshlet_offset, static_cast<GLsizeiptr>(header->meshlet_count * sizeof(meshlet_type))});
+		data.meshlet_buffer = 3;
+	}
+	data.vertex_count = header->vertex_count;
+	data.index_count = header->index_count;
+	data.index_type = index_size == sizeof(GLuint) ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+	if(quantized) {
+		data.positions = {0, 0, static_cast<GLsizei>(position_size), 4, GL_UNSIGNED_SHORT, GL_TRUE};
+		data.normals = {1, 0, static_cast<GLsizei>(normal_size), 4, GL_INT_2_10_10_10_REV, GL_TRUE};
+	} else {
+		data.positions = {0, 0, static_cast<GLsizei>(position_size)};
+		data.normals = {1, 0, static_cast<GLsizei>(normal_size)};
+	}
+	for(int i = 0; i < header->submesh_count; i++) {
+		auto& submesh = submeshes[i];
+		mesh_type mesh;
+		mesh.base_vertex = submesh.base_vertex;
+		mesh.index_type = data.index_type;
+		mesh.lod_count = max(static_cast<int>(submesh.lod_count), 1);
+		std::copy(submesh.lods, submesh.lods + submesh.lod_count, mesh.lods);
+		for(int j = 0; j < submesh.lod_count; j++) {
+			mesh.index_count += submesh.lods[j].index_count;
+		}
+		if(quantized) {
+			//the mesh's space is the unit cube, the model matrix scales it back to the aabb
+			auto extent = glm::max(submesh.aabb_max - submesh.aabb_min, glm::vec3(MIN_QUANTIZATION_EXTENT));
+			mesh.dequantization = glm::scale(glm::translate(glm::mat4(1.0), submesh.aabb_min), extent);
+			mesh.aabb_min = glm::vec3(0.0);
+			mesh.aabb_max = glm::vec3(1.0);
+		} else {
+			mesh.aabb_min = submesh.aabb_min;
+			mesh.aabb_max = submesh.aabb_max;
+		}
+		data.meshes.push_back(mesh);
+	}
+	data.instances.assign(instances, instances + header->instance_count);
+}
+
+void release_mesh_data(mesh_data_type& data) {
+	unmap_file(data.mapped_file);
+	data = mesh_data_type();
+}
+
+void skip_json_whitespace(const char*& c, const char* end) {
+	while(c < end && (*c == ' ' || *c == '\t' || *c == '\n' || *c == '\r')) {
+		c++;
+	}
+}
+
+bool parse_json_string(const char*& c, const char* end, std::string& string) {
+	if(c >= end || *c != '"') {
+		return false;
+	}
+	c++;
+	while(c < end && *c != '"') {
+		if(*c == '\\' && c + 1 < end) {
+			c++;
+			//the names the loader looks for are plain ascii, so unicode escapes are only skipped
+			if(*c == 'u') {
+				c += 4;
+				string += '?';
+			} else {
+				string += *c == 'n' ? '\n' : *c == 't' ? '\t' : *c == 'r' ? '\r' : *c == 'b' ? '\b' : *c == 'f' ? '\f' : *c;
+			}
+		} else {
+			string += *c;
+		}
+		c++;
+	}
+	if(c >= end) {
+		return false;
+	}
+	c++;
+	return true;
+}
+
+bool parse_json_value(const char*& c, const char* end, json_value_type& value) {
+	skip_json_whitespace(c, end);
+	if(c >= end) {
+		return false;
+	}
+	if(*c == '{' || *c == '[') {
+		auto is_object = *c == '{';
+		auto closing = is_object ? '}' : ']';
+		value.type = is_object ? JSON_TYPE_OBJECT : JSON_TYPE_ARRAY;
+		c++;
+		skip_json_whitespace(c, end);
+		if(c < end && *c == closing) {
+			c++;
+			return true;
+		}
+		while(true) {
+			if(is_object) {
+				std::string key;
+				skip_json_whitespace(c, end);
+				if(!parse_json_string(c, end, key)) {
+					return false;
+				}
+				skip_json_whitespace(c, end);
+				if(c >= end || *c != ':') {
+					return false;
+				}
+				c++;
+				value.keys.push_back(key);
+			}
+			value.values.push_back(json_value_type());
+			if(!parse_json_value(c, end, value.values.back())) {
+				return false;
+			}
+			skip_json_whitespace(c, end);
+			if(c < end && *c == ',') {
+				c++;
+			} else if(c < end && *c == closing) {
+				c++;
+				return true;
+			} else {
+				return false;
+			}
+		}
+	}
+	if(*c == '"') {
+		value.type = JSON_TYPE_STRING;
+		return parse_json_string(c, end, value.string);
+	}
+	if(end - c >= 4 && std::strncmp(c, "true", 4) == 0) {
+		value.type = JSON_TYPE_BOOL;
+		value.number = 1.0;
+		c += 4;
+		return true;
+	}
+	if(end - c >= 5 && std::strncmp(c, "false", 5) == 0) {
+		value.type = JSON_TYPE_BOOL;
+		c += 5;
+		return true;
+	}
+	if(end - c >= 4 && std::strncmp(c, "null", 4) == 0) {
+		value.type = JSON_TYPE_NULL;
+		c += 4;
+		return true;
+	}
+	//the chunk isn't null terminated, so the number is copied before converting it
+	std::string number;
+	while(c < end && std::strchr("+-0123456789.eE", *c)) {
+		number += *c;
+		c++;
+	}
+	if(number.empty()) {
+		return false;
+	}
+	value.type = JSON_TYPE_NUMBER;
+	value.number = std::strtod(number.c_str(), nullptr);
+	return true;
+}
+
+const json_value_type* get_json_member(const json_value_type* object, const std::string& key) {
+	if(!object || object->type != JSON_TYPE_OBJECT) {
+		return nullptr;
+	}
+	for(int i = 0; i < object->keys.size(); i++) {
+		if(object->keys[i] == key) {
+			return &object->values[i];
+		}
+	}
+	return nullptr;
+}
+
+const json_value_type* get_json_element(const json_value_type* array, const int index) {
+	if(!array || array->type != JSON_TYPE_ARRAY || index < 0 || index >= array->values.size()) {
+		return nullptr;
+	}
+	return &array->values[index];
+}
+
+int get_json_int(const json_value_type* value, const int default_value) {
+	if(!value || value->type != JSON_TYPE_NUMBER) {
+		return default_value;
+	}
+	//a number out of the int range is reported as -1, which every caller rejects as an index, count or offset
+	return value->number >= INT_MIN && value->number <= INT_MAX ? static_cast<int>(value->number) : -1;
+}
+
+double get_json_number(const json_value_type* value, const double default_value) {
+	return value && value->type == JSON_TYPE_NUMBER ? value->number : default_value;
+}
+
+glm::mat4 get_glb_node_transform(const json_value_type* node) {
+	//either a column major matrix, or a translation, a rotation, and a scale
+	auto matrix = get_json_member(node, "matrix");
+	auto transform = glm::mat4(1.0);
+	if(matrix && matrix->values.size() == 16) {
+		for(int i = 0; i < 16; i++) {
+			transform[i / 4][i % 4] = get_json_number(&matrix->values[i], 0.0);
+		}
+		return transform;
+	}
+	auto translation = get_json_member(node, "translation");
+	auto rotation = get_json_member(node, "rotation");
+	auto scale = get_json_member(node, "scale");
+	if(translation && translation->values.size() == 3) {
+		transform = glm::translate(transform, glm::vec3(get_json_number(&translation->values[0], 0.0), get_json_number(&translation->values[1], 0.0), get_json_number(&translation->values[2], 0.0)));
+	}
+	if(rotation && rotation->values.size() == 4) {
+		//gltf stores the quaternion as x, y, z, w
+		transform *= glm::mat4_cast(glm::quat(get_json_number(&rotation->values[3], 1.0), get_json_number(&rotation->values[0], 0.0), get_json_number(&rotation->values[1], 0.0), get_json_number(&rotation->values[2], 0.0)));
+	}
+	if(scale && scale->values.size() == 3) {
+		transform = glm::scale(transform, glm::vec3(get_json_number(&scale->values[0], 1.0), get_json_number(&scale->values[1], 1.0), get_json_number(&scale->values[2], 1.0)));
+	}
+	return transform;
+}
+
+bool get_glb_accessor(const json_value_type& gltf, const uint64_t bin_size, const int accessor_index, glb_accessor_type& accessor, std::string& error) {
+	auto json_accessor = get_json_element(get_json_member(&gltf, "accessors"), accessor_index);
+	if(!json_accessor) {
+		error = "missing accessor";
+		return false;
+	}
+	if(get_json_member(json_accessor, "sparse")) {
+		error = "sparse accessor";
+		return false;
+	}
+	auto type = get_json_member(json_accessor, "type");
+	auto json_buffer_view = get_json_element(get_json_member(&gltf, "bufferViews"), get_json_int(get_json_member(json_accessor, "bufferView"), -1));
+	if(!json_buffer_view || get_json_int(get_json_member(json_buffer_view, "buffer"), -1) != 0 || !type) {
+		error = "the accessor's data isn't in the bin chunk";
+		return false;
+	}
+	accessor.buffer_view = get_json_int(get_json_member(json_accessor, "bufferView"), -1);
+	accessor.component_type = get_json_int(get_json_member(json_accessor, "componentType"), 0);
+	accessor.component_count = type->string == "SCALAR" ? 1 : type->string == "VEC2" ? 2 : type->string == "VEC3" ? 3 : type->string == "VEC4" ? 4 : 0;
+	accessor.count = get_json_int(get_json_member(json_accessor, "count"), 0);
+	auto offset = get_json_int(get_json_member(json_accessor, "byteOffset"), 0);
+	auto view_offset = get_json_int(get_json_member(json_buffer_view, "byteOffset"), 0);
+	auto view_size = get_json_int(get_json_member(json_buffer_view, "byteLength"), 0);
+	auto component_size = accessor.component_type == GL_UNSIGNED_SHORT ? 2 : accessor.component_type == GL_UNSIGNED_BYTE || accessor.component_type == GL_BYTE ? 1 : 4;
+	auto element_size = component_size * accessor.component_count;
+	auto stride = get_json_int(get_json_member(json_buffer_view, "byteStride"), element_size);
+	if(offset < 0 || view_offset < 0 || view_size < 0 || stride < 0) {
+		error = "negative offset, length or stride";
+		return false;
+	}
+	accessor.offset = offset;
+	accessor.view_offset = view_offset;
+	accessor.view_size = view_size;
+	accessor.stride = stride;
+	auto min = get_json_member(json_accessor, "min");
+	auto max = get_json_member(json_accessor, "max");
+	for(int i = 0; i < 3 && min && max; i++) {
+		accessor.min[i] = get_json_element(min, i) ? get_json_element(min, i)->number : 0.0;
+		accessor.max[i] = get_json_element(max, i) ? get_json_element(max, i)->number : 0.0;
+	}
+	accessor.has_bounds = min && max;
+	//in 64 bits, so a large count or stride can't wrap around
+	if(accessor.count <= 0 || accessor.component_count == 0 || static_cast<uint64_t>(accessor.view_offset) + accessor.view_size > bin_size || accessor.offset + static_cast<uint64_t>(accessor.count - 1) * accessor.stride + element_size > accessor.view_size) {
+		error = "the accessor is out of its buffer view";
+		return false;
+	}
+	return true;
+}
+
+bool read_glb_mesh(mapped_file_type& source_file, mesh_data_type& data, std::string& error) {
+	//the data takes over the mapping, the buffers point into it
+	data.mapped_file = source_file;
+	source_file = mapped_file_type();
+	auto& file = data.mapped_file;
+	//a 12 byte header, then the json chunk and the bin chunk, each with an 8 byte header
+	//the sizes are compared in 64 bits before any pointer is formed, so a corrupt length can't wrap around or point past the file
+	auto words = reinterpret_cast<const GLuint*>(file.data);
+	if(file.size < 20 || words[0] != GLB_MAGIC || words[1] != 2 || words[4] != GLB_CHUNK_JSON || 20 + static_cast<uint64_t>(words[3]) + 8 > file.size) {
+		error = "not a gltf 2 binary";
+		return false;
+	}
+	auto json_begin = file.data + 20;
+	auto json_end = json_begin + words[3];
+	//the check above guarantees the bin chunk's header is in the file
+	auto bin_words = reinterpret_cast<const GLuint*>(json_end);
+	auto bin = json_end + 8;
+	auto bin_size = static_cast<uint64_t>(bin_words[0]);
+	if(bin_words[1] != GLB_CHUNK_BIN || bin_size > file.size - (bin - file.data)) {
+		error = "missing bin chunk";
+		return false;
+	}
+	json_value_type gltf;
+	auto c = json_begin;
+	if(!parse_json_value(c, json_end, gltf)) {
+		error = "invalid json chunk";
+		return false;
+	}
+
+	//a file with one node, mesh, and primitive is uploaded as authored, the others are flattened by assimp
+	auto meshes = get_json_member(&gltf, "meshes");
+	auto nodes = get_json_member(&gltf, "nodes");
+	auto primitives = get_json_member(get_json_element(meshes, 0), "primitives");
+	auto primitive = get_json_element(primitives, 0);
+	auto attributes = get_json_member(primitive, "attributes");
+	glb_accessor_type positions;
+	glb_accessor_type normals;
+	glb_accessor_type indices;
+	if(!meshes || meshes->values.size() != 1 || !primitives || primitives->values.size() != 1 || !nodes || nodes->values.size() != 1 || get_json_int(get_json_member(&nodes->values[0], "mesh"), -1) != 0) {
+		error = "the file has more than one node, mesh, or primitive";
+	} else if(!primitive || get_json_int(get_json_member(primitive, "mode"), GL_TRIANGLES) != GL_TRIANGLES) {
+		error = "the first primitive isn't a triangle list";
+	} else if(!get_glb_accessor(gltf, bin_size, get_json_int(get_json_member(attributes, "POSITION"), -1), positions, error) || !get_glb_accessor(gltf, bin_size, get_json_int(get_json_member(attributes, "NORMAL"), -1), normals, error) || !get_glb_accessor(gltf, bin_size, get_json_int(get_json_member(primitive, "indices"), -1), indices, error)) {
+		error = "positions, normals or indices: " + error;
+	} else if(positions.component_type != GL_FLOAT || positions.component_count != 3 || !positions.has_bounds || normals.component_type != GL_FLOAT || normals.component_count != 3 || normals.count != positions.count) {
+		error = "the positions or the normals aren't float vec3s";
+	} else if((indices.component_type != GL_UNSIGNED_SHORT && indices.component_type != GL_UNSIGNED_INT) || indices.component_count != 1 || indices.stride != (indices.component_type == GL_UNSIGNED_SHORT ? 2 : 4)) {
+		error = "the indices aren't tightly packed 16 or 32 bit integers";
+	} else if(indices.count % 3 != 0) {
+		error = "the index count isn't a multiple of 3";
+	} else {
+		//the optimizer indexes its per-vertex arrays with these, so an index past the vertices can't reach it
+		auto index_data = bin + indices.view_offset + indices.offset;
+		for(int i = 0; i < indices.count && error.empty(); i++) {
+			GLuint index = 0;
+			if(indices.component_type == GL_UNSIGNED_SHORT) {
+				unsigned short short_index;
+				std::memcpy(&short_index, index_data + i * 2, 2);
+				index = short_index;
+			} else {
+				std::memcpy(&index, index_data + i * 4, 4);
+			}
+			if(index >= static_cast<GLuint>(positions.count)) {
+				error = "an index is out of the vertices";
+			}
+		}
+	}
+	if(!error.empty()) {
+		return false;
+	}
+
+	//the buffer views are uploaded straight from the mapped file, the accessors' offsets and strides go to the vertex array
+	std::unordered_map<int, int> view_buffers;
+	for(auto stream : {std::make_pair(&data.positions, &positions), std::make_pair(&data.normals, &normals)}) {
+		auto& accessor = *stream.second;
+		if(view_buffers.find(accessor.buffer_view) == view_buffers.end()) {
+			view_buffers[accessor.buffer_view] = data.buffers.size();
+			data.buffers.push_back({bin + accessor.view_offset, accessor.view_size});
+		}
+		*stream.first = {view_buffers[accessor.buffer_view], accessor.offset, static_cast<GLsizei>(accessor.stride)};
+	}
+	auto index_size = indices.component_type == GL_UNSIGNED_SHORT ? 2 : 4;
+	data.index_buffer = data.buffers.size();
+	data.buffers.push_back({bin + indices.view_offset + indices.offset, static_cast<GLsizeiptr>(indices.count) * index_size});
+	data.vertex_count = positions.count;
+	data.index_count = indices.count;
+	data.index_type = indices.component_type;
+	mesh_type mesh;
+	mesh.index_count = indices.count;
+	mesh.index_type = indices.component_type;
+	mesh.lods[0].index_count = indices.count;
+	mesh.aabb_min = positions.min;
+	mesh.aabb_max = positions.max;
+	data.meshes.push_back(mesh);
+	mesh_instance_type instance;
+	instance.transform = get_glb_node_transform(&nodes->values[0]);
+	data.instances.push_back(instance);
+	return true;
+}
+
+bool import_mesh(const std::string& path, const unsigned int import_flags, mesh_data_type& data, std::string& error, std::vector<std::string>& log) {
+	mapped_file_type source_file;
+	if(!map_file(path, source_file)) {
+		error = "the file can't be opened";
+		return false;
+	}
+	//the import flags and the vertex format are mixed into the hash, so differently imported meshes don't share a cooked file
+	auto vertex_format = mesh_cache.quantize_vertices ? COOKED_VERTEX_FORMAT_QUANTIZED : COOKED_VERTEX_FORMAT_FLOAT;
+	auto source_hash = hash_bytes(source_file.data, source_file.size) ^ (import_flags * 0x100000001B3ull) ^ (vertex_format * 0x9E3779B97F4A7C15ull);
+
+	//the cooked file is named after the source's hash, so a changed source is cooked again
+	std::stringstream cooked_path;
+	cooked_path << path << "." << std::hex << source_hash << ".mesh";
+	if(mesh_cache.enabled && map_file(cooked_path.str(), data.mapped_file)) {
+		if(is_cooked_mesh_valid(data.mapped_file, source_hash)) {
+			read_cooked_mesh(data.mapped_file.data, data);
+			mesh_cache.cached_mesh_count++;
+			unmap_file(source_file);
+			return true;
+		}
+		unmap_file(data.mapped_file);
+	}
+
+	//gltf binaries are read from the mapping the hash was computed from, and without the cache they are uploaded straight from the file as authored
+	source_scene_type scene;
+	auto glb_read = false;
+	if(path.size() >= 4 && path.compare(path.size() - 4, 4, ".glb") == 0) {
+		if(read_glb_mesh(source_file, data, error)) {
+			mesh_cache.glb_mesh_count++;
+			if(!mesh_cache.enabled) {
+				return true;
+			}
+			read_mesh_data_streams(data, scene);
+			glb_read = true;
+		} else {
+			log.push_back("GLB, WARNING, " + path + ": " + error + ", falling back to assimp");
+			error.clear();
+		}
+		release_mesh_data(data);
+	}
+	unmap_file(source_file);
+	if(!glb_read) {
+		if(!read_assimp_scene(path, import_flags, scene, error)) {
+			return false;
+		}
+		mesh_cache.imported_mesh_count++;
+	}
+	for(int i = 0; i < scene.meshes.size(); i++) {
+		optimize_mesh(scene.meshes.size() > 1 ? path + " mesh " + std::to_string(i + 1) : path, scene.meshes[i], log);
+	}
+	log.push_back("MESH, " + path + ": " + std::to_string(scene.meshes.size()) + " meshes, " + std::to_string(scene.instances.size()) + " instances");
+	data.cooked_data = cook_mesh(scene, source_hash, vertex_format);
+	if(mesh_cache.enabled) {
+		std::ofstream file(cooked_path.str(), std::ios::binary);
+		file.write(data.cooked_data.data(), data.cooked_data.size());
+		if(!file) {
+			log.push_back("MESH, WARNING, " + cooked_path.str() + ": the cooked mesh can't be written");
+		}
+	}
+	read_cooked_mesh(data.cooked_data.data(), data);
+	return true;
+}
+
+void create_asset_loader() {
+	auto& loader = asset_loader;
+	auto flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	loader.staging_buffer = create_buffer(nullptr, STAGING_BUFFER_SIZE, "<staging buffer>", flags, GPU_CATEGORY_BUFFERS);
+	loader.staging_data = static_cast<char*>(glMapNamedBufferRange(loader.staging_buffer, 0, STAGING_BUFFER_SIZE, flags));
+	loader.start_time = std::chrono::steady_clock::now();
+}
+
+glm::mat4 compute_object_matrix(const renderable_type& renderable) {
+	auto model = glm::mat4(1.0);
+	model = glm::translate(model, renderable.position);
+	model = glm::rotate(model, glm::angle(renderable.rotation), glm::axis(renderable.rotation));
+	model = glm::scale(model, renderable.scale);
+	return model;
+}
+
+glm::mat4 compute_model_matrix(const renderable_type& renderable) {
+	//quantized positions are dequantized by the model matrix, so the vertex shaders don't know about the format
+	return compute_object_matrix(renderable) * renderable.mesh.dequantization;
+}
+
+void invalidate_static_shadow_casters() {
+	shadow_cache.static_geometry_version++;
+}
+
+std::string get_canonical_path(const std::string& path) {
+	//separators are unified and the . and .. segments are resolved, so one file always has one key
+	std::vector<std::string> segments;
+	std::string segment;
+	auto normalized = path;
+	std::replace(normalized.begin(), normalized.end(), '\\', '/');
+	std::stringstream stream(normalized);
+	while(std::getline(stream, segment, '/')) {
+		if(segment.empty() || segment == ".") {
+			continue;
+		}
+		if(segment == ".." && !segments.empty() && segments.back() != "..") {
+			segments.pop_back();
+		} else {
+			segments.push_back(segment);
+		}
+	}
+	std::string result = !normalized.empty() && normalized[0] == '/' ? "/" : "";
+	for(int i = 0; i < segments.size(); i++) {
+		result += (i == 0 ? "" : "/") + segments[i];
+	}
+	return result;
+}
+
+int get_mesh_asset(const std::string& path, const unsigned int import_flags = DEFAULT_MESH_IMPORT_FLAGS) {
+	//the mesh isn't loaded until a renderable uses it
+	auto& loader = asset_loader;
+	auto canonical_path = get_canonical_path(path);
+	auto key = canonical_path + "|" + std::to_string(import_flags);
+	auto iterator = loader.mesh_asset_keys.find(key);
+	if(iterator != loader.mesh_asset_keys.end()) {
+		return iterator->second;
+	}
+	loader.mesh_assets.emplace_back();
+	auto& asset = loader.mesh_assets.back();
+	asset.path = canonical_path;
+	asset.import_flags = import_flags;
+	auto asset_index = static_cast<int>(loader.mesh_assets.size()) - 1;
+	loader.mesh_asset_keys[key] = asset_index;
+	return asset_index;
+}
+
+int register_mesh(const std::string& name, const mesh_type& mesh, const std::vector<GLuint>& buffers, const GLsizeiptr gpu_size) {
+	//a mesh created in code, the caller holds a reference to it
+	auto asset_index = get_mesh_asset(name);
+	auto& asset = asset_loader.mesh_assets[asset_index];
+	asset.state = ASSET_STATE_RESIDENT;
+	asset.meshes = {mesh};
+	asset.instances = {mesh_instance_type()};
+	asset.buffers = buffers;
+	asset.gpu_size = gpu_size;
+	asset.reference_count++;
+	asset_loader.gpu_size += gpu_size;
+	return asset_index;
+}
+
+void start_mesh_import(const int asset_index) {
+	auto& loader = asset_loader;
+	//the deque doesn't move its elements, so the worker can keep a pointer while the main thread adds more assets
+	auto asset = &loader.mesh_assets[asset_index];
+	asset->state = ASSET_STATE_LOADING;
+	asset->error.clear();
+	asset->log.clear();
+	submit_task(asset_worker_pool, [asset, asset_index]() {
+		import_mesh(asset->path, asset->import_flags, asset->data, asset->error, asset->log);
+		std::lock_guard<std::mutex> lock(asset_loader.mutex);
+		asset_loader.imported_assets.push_back(asset_index);
+	});
+}
+
+void unload_mesh_asset(const int asset_index) {
+	auto& loader = asset_loader;
+	auto& asset = loader.mesh_assets[asset_index];
+	if(asset.meshes.empty()) {
+		return;
+	}
+	delete_gpu_resources(GL_VERTEX_ARRAY, 1, &asset.meshes[0].vao);
+	delete_gpu_resources(GL_VERTEX_ARRAY, 1, &asset.meshes[0].shadow_vao);
+	delete_gpu_resources(GL_BUFFER, asset.buffers.size(), asset.buffers.data());
+	loader.gpu_size -= asset.gpu_size;
+	asset.buffers.clear();
+	asset.gpu_size = 0;
+	asset.vertex_gpu_size = 0;
+	asset.meshes.clear();
+	asset.instances.clear();
+	asset.state = ASSET_STATE_UNLOADED;
+}
+
+void evict_meshes(const GLsizeiptr target_size) {
+	//the least recently released meshes go first, the referenced ones stay even over the budget
+	auto& loader = asset_loader;
+	while(loader.gpu_size > target_size) {
+		auto evicted = -1;
+		for(int i = 0; i < loader.mesh_assets.size(); i++) {
+			auto& asset = loader.mesh_assets[i];
+			if(asset.state == ASSET_STATE_RESIDENT && asset.reference_count == 0 && (evicted == -1 || asset.last_used_frame < loader.mesh_assets[evicted].last_used_frame)) {
+				evicted = i;
+			}
+		}
+		if(evicted == -1) {
+			return;
+		}
+		unload_mesh_asset(evicted);
+		loader.evicted_mesh_count++;
+	}
+}
+
+void decompose_transform(const glm::mat4& transform, glm::vec3& position, glm::quat& rotation, glm::vec3& scale) {
+	//renderables are placed with a translation, a rotation and a scale, a shear in the node graph is lost
+	position = glm::vec3(transform[3]);
+	scale = glm::vec3(glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2])));
+	if(glm::determinant(glm::mat3(transform)) < 0.0f) {
+		scale.x = -scale.x;
+	}
+	rotation = glm::quat_cast(glm::mat3(glm::vec3(transform[0]) / scale.x, glm::vec3(transform[1]) / scale.y, glm::vec3(transform[2]) / scale.z));
+}
+
+void release_mesh(const int asset_index) {
+	auto& asset = asset_loader.mesh_assets[asset_index];
+	asset.reference_count--;
+	if(asset.reference_count == 0) {
+		asset.last_used_frame = asset_loader.frame;
+	}
+}
+
+void add_mesh_instances(const renderable_type& renderable) {
+	//every instance of the asset is a renderable placed relative to the given one, which passes its reference to the first instance
+	auto& loader = asset_loader;
+	auto& asset = loader.mesh_assets[renderable.mesh_asset];
+	//a scene file saved with another version of the mesh may name an instance it no longer has, that renderable is skipped
+	if(renderable.mesh_instance < -1 || renderable.mesh_instance >= static_cast<int>(asset.instances.size())) {
+		std::cout << "SCENE, ERROR, " << asset.path << " has no instance " << renderable.mesh_instance << ", the renderable is skipped" << std::endl;
+		release_mesh(renderable.mesh_asset);
+		return;
+	}
+	if(renderable.mesh_instance != -1) {
+		auto instance_renderable = renderable;
+		instance_renderable.mesh = asset.meshes[asset.instances[renderable.mesh_instance].mesh];
+		renderables.push_back(instance_renderable);
+		return;
+	}
+	asset.reference_count += static_cast<int>(asset.instances.size()) - 1;
+	if(asset.reference_count == 0) {
+		asset.last_used_frame = loader.frame;
+	}
+	auto model = compute_object_matrix(renderable);
+	for(int i = 0; i < asset.instances.size(); i++) {
+		auto& instance = asset.instances[i];
+		auto instance_renderable = renderable;
+		instance_renderable.mesh_instance = i;
+		instance_renderable.mesh = asset.meshes[instance.mesh];
+		if(asset.instances.size() > 1) {
+			instance_renderable.name += " " + std::to_string(i + 1);
+		}
+		if(instance.transform != glm::mat4(1.0)) {
+			decompose_transform(model * instance.transform, instance_renderable.position, instance_renderable.rotation, instance_renderable.scale);
+		}
+		renderables.push_back(instance_renderable);
+	}
+}
+
+void add_renderable(renderable_type renderable, const int asset_index) {
+	auto& loader = asset_loader;
+	auto& asset = loader.mesh_assets[asset_index];
+	asset.reference_count++;
+	renderable.mesh_asset = asset_index;
+	if(asset.state == ASSET_STATE_FAILED) {
+		release_mesh(asset_index);
+		return;
+	}
+	if(asset.state == ASSET_STATE_RESIDENT) {
+		add_mesh_instances(renderable);
+		invalidate_static_shadow_casters();
+		return;
+	}
+	if(asset.state == ASSET_STATE_UNLOADED) {
+		start_mesh_import(asset_index);
+	}
+	loader.pending_renderables.push_back(renderable);
+}
+
+void remove_renderable(const int renderable_index) {
+	release_mesh(renderables[renderable_index].mesh_asset);
+	renderables.erase(renderables.begin() + renderable_index);
+	invalidate_static_shadow_casters();
+}
+
+bool are_assets_loading() {
+	return std::any_of(asset_loader.mesh_assets.begin(), asset_loader.mesh_assets.end(), [](const mesh_asset_type& asset) {
+		return asset.state == ASSET_STATE_LOADING || asset.state == ASSET_STATE_IMPORTED || asset.state == ASSET_STATE_UPLOADING;
+	});
+}
+
+bool allocate_staging_region(const GLsizeiptr size, GLintptr& offset) {
+	auto& regions = asset_loader.staging_regions;
+	if(regions.empty()) {
+		offset = 0;
+		return size <= STAGING_BUFFER_SIZE;
+	}
+	auto first = regions.front().offset;
+	auto end = regions.back().offset + regions.back().size;
+	if(regions.back().offset >= first) {
+		//the used part doesn't wrap around, so there may be room after it or at the beginning
+		if(end + size <= STAGING_BUFFER_SIZE) {
+			offset = end;
+			return true;
+		}
+		if(size <= first) {
+			offset = 0;
+			return true;
+		}
+		return false;
+	}
+	if(end + size <= first) {
+		offset = end;
+		return true;
+	}
+	return false;
+}
+
+void resolve_pending_renderables(const int asset_index, const bool loaded) {
+	//the renderables waiting for the mesh join the scene, or they are dropped if it failed to load
+	//one pass keeps the others in order, a stress scene can have a million of them waiting
+	auto& pending = asset_loader.pending_renderables;
+	auto kept = 0;
+	for(int i = 0; i < pending.size(); i++) {
+		if(pending[i].mesh_asset != asset_index) {
+			pending[kept++] = std::move(pending[i]);
+		} else if(loaded) {
+			add_mesh_instances(pending[i]);
+		} else {
+			release_mesh(asset_index);
+		}
+	}
+	pending.resize(kept);
+}
+
+void make_mesh_asset_resident(const int asset_index) {
+	asset_loader.mesh_assets[asset_index].state = ASSET_STATE_RESIDENT;
+	resolve_pending_renderables(asset_index, true);
+	//the new renderables change the static shadow casters
+	invalidate_static_shadow_casters();
+}
+
+bool upload_mesh_asset(const int asset_index) {
+	auto& loader = asset_loader;
+	auto& asset = loader.mesh_assets[asset_index];
+	auto& data = asset.data;
+	std::vector<GLintptr> offsets;
+	GLsizeiptr size = 0;
+	for(auto& buffer : data.buffers) {
+		offsets.push_back(size);
+		size += (buffer.size + 15) / 16 * 16;
+	}
+	evict_meshes(loader.gpu_budget - size);
+	//a mesh bigger than the whole staging buffer is uploaded directly
+	auto direct = size > STAGING_BUFFER_SIZE;
+	GLintptr staging_offset = 0;
+	if(!direct && !allocate_staging_region(size, staging_offset)) {
+		return false;
+	}
+	auto vao = create_vao("<" + asset.path + ">");
+	std::vector<GLuint> buffers;
+	for(int i = 0; i < data.buffers.size(); i++) {
+		auto& buffer = data.buffers[i];
+		auto name = "<" + asset.path + " buffer " + std::to_string(i) + ">";
+		if(direct) {
+			buffers.push_back(create_buffer(buffer.data, buffer.size, name));
+		} else {
+			std::memcpy(loader.staging_data + staging_offset + offsets[i], buffer.data, buffer.size);
+			buffers.push_back(create_buffer(nullptr, buffer.size, name));
+			glCopyNamedBufferSubData(loader.staging_buffer, buffers.back(), staging_offset + offsets[i], 0, buffer.size);
+		}
+	}
+	auto& positions = data.positions;
+	auto& normals = data.normals;
+	attach_vbo(vao, 0, buffers[positions.buffer], positions.offset, positions.stride, positions.size, positions.type, positions.normalized);
+	attach_vbo(vao, 1, buffers[normals.buffer], normals.offset, normals.stride, normals.size, normals.type, normals.normalized);
+	glVertexArrayElementBuffer(vao, buffers[data.index_buffer]);
+	auto shadow_vao = create_vao("<" + asset.path + " positions>");
+	attach_vbo(shadow_vao, 0, buffers[positions.buffer], positions.offset, positions.stride, positions.size, positions.type, positions.normalized);
+	glVertexArrayElementBuffer(shadow_vao, buffers[data.index_buffer]);
+	asset.buffers = buffers;
+	asset.gpu_size = 0;
+	asset.vertex_gpu_size = 0;
+	for(int i = 0; i < data.buffers.size(); i++) {
+		asset.gpu_size += data.buffers[i].size;
+		asset.vertex_gpu_size += i == data.index_buffer || i == data.meshlet_buffer ? 0 : data.buffers[i].size;
+	}
+	loader.gpu_size += asset.gpu_size;
+	for(auto& mesh : data.meshes) {
+		mesh.vao = vao;
+		mesh.shadow_vao = shadow_vao;
+		mesh.meshlet_buffer = data.meshlet_buffer == -1 ? 0 : buffers[data.meshlet_buffer];
+	}
+	asset.meshes = data.meshes;
+	asset.instances = data.instances;
+	release_mesh_data(data);
+	asset.state = ASSET_STATE_UPLOADING;
+	if(direct) {
+		make_mesh_asset_resident(asset_index);
+	} else {
+		loader.staging_regions.push_back({staging_offset, size, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), asset_index});
+	}
+	return true;
+}
+
+void add_scene_renderable(renderable_type renderable, const int asset_index);
+
+renderable_type get_scene_instance_renderable(const scene_instance_type& instance) {
+	renderable_type renderable;
+	renderable.position = instance.position;
+	renderable.rotation = instance.rotation;
+	renderable.scale = instance.scale;
+	renderable.diffuse_color = glm::vec3(glm::unpackUnorm4x8(instance.color));
+	renderable.is_static = instance.flags & SCENE_INSTANCE_FLAG_STATIC;
+	renderable.casts_shadows = instance.flags & SCENE_INSTANCE_FLAG_SHADOW_CASTER;
+	renderable.mesh_instance = instance.mesh_instance;
+	return renderable;
+}
+
+int get_scene_store_range(const GLuint flags) {
+	if(!(flags & SCENE_INSTANCE_FLAG_SHADOW_CASTER)) {
+		return SCENE_STORE_RANGE_RECEIVER;
+	}
+	return flags & SCENE_INSTANCE_FLAG_STATIC ? SCENE_STORE_RANGE_STATIC_CASTER : SCENE_STORE_RANGE_DYNAMIC_CASTER;
+}
+
+GLuint get_scene_store_instance_count(const int mesh, const int first_range, const int last_range) {
+	auto& offsets = scene_store.range_offsets;
+	return offsets[mesh * SCENE_STORE_RANGE_COUNT + last_range + 1] - offsets[mesh * SCENE_STORE_RANGE_COUNT + first_range];
+}
+
+void sort_scene_store_instances(const std::string& path) {
+	//a counting sort by mesh and range, the only passes over the mapped instances
+	auto& store = scene_store;
+	auto mesh_count = static_cast<GLuint>(store.mesh_assets.size());
+	std::vector<GLuint> offsets(mesh_count * SCENE_STORE_RANGE_COUNT + 1, 0);
+	store.max_scales.assign(mesh_count, 0.0f);
+	store.max_mesh_instances.assign(mesh_count, -1);
+	GLuint skipped_count = 0;
+	for(GLuint i = 0; i < store.instance_count; i++) {
+		auto& instance = store.instances[i];
+		if(instance.mesh >= mesh_count || instance.mesh_instance < -1) {
+			skipped_count++;
+			continue;
+		}
+		offsets[instance.mesh * SCENE_STORE_RANGE_COUNT + get_scene_store_range(instance.flags) + 1]++;
+		auto scale = glm::abs(instance.scale);
+		store.max_scales[instance.mesh] = max(store.max_scales[instance.mesh], max(scale.x, max(scale.y, scale.z)));
+		store.max_mesh_instances[instance.mesh] = max(store.max_mesh_instances[instance.mesh], instance.mesh_instance);
+	}
+	for(int i = 1; i < offsets.size(); i++) {
+		offsets[i] += offsets[i - 1];
+	}
+	store.range_offsets = offsets;
+	std::vector<GLuint> indices(offsets.back());
+	for(GLuint i = 0; i < store.instance_count; i++) {
+		auto& instance = store.instances[i];
+		if(instance.mesh < mesh_count && instance.mesh_instance >= -1) {
+			indices[offsets[instance.mesh * SCENE_STORE_RANGE_COUNT + get_scene_store_range(instance.flags)]++] = i;
+		}
+	}
+	if(skipped_count > 0) {
+		std::cout << "SCENE, ERROR, " << path << ": " << skipped_count << " instances name a mesh the manifest doesn't list, they are skipped" << std::endl;
+	}
+	store.index_buffer = create_buffer(indices.empty() ? nullptr : indices.data(), max(indices.size(), size_t(1)) * sizeof(GLuint), "<" + path + " indices>", GL_NONE, GPU_CATEGORY_BUFFERS);
+}
+
+void acquire_scene_store_meshes() {
+	//the instances of a mesh are drawn once it's resident
+	auto& store = scene_store;
+	store.pending_meshes.assign(store.mesh_assets.size(), true);
+	store.pending_mesh_count = store.mesh_assets.size();
+	for(auto asset_index : store.mesh_assets) {
+		auto& asset = asset_loader.mesh_assets[asset_index];
+		asset.reference_count++;
+		if(asset.state == ASSET_STATE_UNLOADED) {
+			start_mesh_import(asset_index);
+		}
+	}
+}
+
+void release_scene_store_meshes() {
+	auto& store = scene_store;
+	for(auto asset_index : store.mesh_assets) {
+		release_mesh(asset_index);
+	}
+	store.pending_meshes.assign(store.mesh_assets.size(), false);
+	store.pending_mesh_count = 0;
+}
+
+void release_scene_store() {
+	auto& store = scene_store;
+	release_scene_store_meshes();
+	if(store.instance_buffer != 0) {
+		delete_gpu_resources(GL_BUFFER, 1, &store.instance_buffer);
+		delete_gpu_resources(GL_BUFFER, 1, &store.index_buffer);
+	}
+	unmap_file(store.file);
+	store = scene_store_type();
+}
+
+void update_scene_store() {
+	//nothing is read per instance, a resident mesh only changes the static shadow casters, the instances of a failed mesh aren't drawn
+	auto& store = scene_store;
+	for(int i = 0; i < store.mesh_assets.size(); i++) {
+		auto& asset = asset_loader.mesh_assets[store.mesh_assets[i]];
+		if(!store.pending_meshes[i] || (asset.state != ASSET_STATE_RESIDENT && asset.state != ASSET_STATE_FAILED)) {
+			continue;
+		}
+		//a scene file saved with another version of the mesh may name an instance it no longer has, the vertex shader skips those instances
+		if(asset.state == ASSET_STATE_RESIDENT && store.max_mesh_instances[i] >= static_cast<GLint>(asset.instances.size())) {
+			std::cout << "SCENE, ERROR, " << asset.path << " has no instance " << store.max_mesh_instances[i] << ", the instances naming it are skipped" << std::endl;
+		}
+		store.pending_meshes[i] = false;
+		store.pending_mesh_count--;
+		invalidate_static_shadow_casters();
+	}
+}
+
+void edit_scene_store_instance(const int index) {
+	//the instance becomes a renderable the ui can change, its record is hidden on the gpu
+	auto& store = scene_store;
+	auto& edited = store.edited_instances;
+	auto position = std::lower_bound(edited.begin(), edited.end(), static_cast<GLuint>(index));
+	if(index < 0 || index >= static_cast<int>(store.instance_count) || (position != edited.end() && *position == index) || store.instances[index].mesh >= store.mesh_assets.size()) {
+		std::cout << "SCENE, ERROR, the loaded scene has no editable instance " << index << std::endl;
+		return;
+	}
+	auto& instance = store.instances[index];
+	auto renderable = get_scene_instance_renderable(instance);
+	renderable.name = "scene instance " + std::to_string(index);
+	add_renderable(renderable, store.mesh_assets[instance.mesh]);
+	auto flags = instance.flags | SCENE_INSTANCE_FLAG_EDITED;
+	glNamedBufferSubData(store.instance_buffer, index * sizeof(scene_instance_type) + offsetof(scene_instance_type, flags), sizeof(flags), &flags);
+	edited.insert(position, index);
+	invalidate_static_shadow_casters();
+}
+
+void update_assets() {
+	auto& loader = asset_loader;
+	loader.frame++;
+	//the regions whose copies are done can be reused, and their meshes are resident
+	while(!loader.staging_regions.empty()) {
+		auto& region = loader.staging_regions.front();
+		if(glClientWaitSync(region.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED) {
+			break;
+		}
+		glDeleteSync(region.fence);
+		make_mesh_asset_resident(region.asset);
+		loader.staging_regions.pop_front();
+	}
+	std::vector<int> imported_assets;
+	{
+		std::lock_guard<std::mutex> lock(loader.mutex);
+		imported_assets.swap(loader.imported_assets);
+	}
+	for(auto asset_index : imported_assets) {
+		auto& asset = loader.mesh_assets[asset_index];
+		for(auto& line : asset.log) {
+			std::cout << line << std::endl;
+		}
+		asset.log.clear();
+		if(asset.error.empty()) {
+			asset.state = ASSET_STATE_IMPORTED;
+			loader.upload_queue.push_back(asset_index);
+		} else {
+			asset.state = ASSET_STATE_FAILED;
+			release_mesh_data(asset.data);
+			resolve_pending_renderables(asset_index, false);
+			std::cout << "ASSET, ERROR, " << asset.path << ": " << asset.error << std::endl;
+		}
+	}
+	//as many meshes are uploaded as fit into the staging buffer, the others wait for the next frame
+	while(!loader.upload_queue.empty() && upload_mesh_asset(loader.upload_queue.front())) {
+		loader.upload_queue.pop_front();
+	}
+	update_scene_store();
+
+	if(!are_assets_loading() && !loader.logged) {
+		auto failed_count = std::count_if(loader.mesh_assets.begin(), loader.mesh_assets.end(), [](const mesh_asset_type& asset) {
+			return asset.state == ASSET_STATE_FAILED;
+		});
+		auto milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loader.start_time).count();
+		std::cout << "MESH, loaded the meshes in " << milliseconds << " ms, " << mesh_cache.glb_mesh_count << " from glb, " << mesh_cache.cached_mesh_count << " cooked, " << mesh_cache.imported_mesh_count << " imported with assimp, " << failed_count << " failed" << std::endl;
+		loader.logged = true;
+	}
+}
+
+void wait_for_assets() {
+	//the tuner needs the whole scene, so it waits instead of streaming the meshes in
+	while(are_assets_loading() || scene_store.pending_mesh_count > 0) {
+		update_assets();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+void destroy_asset_loader() {
+	auto& loader = asset_loader;
+	release_scene_store();
+	for(auto& region : loader.staging_regions) {
+		glDeleteSync(region.fence);
+	}
+	for(int i = 0; i < loader.mesh_assets.size(); i++) {
+		release_mesh_data(loader.mesh_assets[i].data);
+		unload_mesh_asset(i);
+	}
+	glUnmapNamedBuffer(loader.staging_buffer);
+	delete_gpu_resources(GL_BUFFER, 1, &loader.staging_buffer);
+}
+
+std::string get_asset_state_name(const int state) {
+	switch(state) {
+		case ASSET_STATE_LOADING: return "loading";
+		case ASSET_STATE_IMPORTED: return "waiting for upload";
+		case ASSET_STATE_UPLOADING: return "uploading";
+		case ASSET_STATE_RESIDENT: return "resident";
+		case ASSET_STATE_FAILED: return "failed";
+		case ASSET_STATE_UNLOADED: return "unloaded";
+		default: return "unknown";
+	}
+}
+
+int create_quad() {
+	std::vector<float> vertices = {
+		-1.0, 1.0, 0.0,		//top-left
+		1.0, 1.0, 0.0,		//top-right
+		-1.0, -1.0, 0.0,	//bottom-left
+		1.0, -1.0, 0.0		//bottom-right
+	};
+	std::vector<float> normals = {
+		0.0, 0.0, 1.0,
+		0.0, 0.0, 1.0,
+		0.0, 0.0, 1.0,
+		0.0, 0.0, 1.0
+	};
+	std::vector<float> uvs = {
+		0.0, 1.0,
+		1.0, 1.0,
+		0.0, 0.0,
+		1.0, 0.0
+	};
+	std::vector<GLuint> indices = {
+		0, 2, 3,
+		1, 0, 3
+	};
+
+	auto vao = create_vao("<quad>");
+	std::vector<GLuint> buffers;
+	buffers.push_back(create_and_attach_vbo(vao, 0, vertices, "<quad vertex position>"));
+	buffers.push_back(create_and_attach_vbo(vao, 1, normals, "<quad vertex normals>"));
+	buffers.push_back(create_and_attach_vbo(vao, 2, uvs, "<quad vertex uvs>", 2));
+	buffers.push_back(create_and_attach_ebo(vao, indices, "<quad indices>"));
+	auto shadow_vao = create_vao("<quad positions>");
+	attach_vbo(shadow_vao, 0, buffers[0], 0, 3 * sizeof(float));
+	glVertexArrayElementBuffer(shadow_vao, buffers[3]);
+
+	mesh_type quad;
+	quad.vao = vao;
+	quad.shadow_vao = shadow_vao;
+	quad.index_count = 6;
+	quad.lods[0].index_count = 6;
+	quad.aabb_min = glm::vec3(-1.0, -1.0, 0.0);
+	quad.aabb_max = glm::vec3(1.0, 1.0, 0.0);
+	auto gpu_size = (vertices.size() + normals.size() + uvs.size()) * sizeof(float) + indices.size() * sizeof(GLuint);
+	return register_mesh("<quad>", quad, buffers, gpu_size);
+}
+
+void create_demo_renderables() {
+	renderable_type box;
+	box.name = "box";
+	box.position = glm::vec3(0.0, 0.0, -30.0);
+	add_renderable(box, get_mesh_asset("res/mesh/box.glb"));
+
+	renderable_type helmet;
+	helmet.name = "helmet";
+	helmet.position = glm::vec3(0.0, 10.0, -50.0);
+	helmet.scale = glm::vec3(10.0);
+	//the file's node stands the helmet up
+	helmet.rotation = glm::angleAxis(glm::radians(-90.0f), glm::vec3(0.0, 1.0, 0.0));
+	add_renderable(helmet, get_mesh_asset("res/mesh/DamagedHelmet.glb"));
+
+	//the cameras share one mesh
+	auto camera_asset = get_mesh_asset("res/mesh/AntiqueCamera.glb");
+	renderable_type camera;
+	camera.name = "camera";
+	camera.position = glm::vec3(0.0, 10.0, -65.0);
+	add_renderable(camera, camera_asset);
+
+	renderable_type camera_2;
+	camera_2.name = "camera 2";
+	camera_2.position = glm::vec3(-10.0, 0.0, -70.0);
+	add_renderable(camera_2, camera_asset);
+
+	renderable_type camera_3;
+	camera_3.name = "camera 3";
+	camera_3.position = glm::vec3(-19.0, -9.0, -75.0);
+	add_renderable(camera_3, camera_asset);
+
+}
+
+void create_ground() {
+	renderable_type quad;
+	quad.name = "ground";
+	quad.rotation = glm::angleAxis(glm::radians(-90.0f), glm::vec3(1.0, 0.0, 0.0));
+	quad.scale = glm::vec3(500.0);
+	quad.diffuse_color = glm::vec3(1.0, 0.7, 0.4);
+	add_renderable(quad, get_mesh_asset("<quad>"));
+}
+
+unsigned long long get_stream_cell_key(const glm::ivec2 coordinate) {
+	//shifting a negative signed value is undefined, so both halves are unsigned
+	return (static_cast<unsigned long long>(static_cast<GLuint>(coordinate.x)) << 32) | static_cast<GLuint>(coordinate.y);
+}
+
+void add_scene_renderable(renderable_type renderable, const int asset_index) {
+	//with streaming, the renderable waits in the cell under it until the player comes near
+	auto& stream = streaming;
+	if(!stream.enabled) {
+		add_renderable(renderable, asset_index);
+		return;
+	}
+	auto coordinate = glm::ivec2(glm::floor(glm::vec2(renderable.position.x, renderable.position.z) / STREAM_CELL_SIZE));
+	auto key = get_stream_cell_key(coordinate);
+	auto iterator = stream.cell_keys.find(key);
+	if(iterator == stream.cell_keys.end()) {
+		iterator = stream.cell_keys.emplace(key, static_cast<int>(stream.cells.size())).first;
+		stream.cells.emplace_back();
+	}
+	auto& cell = stream.cells[iterator->second];
+	//approximation, the meshes aren't loaded yet, so they are assumed to fit into their scale
+	auto scale = glm::abs(renderable.scale);
+	cell.aabb_min = glm::min(cell.aabb_min, renderable.position);
+	cell.aabb_max = glm::max(cell.aabb_max, renderable.position);
+	cell.margin = max(cell.margin, max(scale.x, max(scale.y, scale.z)));
+	renderable.mesh_asset = asset_index;
+	renderable.cell = iterator->second;
+	cell.renderables.push_back(renderable);
+	if(cell.state != CELL_STATE_UNLOADED) {
+		add_renderable(renderable, asset_index);
+	}
+}
+
+void load_stream_cell(const int cell_index) {
+	auto& cell = streaming.cells[cell_index];
+	for(auto& renderable : cell.renderables) {
+		add_renderable(renderable, renderable.mesh_asset);
+	}
+	cell.state = CELL_STATE_LOADING;
+}
+
+void remove_cell_renderables(std::vector<renderable_type>& list, const std::function<bool(const renderable_type&)>& predicate) {
+	//one pass keeps the others in order and releases the removed ones' meshes
+	auto kept = 0;
+	for(int i = 0; i < list.size(); i++) {
+		if(predicate(list[i])) {
+			release_mesh(list[i].mesh_asset);
+		} else {
+			list[kept++] = std::move(list[i]);
+		}
+	}
+	list.resize(kept);
+}
+
+void evict_stream_cell(const int cell_index) {
+	auto is_in_cell = [cell_index](const renderable_type& renderable) {
+		return renderable.cell == cell_index;
+	};
+	remove_cell_renderables(renderables, is_in_cell);
+	remove_cell_renderables(asset_loader.pending_renderables, is_in_cell);
+	invalidate_static_shadow_casters();
+	streaming.cells[cell_index].state = CELL_STATE_UNLOADED;
+	streaming.evicted_cell_count++;
+}
+
+void set_streaming(const bool enabled) {
+	auto& stream = streaming;
+	auto& loader = asset_loader;
+	if(enabled) {
+		//the renderables of the file meshes go into cells, the ones made in code, like the ground, stay resident
+		stream.enabled = true;
+		std::vector<renderable_type> streamed_renderables;
+		auto is_streamed = [&](const renderable_type& renderable) {
+			if(renderable.cell != -1 || loader.mesh_assets[renderable.mesh_asset].path[0] == '<') {
+				return false;
+			}
+			streamed_renderables.push_back(renderable);
+			return true;
+		};
+		remove_cell_renderables(renderables, is_streamed);
+		remove_cell_renderables(loader.pending_renderables, is_streamed);
+		invalidate_static_shadow_casters();
+		for(auto& renderable : streamed_renderables) {
+			add_scene_renderable(renderable, renderable.mesh_asset);
+		}
+		stream.last_player_position = player.position;
+	} else {
+		//every cell is loaded, and its renderables stay without a cell
+		for(int i = 0; i < stream.cells.size(); i++) {
+			if(stream.cells[i].state == CELL_STATE_UNLOADED) {
+				load_stream_cell(i);
+			}
+		}
+		for(auto list : {&renderables, &loader.pending_renderables}) {
+			for(auto& renderable : *list) {
+				renderable.cell = -1;
+			}
+		}
+		stream.cells.clear();
+		stream.cell_keys.clear();
+		stream.enabled = false;
+	}
+}
+
+void clear_scene() {
+	//the meshes stay resident until they are evicted, so a new scene made of the same meshes doesn't import them again
+	auto& loader = asset_loader;
+	for(auto& renderable : renderables) {
+		release_mesh(renderable.mesh_asset);
+	}
+	for(auto& renderable : loader.pending_renderables) {
+		release_mesh(renderable.mesh_asset);
+	}
+	renderables.clear();
+	loader.pending_renderables.clear();
+	release_scene_store();
+	streaming.cells.clear();
+	streaming.cell_keys.clear();
+	invalidate_static_shadow_casters();
+	create_ground();
+}
+
+std::string get_scene_directory(const std::string& path) {
+	auto separator = path.find_last_of("/\\");
+	return separator == std::string::npos ? "" : path.substr(0, separator + 1);
+}
+
+bool load_scene(const std::string& path) {
+	auto start = std::chrono::steady_clock::now();
+	std::ifstream file(path);
+	if(!file) {
+		std::cout << "SCENE, ERROR, " << path << ": the file can't be opened" << std::endl;
+		return false;
+	}
+	//the manifest lists the meshes and names the binary instance file, relative to the manifest
+	std::vector<int> mesh_assets;
+	std::string instances_path;
+	std::string keyword;
+	while(file >> keyword) {
+		std::string value;
+		std::getline(file >> std::ws, value);
+		if(keyword[0] == '#') {
+			continue;
+		} else if(keyword == "mesh") {
+			mesh_assets.push_back(get_mesh_asset(value));
+		} else if(keyword == "instances") {
+			instances_path = get_scene_directory(path) + value;
+		}
+	}
+	mapped_file_type instances_file;
+	if(instances_path.empty() || !map_file(instances_path, instances_file)) {
+		std::cout << "SCENE, ERROR, " << path << ": the instance file can't be opened" << std::endl;
+		return false;
+	}
+	auto header = reinterpret_cast<const scene_instances_header_type*>(instances_file.data);
+	if(instances_file.size < sizeof(scene_instances_header_type) || std::memcmp(header->magic, SCENE_INSTANCES_MAGIC, sizeof(header->magic)) != 0 || header->version != SCENE_INSTANCES_VERSION || sizeof(scene_instances_header_type) + header->instance_count * sizeof(scene_instance_type) > instances_file.size) {
+		std::cout << "SCENE, ERROR, " << instances_path << ": not a valid instance file" << std::endl;
+		unmap_file(instances_file);
+		return false;
+	}
+
+	clear_scene();
+	auto instances = reinterpret_cast<const scene_instance_type*>(instances_file.data + sizeof(scene_instances_header_type));
+	auto instance_count = header->instance_count;
+	if(streaming.enabled) {
+		//the cells need every position up front, so the instances are copied into them
+		for(GLuint i = 0; i < instance_count; i++) {
+			if(instances[i].mesh < mesh_assets.size()) {
+				add_scene_renderable(get_scene_instance_renderable(instances[i]), mesh_assets[instances[i].mesh]);
+			}
+		}
+		unmap_file(instances_file);
+	} else {
+		//the mapped array is uploaded as it is and drawn per mesh, see draw_scene_store
+		auto& store = scene_store;
+		store.file = instances_file;
+		store.instances = instances;
+		store.instance_count = instance_count;
+		store.mesh_assets = mesh_assets;
+		sort_scene_store_instances(instances_path);
+		store.instance_buffer = create_buffer(instance_count == 0 ? nullptr : instances, max(instance_count, 1u) * sizeof(scene_instance_type), "<" + instances_path + ">", GL_DYNAMIC_STORAGE_BIT, GPU_CATEGORY_BUFFERS);
+		acquire_scene_store_meshes();
+	}
+	//the buffer's storage is filled from the mapped file before it returns, so the time includes reading the file
+	scene_settings.load_time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "SCENE, loaded " << path << ": " << instance_count << " instances in " << scene_settings.load_time << " ms" << std::endl;
+	return true;
+}
+
+bool save_scene(const std::string& path) {
+	//the meshes created in code aren't in files, so their renderables, like the ground, aren't saved
+	auto& loader = asset_loader;
+	std::vector<const renderable_type*> saved_renderables;
+	for(auto list : {&renderables, &loader.pending_renderables}) {
+		for(auto& renderable : *list) {
+			if(loader.mesh_assets[renderable.mesh_asset].path[0] != '<') {
+				saved_renderables.push_back(&renderable);
+			}
+		}
+	}
+	//the renderables of the loaded cells are already in the lists above
+	for(auto& cell : streaming.cells) {
+		for(int i = 0; i < cell.renderables.size() && cell.state == CELL_STATE_UNLOADED; i++) {
+			saved_renderables.push_back(&cell.renderables[i]);
+		}
+	}
+	//the records of a loaded scene file are copied as they are, except the edited ones, which are renderables now
+	auto& store = scene_store;
+	std::vector<GLuint> stored_instances;
+	for(GLuint i = 0, edited = 0; i < store.instance_count; i++) {
+		if(edited < store.edited_instances.size() && store.edited_instances[edited] == i) {
+			edited++;
+		} else if(store.instances[i].mesh < store.mesh_assets.size()) {
+			stored_instances.push_back(i);
+		}
+	}
+	std::unordered_map<int, GLuint> manifest_meshes;
+	std::vector<int> mesh_assets;
+	auto get_manifest_mesh = [&](const int asset_index) {
+		if(manifest_meshes.find(asset_index) == manifest_meshes.end()) {
+			manifest_meshes[asset_index] = mesh_assets.size();
+			mesh_assets.push_back(asset_index);
+		}
+		return manifest_meshes[asset_index];
+	};
+	auto instance_count = saved_renderables.size() + stored_instances.size();
+	std::vector<char> data(sizeof(scene_instances_header_type) + instance_count * sizeof(scene_instance_type));
+	auto header = reinterpret_cast<scene_instances_header_type*>(data.data());
+	std::memcpy(header->magic, SCENE_INSTANCES_MAGIC, sizeof(header->magic));
+	header->version = SCENE_INSTANCES_VERSION;
+	header->instance_count = instance_count;
+	auto instances = reinterpret_cast<scene_instance_type*>(data.data() + sizeof(scene_instances_header_type));
+	for(int i = 0; i < saved_renderables.size(); i++) {
+		auto& renderable = *saved_renderables[i];
+		auto& instance = instances[i];
+		instance.position = renderable.position;
+		instance.rotation = renderable.rotation;
+		instance.scale = renderable.scale;
+		instance.color = glm::packUnorm4x8(glm::vec4(renderable.diffuse_color, 1.0));
+		instance.flags = (renderable.is_static ? SCENE_INSTANCE_FLAG_STATIC : 0) | (renderable.casts_shadows ? SCENE_INSTANCE_FLAG_SHADOW_CASTER : 0);
+		instance.mesh = get_manifest_mesh(renderable.mesh_asset);
+		instance.mesh_instance = renderable.mesh_instance;
+	}
+	for(int i = 0; i < stored_instances.size(); i++) {
+		auto& instance = instances[saved_renderables.size() + i];
+		instance = store.instances[stored_instances[i]];
+		instance.mesh = get_manifest_mesh(store.mesh_assets[instance.mesh]);
+	}
+
+	auto separator = path.find_last_of("/\\");
+	auto instances_name = (separator == std::string::npos ? path : path.substr(separator + 1)) + ".instances";
+	std::ofstream manifest(path);
+	manifest << "# meshes are relative to the working directory, the instance file is relative to this file" << std::endl;
+	for(auto asset_index : mesh_assets) {
+		manifest << "mesh " << loader.mesh_assets[asset_index].path << std::endl;
+	}
+	manifest << "instances " << instances_name << std::endl;
+	std::ofstream instances_file(get_scene_directory(path) + instances_name, std::ios::binary);
+	instances_file.write(data.data(), data.size());
+	if(!manifest || !instances_file) {
+		std::cout << "SCENE, ERROR, " << path << ": the scene can't be written" << std::endl;
+		return false;
+	}
+	std::cout << "SCENE, saved " << path << ": " << instance_count << " instances" << std::endl;
+	return true;
+}
+
+std::string get_scene_layout_name(const int layout) {
+	switch(layout) {
+		case SCENE_LAYOUT_GRID: return "grid";
+		case SCENE_LAYOUT_CLUSTERED: return "clustered";
+		case SCENE_LAYOUT_CITY: return "city";
+		default: return "unknown";
+	}
+}
+
+int get_scene_layout(const std::string& name) {
+	for(int layout = SCENE_LAYOUT_GRID; layout <= SCENE_LAYOUT_CITY; layout++) {
+		if(get_scene_layout_name(layout) == name) {
+			return layout;
+		}
+	}
+	std::cout << "Unknown scene layout " << name << ", using grid" << std::endl;
+	return SCENE_LAYOUT_GRID;
+}
+
+std::vector<int> get_generator_mesh_assets() {
+	//the meshes loaded from files, or the demo's meshes if none is loaded yet
+	std::vector<int> mesh_assets;
+	for(int i = 0; i < asset_loader.mesh_assets.size(); i++) {
+		auto& asset = asset_loader.mesh_assets[i];
+		if(asset.path[0] != '<' && asset.state != ASSET_STATE_FAILED) {
+			mesh_assets.push_back(i);
+		}
+	}
+	if(mesh_assets.empty()) {
+		mesh_assets.push_back(get_mesh_asset("res/mesh/box.glb"));
+		mesh_assets.push_back(get_mesh_asset("res/mesh/DamagedHelmet.glb"));
+	}
+	return mesh_assets;
+}
+
+void generate_scene() {
+	auto start = std::chrono::steady_clock::now();
+	auto& settings = scene_settings;
+	auto mesh_assets = get_generator_mesh_assets();
+	clear_scene();
+	auto count = glm::clamp(settings.instance_count, MIN_GENERATED_INSTANCE_COUNT, MAX_GENERATED_INSTANCE_COUNT);
+	auto spacing = settings.spacing;
+	//the same seed always generates the same scene, so benchmark runs are comparable
+	std::mt19937 random(settings.seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::normal_distribution<float> normal(0.0f, 1.0f);
+	auto side = static_cast<int>(glm::ceil(glm::sqrt(static_cast<float>(count))));
+	auto extent = side * spacing;
+
+	//the clusters have a few hundred instances each, the city blocks have 4 x 4 lots with streets between them
+	std::vector<glm::vec2> cluster_centers(max(count / 256, 1));
+	for(auto& center : cluster_centers) {
+		center = (glm::vec2(unit(random), unit(random)) - 0.5f) * extent;
+	}
+	auto block_side = static_cast<int>(glm::ceil(glm::sqrt(static_cast<float>(count) / 16.0f)));
+	auto block_size = 4.0f * spacing + 2.0f * spacing;
+
+	renderables.reserve(renderables.size() + count);
+	for(int i = 0; i < count; i++) {
+		renderable_type renderable;
+		auto mesh_asset = mesh_assets[i % mesh_assets.size()];
+		auto yaw = unit(random) * glm::two_pi<float>();
+		renderable.rotation = glm::angleAxis(yaw, glm::vec3(0.0, 1.0, 0.0));
+		renderable.diffuse_color = glm::vec3(0.3f + 0.5f * unit(random), 0.3f + 0.5f * unit(random), 0.3f + 0.5f * unit(random));
+		renderable.casts_shadows = unit(random) < settings.caster_density;
+		if(settings.layout == SCENE_LAYOUT_GRID) {
+			renderable.position = glm::vec3((i % side - side / 2) * spacing, 1.0f, (i / side - side / 2) * spacing);
+		} else if(settings.layout == SCENE_LAYOUT_CLUSTERED) {
+			auto& center = cluster_centers[random() % cluster_centers.size()];
+			auto offset = glm::vec2(normal(random), normal(random)) * 4.0f * spacing;
+			renderable.position = glm::vec3(center.x + offset.x, 1.0f + unit(random) * spacing, center.y + offset.y);
+		} else {
+			//the buildings are the meshes stretched upward, facing the streets
+			auto block = i / 16;
+			auto lot = i % 16;
+			auto x = (block % block_side - block_side / 2) * block_size + (lot % 4) * spacing;
+			auto z = (block / block_side - block_side / 2) * block_size + (lot / 4) * spacing;
+			auto height = 1.0f + 7.0f * unit(random) * unit(random);
+			renderable.rotation = glm::angleAxis(glm::half_pi<float>() * (lot % 4), glm::vec3(0.0, 1.0, 0.0));
+			renderable.scale = glm::vec3(spacing * 0.4f, height * spacing * 0.4f, spacing * 0.4f);
+			renderable.position = glm::vec3(x, height * spacing * 0.4f, z);
+		}
+		add_scene_renderable(renderable, mesh_asset);
+	}
+	auto milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "SCENE, generated a " << get_scene_layout_name(settings.layout) << " of " << count << " instances in " << milliseconds << " ms" << std::endl;
+}
+
+bool create_renderables() {
+	//the quad is also used by the blur, its registration holds a reference, so it's never evicted
+	auto quad_asset = create_quad();
+	quad_mesh = asset_loader.mesh_assets[quad_asset].meshes[0];
+	auto& settings = scene_settings;
+	if(!settings.load_path.empty()) {
+		if(!load_scene(settings.load_path)) {
+			return false;
+		}
+	} else if(settings.generate) {
+		generate_scene();
+	} else {
+		create_demo_renderables();
+		create_ground();
+		if(streaming.enabled) {
+			set_streaming(true);
+		}
+	}
+	if(!settings.save_path.empty()) {
+		wait_for_assets();
+		return save_scene(settings.save_path);
+	}
+	return true;
+}
+
+GLuint create_fbo(const std::string& name, const int category = GPU_CATEGORY_SHADOW_TARGETS) {
+	GLuint fbo;
+	glCreateFramebuffers(1, &fbo);
+	register_gpu_resource(GL_FRAMEBUFFER, fbo, name, category, GL_NONE, "framebuffer", 0);
+	return fbo;
+}
+
+GLuint create_render_texture(const glm::ivec2 size, const GLsizei layers, const GLenum internal_format, const GLsizei mip_count, const std::string& name, const int category, const std::string& usage) {
+	GLuint texture;
+	glCreateTextures(layers > 0 ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D, 1, &texture);
+	if(layers > 0) {
+		glTextureStorage3D(texture, mip_count, internal_format, size.x, size.y, layers);
+	} else {
+		glTextureStorage2D(texture, mip_count, internal_format, size.x, size.y);
+	}
+	GLsizeiptr texture_size = 0;
+	for(int i = 0; i < mip_count; i++) {
+		texture_size += static_cast<GLsizeiptr>(max(size.x >> i, 1)) * max(size.y >> i, 1) * max(layers, 1) * get_texel_size(internal_format);
+	}
+	register_gpu_resource(GL_TEXTURE, texture, name, category, internal_format, usage, texture_size);
+	return texture;
+}
+
+void set_render_texture_parameters(const GLuint texture, const bool border) {
+	if(border) {
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+		auto border_color = glm::vec4(1.0);
+		glTextureParameterfv(texture, GL_TEXTURE_BORDER_COLOR, &border_color.x);
+	} else {
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+	glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+GLuint create_and_attach_texture(const GLuint fbo, const GLenum attachment, const glm::ivec2 size, const GLenum internal_format, const std::string& name, const bool border, const GLsizei layers = 0, const int category = GPU_CATEGORY_SHADOW_TARGETS) {
+	auto usage = attachment == GL_DEPTH_ATTACHMENT ? "depth attachment" : "color attachment";
+	auto texture = create_render_texture(size, layers, internal_format, 1, name, category, usage);
+	set_render_texture_parameters(texture, border);
+	glNamedFramebufferTexture(fbo, attachment, texture, 0);
+	return texture;
+}
+
+bool operator==(const render_target_key_type& a, const render_target_key_type& b) {
+	return a.size == b.size && a.layers == b.layers && a.format == b.format && a.mip_count == b.mip_count;
+}
+
+render_target_key_type get_render_target_key(const glm::ivec2 size, const GLsizei layers, const GLenum format, const GLsizei mip_count = 1) {
+	render_target_key_type key;
+	key.size = size;
+	key.layers = layers;
+	key.format = format;
+	key.mip_count = mip_count;
+	return key;
+}
+
+GLuint acquire_render_target(const glm::ivec2 size, const GLsizei layers, const GLenum format, const bool border, const std::string& name, const GLsizei mip_count = 1) {
+	//a free texture with the same size and format is reused, the previous user's contents are undefined
+	auto& pool = render_target_pool;
+	auto key = get_render_target_key(size, layers, format, mip_count);
+	for(auto& target : pool.targets) {
+		if(!target.in_use && target.key == key) {
+			target.in_use = true;
+			target.last_used_frame = pool.frame;
+			if(target.name != name) {
+				rename_gpu_resource(GL_TEXTURE, target.texture, name);
+				target.name = name;
+			}
+			if(target.border != border) {
+				set_render_texture_parameters(target.texture, border);
+				target.border = border;
+			}
+			pool.reuse_count++;
+			return target.texture;
+		}
+	}
+	pooled_render_target_type target;
+	target.key = key;
+	target.texture = create_render_texture(size, layers, format, mip_count, name, GPU_CATEGORY_SHADOW_TARGETS, "pooled attachment");
+	target.name = name;
+	target.border = border;
+	target.in_use = true;
+	target.last_used_frame = pool.frame;
+	set_render_texture_parameters(target.texture, border);
+	pool.targets.push_back(target);
+	pool.allocation_count++;
+	return target.texture;
+}
+
+void release_render_target(GLuint& texture) {
+	auto& pool = render_target_pool;
+	for(auto& target : pool.targets) {
+		if(target.texture == texture) {
+			target.in_use = false;
+			target.last_used_frame = pool.frame;
+		}
+	}
+	texture = 0;
+}
+
+void update_render_target_pool() {
+	//the targets left after a settings change are kept for a while, so switching back doesn't allocate
+	auto& pool = render_target_pool;
+	pool.frame++;
+	auto kept = 0;
+	for(int i = 0; i < pool.targets.size(); i++) {
+		auto& target = pool.targets[i];
+		if(!target.in_use && pool.frame - target.last_used_frame > RENDER_TARGET_IDLE_FRAME_COUNT) {
+			delete_gpu_resources(GL_TEXTURE, 1, &target.texture);
+		} else {
+			pool.targets[kept++] = target;
+		}
+	}
+	pool.targets.resize(kept);
+}
+
+void trim_render_target_pool(std::vector<render_target_key_type> wanted_keys) {
+	//every free target is either one of the wanted ones, which are acquired next, or it's deleted, so the old settings' targets never count against the budget
+	auto& pool = render_target_pool;
+	auto kept = 0;
+	for(int i = 0; i < pool.targets.size(); i++) {
+		auto& target = pool.targets[i];
+		auto wanted = std::find(wanted_keys.begin(), wanted_keys.end(), target.key);
+		if(target.in_use) {
+			pool.targets[kept++] = target;
+		} else if(wanted != wanted_keys.end()) {
+			wanted_keys.erase(wanted);
+			pool.targets[kept++] = target;
+		} else {
+			delete_gpu_resources(GL_TEXTURE, 1, &target.texture);
+		}
+	}
+	pool.targets.resize(kept);
+}
+
+void destroy_render_target_pool() {
+	for(auto& target : render_target_pool.targets) {
+		delete_gpu_resources(GL_TEXTURE, 1, &target.texture);
+	}
+	render_target_pool.targets.clear();
+}
+
+std::string get_fbo_error(const GLenum type) {
+	switch(type) {
+		case GL_FRAMEBUFFER_UNDEFINED: return "FRAMEBUFFER_UNDEFINED";
+		case GL_FRAMEBUFFER_INCOMPLETE_ATTACHMENT: return "FRAMEBUFFER_INCOMPLETE_ATTACHMENT";
+		case GL_FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT: return "FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT";
+		case GL_FRAMEBUFFER_INCOMPLETE_DRAW_BUFFER: return "FRAMEBUFFER_INCOMPLETE_DRAW_BUFFER";
+		case GL_FRAMEBUFFER_INCOMPLETE_READ_BUFFER: return "FRAMEBUFFER_INCOMPLETE_READ_BUFFER";
+		case GL_FRAMEBUFFER_UNSUPPORTED: return "FRAMEBUFFER_UNSUPPORTED";
+		case GL_FRAMEBUFFER_INCOMPLETE_MULTISAMPLE: return "FRAMEBUFFER_INCOMPLETE_MULTISAMPLE";
+		case GL_FRAMEBUFFER_INCOMPLETE_LAYER_TARGETS: return "FRAMEBUFFER_INCOMPLETE_LAYER_TARGETS";
+		default: return "UNKNOWN";
+	}
+}
+
+int get_cascade_count() {
+	if(is_virtual_shadow_map_active()) {
+		return 1;
+	}
+	return shadow_map_settings.match_frustums ? shadow_map_settings.cascade_count : 1;
+}
+
+int get_rendered_resolution() {
+	if(!shadow_map_settings.dynamic_resolution) {
+		return shadow_map_settings.resolution;
+	}
+	return min(resolution_governor.rendered_resolution, shadow_map_settings.resolution);
+}
+
+float get_uv_scale() {
+	return static_cast<float>(get_rendered_resolution()) / shadow_map_settings.resolution;
+}
+
+GLuint get_all_layers_mask() {
+	return (1u << get_cascade_count()) - 1;
+}
+
+void check_fbo(const GLuint fbo) {
+	auto status = glCheckNamedFramebufferStatus(fbo, GL_FRAMEBUFFER);
+	if(status != GL_FRAMEBUFFER_COMPLETE) {
+		std::cout << get_fbo_error(status) << std::endl;
+	}
+}
+
+void create_scene_render_targets() {
+	scene_fbo = create_fbo("<scene fbo>", GPU_CATEGORY_SCENE_TARGETS);
+	scene_color_texture = create_and_attach_texture(scene_fbo, GL_COLOR_ATTACHMENT0, window.size, GL_RGBA8, "<scene color texture>", false, 0, GPU_CATEGORY_SCENE_TARGETS);
+	scene_depth_texture = create_and_attach_texture(scene_fbo, GL_DEPTH_ATTACHMENT, window.size, GL_DEPTH_COMPONENT32F, "<scene depth texture>", false, 0, GPU_CATEGORY_SCENE_TARGETS);
+	check_fbo(scene_fbo);
+}
+
+void create_sdsm_buffers() {
+	//minimums first, then maximums: view depth, light space x, light space y
+	auto flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	for(int i = 0; i < 2; i++) {
+		sdsm.buffers[i] = create_buffer(nullptr, 6 * sizeof(GLuint), "<sdsm buffer " + std::to_string(i) + ">", flags, GPU_CATEGORY_BUFFERS);
+		sdsm.mapped_buffers[i] = static_cast<GLuint*>(glMapNamedBufferRange(sdsm.buffers[i], 0, 6 * sizeof(GLuint), flags));
+	}
+}
+
+void create_virtual_shadow_map_buffers() {
+	auto& virtual_map = virtual_shadow_map;
+	auto page_count = VIRTUAL_PAGE_COUNT * VIRTUAL_PAGE_COUNT;
+	auto flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	for(int i = 0; i < 2; i++) {
+		virtual_map.request_buffers[i] = create_buffer(nullptr, page_count * sizeof(GLuint), "<virtual page request buffer " + std::to_string(i) + ">", flags, GPU_CATEGORY_BUFFERS);
+		virtual_map.mapped_request_buffers[i] = static_cast<GLuint*>(glMapNamedBufferRange(virtual_map.request_buffers[i], 0, page_count * sizeof(GLuint), flags));
+	}
+	glCreateTextures(GL_TEXTURE_2D, 1, &virtual_map.page_table_texture);
+	glTextureStorage2D(virtual_map.page_table_texture, 1, GL_R32UI, VIRTUAL_PAGE_COUNT, VIRTUAL_PAGE_COUNT);
+	register_gpu_resource(GL_TEXTURE, virtual_map.page_table_texture, "<virtual page table texture>", GPU_CATEGORY_SHADOW_TARGETS, GL_R32UI, "sampled", page_count * get_texel_size(GL_R32UI));
+	glTextureParameteri(virtual_map.page_table_texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(virtual_map.page_table_texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	virtual_map.page_table.assign(page_count, INVALID_PAGE);
+}
+
+void release_virtual_pages() {
+	auto& virtual_map = virtual_shadow_map;
+	virtual_map.physical_pages.assign(PHYSICAL_PAGE_COUNT * PHYSICAL_PAGE_COUNT, physical_page_type());
+	virtual_map.resident_pages.clear();
+}
+
+render_target_key_type get_blur_render_target_key() {
+	//the layers are blurred one by one, so the intermediate texture has one layer
+	return get_render_target_key(glm::ivec2(shadow_map_settings.resolution), 1, GL_RG32F);
+}
+
+void create_virtual_shadow_map_render_targets() {
+	auto& virtual_map = virtual_shadow_map;
+	release_virtual_pages();
+	if(!is_virtual_shadow_map_active()) {
+		if(virtual_map.fbo != 0) {
+			glNamedFramebufferTexture(virtual_map.fbo, GL_DEPTH_ATTACHMENT, 0, 0);
+		}
+		return;
+	}
+	if(virtual_map.fbo == 0) {
+		virtual_map.fbo = create_fbo("<virtual shadow map fbo>");
+		glNamedFramebufferDrawBuffer(virtual_map.fbo, GL_NONE);
+	}
+	auto size = glm::ivec2(PHYSICAL_PAGE_COUNT * VIRTUAL_PAGE_SIZE);
+	virtual_map.physical_texture = acquire_render_target(size, 0, GL_DEPTH_COMPONENT32F, false, "<virtual shadow map physical texture>");
+	glNamedFramebufferTexture(virtual_map.fbo, GL_DEPTH_ATTACHMENT, virtual_map.physical_texture, 0);
+	check_fbo(virtual_map.fbo);
+}
+
+void create_render_targets() {
+	//the textures go back to the pool before they are acquired again, so the unchanged ones are reused, and the framebuffers are kept
+	release_render_target(shadow_color_texture);
+	release_render_target(shadow_depth_texture);
+	release_render_target(static_shadow_color_texture);
+	release_render_target(static_shadow_depth_texture);
+	release_render_target(virtual_shadow_map.physical_texture);
+	if(shadow_map_fbo == 0) {
+		shadow_map_fbo = create_fbo("<shadow map fbo>");
+		static_shadow_map_fbo = create_fbo("<static shadow map fbo>");
+		blur_fbo = create_fbo("<blur fbo>");
+	}
+	auto size = glm::ivec2(shadow_map_settings.resolution);
+	auto layers = get_cascade_count();
+	auto internal_format = shadow_map_settings.mode == MODE_VSM ? GL_RG32F : GL_R32F;
+	std::vector<render_target_key_type> wanted_keys = {get_render_target_key(size, layers, internal_format), get_render_target_key(size, layers, GL_DEPTH_COMPONENT32F)};
+	if(shadow_map_settings.cache_static_casters) {
+		wanted_keys.push_back(get_render_target_key(size, layers, internal_format));
+		wanted_keys.push_back(get_render_target_key(size, layers, GL_DEPTH_COMPONENT32F));
+	}
+	if(shadow_map_settings.mode == MODE_VSM) {
+		wanted_keys.push_back(get_blur_render_target_key());
+	}
+	if(is_virtual_shadow_map_active()) {
+		wanted_keys.push_back(get_render_target_key(glm::ivec2(PHYSICAL_PAGE_COUNT * VIRTUAL_PAGE_SIZE), 0, GL_DEPTH_COMPONENT32F));
+	}
+	trim_render_target_pool(wanted_keys);
+	shadow_color_texture = acquire_render_target(size, layers, internal_format, shadow_map_settings.mode != MODE_VSM, "<shadow map color texture>");
+	shadow_depth_texture = acquire_render_target(size, layers, GL_DEPTH_COMPONENT32F, true, "<shadow map depth texture>");
+	glNamedFramebufferTexture(shadow_map_fbo, GL_COLOR_ATTACHMENT0, shadow_color_texture, 0);
+	glNamedFramebufferTexture(shadow_map_fbo, GL_DEPTH_ATTACHMENT, shadow_depth_texture, 0);
+	check_fbo(shadow_map_fbo);
+
+	delete_gpu_resources(GL_TEXTURE, shadow_map_preview_textures.size(), shadow_map_preview_textures.data());
+	shadow_map_preview_textures = std::vector<GLuint>(layers);
+	glGenTextures(layers, shadow_map_preview_textures.data());
+	for(int i = 0; i < layers; i++) {
+		auto shadow_map = shadow_map_settings.mode == MODE_VSM ? shadow_color_texture : shadow_depth_texture;
+		auto shadow_map_format = shadow_map_settings.mode == MODE_VSM ? internal_format : GL_DEPTH_COMPONENT32F;
+		glTextureView(shadow_map_preview_textures[i], GL_TEXTURE_2D, shadow_map, shadow_map_format, 0, 1, i, 1);
+		register_gpu_resource(GL_TEXTURE, shadow_map_preview_textures[i], "<shadow map preview " + std::to_string(i) + ">", GPU_CATEGORY_SHADOW_TARGETS, shadow_map_format, "view", 0);
+	}
+
+	for(auto& layer : shadow_cache.layers) {
+		layer.valid = false;
+	}
+	for(auto& valid : shadow_update_scheduler.valid) {
+		valid = false;
+	}
+	if(shadow_map_settings.cache_static_casters) {
+		static_shadow_color_texture = acquire_render_target(size, layers, internal_format, shadow_map_settings.mode != MODE_VSM, "<static shadow map color texture>");
+		static_shadow_depth_texture = acquire_render_target(size, layers, GL_DEPTH_COMPONENT32F, true, "<static shadow map depth texture>");
+		glNamedFramebufferTexture(static_shadow_map_fbo, GL_COLOR_ATTACHMENT0, static_shadow_color_texture, 0);
+		glNamedFramebufferTexture(static_shadow_map_fbo, GL_DEPTH_ATTACHMENT, static_shadow_depth_texture, 0);
+		check_fbo(static_shadow_map_fbo);
+	} else {
+		//an attachment would keep a trimmed texture's memory alive
+		glNamedFramebufferTexture(static_shadow_map_fbo, GL_COLOR_ATTACHMENT0, 0, 0);
+		glNamedFramebufferTexture(static_shadow_map_fbo, GL_DEPTH_ATTACHMENT, 0, 0);
+	}
+	create_virtual_shadow_map_render_targets();
+}
+
+void load_uniform_float(const GLuint program, const float value, const std::string& name) {
+	auto location = glGetUniformLocation(program, name.c_str());
+	if(location == -1) {
+		std::cout << name << " doesn't found" << std::endl;
+	}
+	glProgramUniform1f(program, location, value);
+}
+
+void load_uniform_int(const GLuint program, const int value, const std::string& name) {
+	auto location = glGetUniformLocation(program, name.c_str());
+	if(location == -1) {
+		std::cout << name << " doesn't found" << std::endl;
+	}
+	glProgramUniform1i(program, location, value);
+}
+
+void load_uniform_vec2(const GLuint program, const glm::vec2 value, const std::string& name) {
+	auto location = glGetUniformLocation(program, name.c_str());
+	if(location == -1) {
+		std::cout << name << " doesn't found" << std::endl;
+	}
+	glProgramUniform2fv(program, location, 1, &value[0]);
+}
+
+void load_uniform_vec3(const GLuint program, const glm::vec3 value, const std::string& name) {
+	auto location = glGetUniformLocation(program, name.c_str());
+	if(location == -1) {
+		std::cout << name << " doesn't found" << std::endl;
+	}
+	glProgramUniform3fv(program, location, 1, &value[0]);
+}
+
+void load_uniform_vec4(const GLuint program, const glm::vec4 value, const std::string& name) {
+	auto location = glGetUniformLocation(program, name.c_str());
+	if(location == -1) {
+		std::cout << name << " doesn't found" << std::endl;
+	}
+	glProgramUniform4fv(program, location, 1, &value[0]);
+}
+
+void load_uniform_mat(const GLuint program, const glm::mat4 value, const std::string& name) {
+	auto location = glGetUniformLocation(program, name.c_str());
+	if(location == -1) {
+		std::cout << name << " doesn't found" << std::endl;
+	}
+	glProgramUniformMatrix4fv(program, location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void load_uniform_texture(const GLuint program, const GLuint texture, const std::string& name, const GLuint unit = 0) {
+	auto location = glGetUniformLocation(program, name.c_str());
+	if(location == -1) {
+		std::cout << name << " doesn't found" << std::endl;
+	}
+	glBindTextureUnit(unit, texture);
+	glProgramUniform1i(program, location, unit);
+}
+
+void load_uniform_float_array(const GLuint program, const std::vector<float>& values, const std::string& name) {
+	auto location = glGetUniformLocation(program, name.c_str());
+	if(location == -1) {
+		std::cout << name << " doesn't found" << std::endl;
+	}
+	glProgramUniform1fv(program, location, values.size(), values.data());
+}
+
+void load_uniform_vec4_array(const GLuint program, const std::vector<glm::vec4>& values, const std::string& name) {
+	auto location = glGetUniformLocation(program, name.c_str());
+	if(location == -1) {
+		std::cout << name << " doesn't found" << std::endl;
+	}
+	glProgramUniform4fv(program, location, values.size(), glm::value_ptr(values[0]));
+}
+
+void load_uniform_mat_array(const GLuint program, const std::vector<glm::mat4>& values, const std::string& name) {
+	auto location = glGetUniformLocation(program, name.c_str());
+	if(location == -1) {
+		std::cout << name << " doesn't found" << std::endl;
+	}
+	glProgramUniformMatrix4fv(program, location, values.size(), GL_FALSE, glm::value_ptr(values[0]));
+}
+
+void get_frustum_slice_corner_points(const float slice_near, const float slice_far, glm::vec3 (&corner_points)[8]) {
+	//the corner points of a slice are the near plane's corner points pushed along their rays
+	auto inverse_projection = glm::inverse(player.projection);
+	for(int i = 0; i < 4; i++) {
+		auto near_corner_point = inverse_projection * NDC_FRUSTUM_CORNER_POINTS[i + 4];
+		auto ray = glm::vec3(near_corner_point) / near_corner_point.w / player.near_plane;
+		corner_points[i] = ray * slice_far;
+		corner_points[i + 4] = ray * slice_near;
+	}
+}
+
+float decode_sortable_float(const GLuint value) {
+	//inverse of the order preserving mapping in sdsm_reduction.comp
+	auto bits = value & 0x80000000u ? value & 0x7FFFFFFFu : ~value;
+	float result;
+	std::memcpy(&result, &bits, sizeof(float));
+	return result;
+}
+
+glm::mat4 get_light_rotation(const glm::vec3 direction) {
+	return glm::inverse(glm::toMat4(glm::quatLookAt(direction, glm::vec3(0.0, 1.0, 0.0))));
+}
+
+void read_back_scene_depth_bounds() {
+	//the buffer written in the previous frame, if the gpu is done with it
+	auto index = (sdsm.frame_index + 1) % 2;
+	auto fence = sdsm.fences[index];
+	if(fence == 0 || glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+		return;
+	}
+	glDeleteSync(fence);
+	sdsm.fences[index] = 0;
+	auto values = sdsm.mapped_buffers[index];
+	sdsm.min_depth = decode_sortable_float(values[0]);
+	sdsm.max_depth = decode_sortable_float(values[3]);
+	sdsm.min_position = glm::vec2(decode_sortable_float(values[1]), decode_sortable_float(values[2]));
+	sdsm.max_position = glm::vec2(decode_sortable_float(values[4]), decode_sortable_float(values[5]));
+	sdsm.light_direction = sdsm.light_directions[index];
+	//no samples, eg. only the sky is visible
+	sdsm.valid = sdsm.min_depth <= sdsm.max_depth;
+}
+
+void reduce_scene_depth() {
+	auto index = sdsm.frame_index;
+	auto buffer = sdsm.buffers[index];
+	const GLuint min_value = 0xFFFFFFFFu;
+	const GLuint max_value = 0;
+	glClearNamedBufferSubData(buffer, GL_R32UI, 0, 3 * sizeof(GLuint), GL_RED_INTEGER, GL_UNSIGNED_INT, &min_value);
+	glClearNamedBufferSubData(buffer, GL_R32UI, 3 * sizeof(GLuint), 3 * sizeof(GLuint), GL_RED_INTEGER, GL_UNSIGNED_INT, &max_value);
+
+	auto compute_program = sdsm_pipeline.compute_program;
+	load_uniform_texture(compute_program, scene_depth_texture, "u_depth_texture");
+	load_uniform_mat(compute_program, glm::inverse(player.projection), "u_inverse_projection");
+	load_uniform_mat(compute_program, get_light_rotation(light.direction) * glm::inverse(player.view), "u_light_rotation_inverse_view");
+	glBindProgramPipeline(sdsm_pipeline.pipeline);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buffer);
+	glDispatchCompute((window.size.x + 15) / 16, (window.size.y + 15) / 16, 1);
+	glMemoryBarrier(GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+
+	glDeleteSync(sdsm.fences[index]);
+	sdsm.fences[index] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	sdsm.light_directions[index] = light.direction;
+	sdsm.frame_index = (sdsm.frame_index + 1) % 2;
+}
+
+bool is_sdsm_active() {
+	return shadow_map_settings.match_frustums && shadow_map_settings.sdsm && sdsm.valid;
+}
+
+void compute_cascade_splits() {
+	auto near_plane = player.near_plane;
+	auto far_plane = player.far_plane;
+	if(is_sdsm_active()) {
+		//the visible samples' depth range, the camera's own range is mostly empty space
+		near_plane = glm::clamp(sdsm.min_depth, player.near_plane, player.far_plane);
+		far_plane = glm::clamp(sdsm.max_depth, near_plane + 0.01f, player.far_plane);
+	}
+	auto cascade_count = get_cascade_count();
+	auto lambda = shadow_map_settings.cascade_split_lambda;
+	for(int i = 0; i < cascade_count; i++) {
+		auto& cascade = light.cascades[i];
+		auto ratio = (i + 1.0f) / cascade_count;
+		auto logarithmic_split = near_plane * glm::pow(far_plane / near_plane, ratio);
+		auto uniform_split = near_plane + (far_plane - near_plane) * ratio;
+		cascade.split_near = i == 0 ? near_plane : light.cascades[i - 1].split_far;
+		cascade.split_far = lambda * logarithmic_split + (1.0f - lambda) * uniform_split;
+	}
+}
+
+float get_cascade_fit_near(const int cascade_index) {
+	//a cascade also covers the blend band at the end of the previous one
+	auto& cascade = light.cascades[cascade_index];
+	if(cascade_index == 0) {
+		return cascade.split_near;
+	}
+	auto& previous_cascade = light.cascades[cascade_index - 1];
+	return cascade.split_near - shadow_map_settings.cascade_blend * (previous_cascade.split_far - previous_cascade.split_near);
+}
+
+void compute_stable_cascade_matrices(cascade_type& cascade, const glm::vec3 (&corner_points)[8]) {
+	//the bounding sphere is computed in view space, so it doesn't change when the camera rotates
+	auto center = glm::vec3(0.0);
+	for(auto& corner_point : corner_points) {
+		center += corner_point / 8.0f;
+	}
+	float radius = 0.0;
+	for(auto& corner_point : corner_points) {
+		radius = max(radius, glm::length(corner_point - center));
+	}
+	radius = glm::ceil(radius);
+
+	//one texel of padding on each side, because the snapped origin can be up to one texel away from the center
+	auto resolution = get_rendered_resolution();
+	cascade.texel_size = 2.0f * radius / (resolution - 2);
+	auto half_size = cascade.texel_size * resolution / 2.0f;
+	auto light_rotation = glm::lookAt(glm::vec3(0.0), light.direction, glm::vec3(0.0, 1.0, 0.0));
+	auto ls_center = glm::vec3(light_rotation * glm::inverse(player.view) * glm::vec4(center, 1.0));
+	cascade.texel_origin = glm::ivec2(glm::floor(glm::vec2(ls_center) / cascade.texel_size));
+	auto snapped_depth = glm::floor(ls_center.z / radius) * radius;
+	auto eye = glm::vec3(glm::vec2(cascade.texel_origin) * cascade.texel_size, snapped_depth + 2.0f * radius + light.distance);
+	cascade.view = glm::translate(glm::mat4(1.0), -eye) * light_rotation;
+	cascade.scrollable = true;
+
+	cascade.near_plane = 0.0;
+	cascade.far_plane = light.distance + 3.0f * radius;
+	cascade.frustum_width = 2.0f * half_size;
+	cascade.projection = glm::ortho(-half_size, half_size, -half_size, half_size, cascade.near_plane, cascade.far_plane);
+}
+
+void compute_frustum_cascade_matrices(cascade_type& cascade, const glm::vec3 (&corner_points)[8]) {
+	cascade.scrollable = false;
+	cascade.texel_origin = glm::ivec2(0);
+	auto light_rotation = glm::quatLookAt(light.direction, glm::vec3(0.0, 1.0, 0.0));
+	auto inverse_view = glm::inverse(player.view);
+	cascade.view = glm::inverse(glm::translate(glm::mat4(1.0), -light.direction * light.distance + player.position) * glm::toMat4(light_rotation));
+	auto min_distances = glm::vec3(INFINITY);
+	auto max_distances = glm::vec3(-INFINITY);
+	for(auto& corner_point : corner_points) {
+		auto light_view_corner_point = cascade.view * inverse_view * glm::vec4(corner_point, 1.0);
+		for(int i = 0; i < 3; i++) {
+			min_distances[i] = min(min_distances[i], light_view_corner_point[i]);
+			max_distances[i] = max(max_distances[i], light_view_corner_point[i]);
+		}
+	}
+	cascade.near_plane = -max_distances[2] - light.distance;
+	cascade.far_plane = -min_distances[2];
+	cascade.frustum_width = max_distances[0] - min_distances[0];
+	cascade.projection = glm::ortho(min_distances[0], max_distances[0], min_distances[1], max_distances[1], cascade.near_plane, cascade.far_plane);
+}
+
+bool is_same_slice(const cascade_type& a, const cascade_type& b) {
+	return a.split_near == b.split_near && a.split_far == b.split_far;
+}
+
+void schedule_shadow_updates() {
+	auto& scheduler = shadow_update_scheduler;
+	auto cascade_count = get_cascade_count();
+	scheduler.frame_index++;
+	std::vector<std::pair<float, int>> candidates;
+	GLuint update_layer_mask = 0;
+	for(int i = 0; i < cascade_count; i++) {
+		auto& rendered_cascade = scheduler.rendered_cascades[i];
+		if(!shadow_map_settings.amortized_updates || !scheduler.valid[i] || !is_same_slice(rendered_cascade, light.cascades[i])) {
+			update_layer_mask |= 1u << i;
+			continue;
+		}
+		//views that are the most overdue relative to their period go first, ties favor the finer cascades
+		auto age = scheduler.frame_index - scheduler.last_update_frames[i];
+		auto period = shadow_map_settings.update_periods[i];
+		if(age >= period) {
+			candidates.push_back(std::make_pair(static_cast<float>(age) / period - i * 0.001f, i));
+		}
+	}
+	std::sort(candidates.begin(), candidates.end(), std::greater<std::pair<float, int>>());
+	auto remaining_updates = shadow_map_settings.max_updates_per_frame;
+	for(int i = 0; i < cascade_count; i++) {
+		remaining_updates -= (update_layer_mask >> i) & 1;
+	}
+	for(int i = 0; i < candidates.size() && i < remaining_updates; i++) {
+		update_layer_mask |= 1u << candidates[i].second;
+	}
+
+	scheduler.update_layer_mask = update_layer_mask;
+	scheduler.update_count = 0;
+	for(int i = 0; i < cascade_count; i++) {
+		if(update_layer_mask & (1u << i)) {
+			scheduler.rendered_cascades[i] = light.cascades[i];
+			scheduler.last_update_frames[i] = scheduler.frame_index;
+			scheduler.valid[i] = true;
+			scheduler.update_count++;
+		} else {
+			light.cascades[i] = scheduler.rendered_cascades[i];
+		}
+	}
+}
+
+void compute_lispsm_cascade_matrices(cascade_type& cascade, const glm::vec3 (&corner_points)[8], const float slice_near, const float slice_far) {
+	auto inverse_view = glm::inverse(player.view);
+	auto view_direction = glm::normalize(glm::vec3(inverse_view * glm::vec4(0.0, 0.0, -1.0, 0.0)));
+	auto cos_gamma = glm::dot(view_direction, light.direction);
+	auto sin_gamma = glm::sqrt(1.0f - cos_gamma * cos_gamma);
+	//looking along the light, there is nothing to warp
+	if(sin_gamma < 0.01f) {
+		compute_frustum_cascade_matrices(cascade, corner_points);
+		return;
+	}
+	cascade.scrollable = false;
+	cascade.texel_origin = glm::ivec2(0);
+	//the light space y axis is the view direction projected onto the light's plane, the warp is applied along it
+	auto up = glm::normalize(view_direction - light.direction * cos_gamma);
+	auto eye = player.position - light.direction * light.distance;
+	cascade.view = glm::lookAt(eye, eye + light.direction, up);
+	auto min_distances = glm::vec3(INFINITY);
+	auto max_distances = glm::vec3(-INFINITY);
+	glm::vec4 light_view_corner_points[8];
+	for(int i = 0; i < 8; i++) {
+		light_view_corner_points[i] = cascade.view * inverse_view * glm::vec4(corner_points[i], 1.0);
+		min_distances = glm::min(min_distances, glm::vec3(light_view_corner_points[i]));
+		max_distances = glm::max(max_distances, glm::vec3(light_view_corner_points[i]));
+	}
+	cascade.near_plane = -max_distances.z - light.distance;
+	cascade.far_plane = -min_distances.z;
+	cascade.frustum_width = max_distances.x - min_distances.x;
+
+	//the optimal distance of the projection center from the body, from the lispsm paper
+	auto near_plane = (slice_near + glm::sqrt(slice_near * slice_far)) / sin_gamma;
+	auto far_plane = near_plane + max_distances.y - min_distances.y;
+	auto camera_position = cascade.view * glm::vec4(player.position, 1.0);
+	auto center = glm::vec3(camera_position.x, min_distances.y - near_plane, 0.0);
+	auto warp = glm::mat4(0.0);
+	warp[0][0] = 1.0;
+	warp[1][1] = (far_plane + near_plane) / (far_plane - near_plane);
+	warp[3][1] = -2.0f * far_plane * near_plane / (far_plane - near_plane);
+	warp[2][2] = 1.0;
+	warp[1][3] = 1.0;
+	warp = warp * glm::translate(glm::mat4(1.0), -center);
+
+	//fits the warped body into the unit cube
+	auto warped_min = glm::vec3(INFINITY);
+	auto warped_max = glm::vec3(-INFINITY);
+	for(auto& light_view_corner_point : light_view_corner_points) {
+		auto warped_corner_point = warp * light_view_corner_point;
+		warped_min = glm::min(warped_min, glm::vec3(warped_corner_point) / warped_corner_point.w);
+		warped_max = glm::max(warped_max, glm::vec3(warped_corner_point) / warped_corner_point.w);
+	}
+	cascade.projection = glm::ortho(warped_min.x, warped_max.x, warped_min.y, warped_max.y, -warped_max.z, -warped_min.z) * warp;
+}
+
+void tighten_cascade_to_samples(cascade_type& cascade) {
+	//the samples' bounds are in the light's rotation space, which differs from the cascade's view space only in a translation
+	//the bounds are one frame late, so skip them if the light has turned since
+	if(sdsm.light_direction != light.direction) {
+		return;
+	}
+	auto offset = glm::vec2((cascade.view * glm::inverse(get_light_rotation(light.direction)))[3]);
+	auto padding = 0.05f * (sdsm.max_position - sdsm.min_position);
+	auto min_position = sdsm.min_position - padding + offset;
+	auto max_position = sdsm.max_position + padding + offset;
+	auto inverse_projection = glm::inverse(cascade.projection);
+	auto cascade_min_position = glm::vec2(inverse_projection * glm::vec4(-1.0, -1.0, 0.0, 1.0));
+	auto cascade_max_position = glm::vec2(inverse_projection * glm::vec4(1.0, 1.0, 0.0, 1.0));
+	cascade_min_position = glm::max(cascade_min_position, min_position);
+	cascade_max_position = glm::min(cascade_max_position, max_position);
+	if(glm::any(glm::greaterThanEqual(cascade_min_position, cascade_max_position))) {
+		return;
+	}
+	cascade.frustum_width = cascade_max_position.x - cascade_min_position.x;
+	cascade.projection = glm::ortho(cascade_min_position.x, cascade_max_position.x, cascade_min_position.y, cascade_max_position.y, cascade.near_plane, cascade.far_plane);
+}
+
+void compute_virtual_shadow_map_matrices() {
+	auto& virtual_map = virtual_shadow_map;
+	auto& cascade = light.cascades[0];
+	auto extent = shadow_map_settings.virtual_shadow_map_extent;
+	auto page_size = extent / VIRTUAL_PAGE_COUNT;
+	auto light_rotation = glm::lookAt(glm::vec3(0.0), light.direction, glm::vec3(0.0, 1.0, 0.0));
+	auto ls_position = glm::vec3(light_rotation * glm::vec4(player.position, 1.0));
+	virtual_map.page_origin = glm::ivec2(glm::floor(glm::vec2(ls_position) / page_size)) - VIRTUAL_PAGE_COUNT / 2;
+	//the view only has a depth translation, so a page keeps its place in light space when the map moves
+	auto snapped_depth = glm::floor(ls_position.z / extent) * extent;
+	cascade.view = glm::translate(glm::mat4(1.0), glm::vec3(0.0, 0.0, -(snapped_depth + extent + light.distance))) * light_rotation;
+	cascade.scrollable = false;
+	cascade.texel_origin = glm::ivec2(0);
+	cascade.texel_size = extent / VIRTUAL_SHADOW_MAP_RESOLUTION;
+
+	auto min_position = glm::vec2(virtual_map.page_origin) * page_size;
+	auto max_position = min_position + extent;
+	cascade.near_plane = 0.0;
+	cascade.far_plane = light.distance + 2.0f * extent;
+	cascade.frustum_width = extent;
+	cascade.projection = glm::ortho(min_position.x, max_position.x, min_position.y, max_position.y, cascade.near_plane, cascade.far_plane);
+}
+
+float get_virtual_page_margin() {
+	//filter kernels reaching over a page's edge need the neighboring page too, only the adjacent pages are marked
+	auto margin = 0.0f;
+	if(shadow_map_settings.mode == MODE_PCF) {
+		margin = light.size * shadow_map_settings.scale;
+	} else if(shadow_map_settings.mode == MODE_PCSS) {
+		margin = light.size * shadow_map_settings.scale / shadow_map_settings.virtual_shadow_map_extent;
+	}
+	return min(margin, 1.0f / VIRTUAL_PAGE_COUNT);
+}
+
+void mark_virtual_pages() {
+	auto& virtual_map = virtual_shadow_map;
+	auto index = virtual_map.frame_index;
+	auto buffer = virtual_map.request_buffers[index];
+	const GLuint zero = 0;
+	glClearNamedBufferData(buffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+	auto& cascade = light.cascades[0];
+	auto compute_program = virtual_page_marking_pipeline.compute_program;
+	load_uniform_texture(compute_program, scene_depth_texture, "u_depth_texture");
+	load_uniform_mat(compute_program, cascade.projection * cascade.view * glm::inverse(player.projection * player.view), "u_ndc_to_virtual");
+	load_uniform_float(compute_program, get_virtual_page_margin(), "u_margin");
+	load_uniform_int(compute_program, VIRTUAL_PAGE_COUNT, "u_page_count");
+	glBindProgramPipeline(virtual_page_marking_pipeline.pipeline);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buffer);
+	glDispatchCompute((window.size.x + 15) / 16, (window.size.y + 15) / 16, 1);
+	glMemoryBarrier(GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+
+	glDeleteSync(virtual_map.fences[index]);
+	virtual_map.fences[index] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	virtual_map.request_page_origins[index] = virtual_map.page_origin;
+	virtual_map.frame_index = (virtual_map.frame_index + 1) % 2;
+}
+
+void read_back_virtual_page_requests() {
+	//if the gpu isn't done yet, the previous requests are used again
+	auto& virtual_map = virtual_shadow_map;
+	auto index = (virtual_map.frame_index + 1) % 2;
+	auto fence = virtual_map.fences[index];
+	if(fence == 0 || glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+		return;
+	}
+	glDeleteSync(fence);
+	virtual_map.fences[index] = 0;
+	auto requests = virtual_map.mapped_request_buffers[index];
+	auto origin = virtual_map.request_page_origins[index];
+	virtual_map.requested_pages.clear();
+	for(int i = 0; i < VIRTUAL_PAGE_COUNT * VIRTUAL_PAGE_COUNT; i++) {
+		if(requests[i]) {
+			virtual_map.requested_pages.push_back(origin + glm::ivec2(i % VIRTUAL_PAGE_COUNT, i / VIRTUAL_PAGE_COUNT));
+		}
+	}
+}
+
+void compute_matrices() {
+	player.view = glm::toMat4(player.rotation);
+	player.view = glm::translate(player.view, -player.position);
+
+	player.projection = glm::perspective(glm::radians(70.0f), 1.0f * window.size.x / window.size.y, player.near_plane, player.far_plane);
+
+	read_back_scene_depth_bounds();
+	compute_cascade_splits();
+	if(is_virtual_shadow_map_active()) {
+		compute_virtual_shadow_map_matrices();
+	} else if(shadow_map_settings.match_frustums) {
+		for(int i = 0; i < get_cascade_count(); i++) {
+			auto& cascade = light.cascades[i];
+			glm::vec3 corner_points[8];
+			get_frustum_slice_corner_points(get_cascade_fit_near(i), cascade.split_far, corner_points);
+			if(shadow_map_settings.lispsm) {
+				compute_lispsm_cascade_matrices(cascade, corner_points, get_cascade_fit_near(i), cascade.split_far);
+			} else if(is_sdsm_active()) {
+				//the tight fit changes every frame, texel snapping wouldn't help
+				compute_frustum_cascade_matrices(cascade, corner_points);
+				tighten_cascade_to_samples(cascade);
+			} else if(shadow_map_settings.stable_fit) {
+				compute_stable_cascade_matrices(cascade, corner_points);
+			} else {
+				compute_frustum_cascade_matrices(cascade, corner_points);
+			}
+		}
+	} else {
+		auto& cascade = light.cascades[0];
+		cascade.scrollable = false;
+		cascade.texel_origin = glm::ivec2(0);
+		cascade.view = glm::lookAt(glm::vec3(0.0), light.direction, glm::vec3(0.0, 1.0, 0.0));
+		cascade.view = glm::translate(cascade.view, glm::vec3(-30.0, -50.0, 90.0));
+		cascade.frustum_width = 60.0;
+		cascade.near_plane = 1.0;
+		cascade.far_plane = 130.0;
+
+		cascade.projection = glm::ortho(-30.0, 30.0, -30.0, 30.0, 1.0, 130.0);
+	}
+	schedule_shadow_updates();
+}
+
+float get_filter_scale(const int cascade_index) {
+	//keeps the filter's world space size the same in every cascade
+	return light.cascades[0].frustum_width / light.cascades[cascade_index].frustum_width;
+}
+
+void load_uniforms() {
+	auto fragment_program = lambertian_pipeline.fragment_program;
+	for(auto vertex_program : {lambertian_pipeline.vertex_program, scene_store_pipeline.vertex_program}) {
+		load_uniform_mat(vertex_program, player.view, "u_view");
+		load_uniform_mat(vertex_program, player.projection, "u_projection");
+	}
+
+	if(is_virtual_shadow_map_active()) {
+		load_uniform_texture(fragment_program, virtual_shadow_map.physical_texture, "u_physical_texture");
+		load_uniform_texture(fragment_program, virtual_shadow_map.page_table_texture, "u_page_table", 1);
+		load_uniform_int(fragment_program, VIRTUAL_PAGE_COUNT, "u_page_count");
+		load_uniform_int(fragment_program, PHYSICAL_PAGE_COUNT, "u_physical_page_count");
+	} else {
+		auto shadow_map = shadow_map_settings.mode == MODE_VSM ? shadow_color_texture : shadow_depth_texture;
+		load_uniform_texture(fragment_program, shadow_map, "u_shadow_map");
+		load_uniform_float(fragment_program, get_uv_scale(), "u_uv_scale");
+	}
+
+	auto cascade_count = get_cascade_count();
+	std::vector<glm::mat4> light_views;
+	std::vector<glm::mat4> light_projections;
+	std::vector<float> split_distances = {light.cascades[0].split_near};
+	std::vector<float> near_planes;
+	std::vector<float> far_planes;
+	for(int i = 0; i < cascade_count; i++) {
+		auto& cascade = light.cascades[i];
+		light_views.push_back(cascade.view);
+		light_projections.push_back(cascade.projection);
+		split_distances.push_back(cascade.split_far);
+		near_planes.push_back(cascade.near_plane);
+		far_planes.push_back(cascade.far_plane);
+	}
+	load_uniform_mat_array(fragment_program, light_views, "u_light_views");
+	load_uniform_mat_array(fragment_program, light_projections, "u_light_projections");
+	load_uniform_float_array(fragment_program, split_distances, "u_split_distances");
+	load_uniform_int(fragment_program, cascade_count, "u_cascade_count");
+	load_uniform_float(fragment_program, shadow_map_settings.cascade_blend, "u_cascade_blend");
+	load_uniform_float_array(fragment_program, near_planes, "u_near_planes");
+	load_uniform_float_array(fragment_program, far_planes, "u_far_planes");
+	load_uniform_vec3(fragment_program, light.direction, "u_light_direction");
+	load_uniform_texture(fragment_program, shadow_atlas.depth_texture, "u_shadow_atlas", 2);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, shadow_atlas.light_buffer.buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, light_clusters.cluster_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, light_clusters.light_index_buffer);
+	auto cluster_depth_scale = CLUSTER_COUNT_Z / glm::log(player.far_plane / player.near_plane);
+	load_uniform_vec2(fragment_program, glm::vec2(window.size), "u_viewport_size");
+	load_uniform_float(fragment_program, cluster_depth_scale, "u_cluster_depth_scale");
+	load_uniform_float(fragment_program, -glm::log(player.near_plane) * cluster_depth_scale, "u_cluster_depth_bias");
+	load_uniform_texture(fragment_program, point_shadow_maps.depth_texture, "u_point_shadow_maps", 3);
+
+	load_uniform_vec3(fragment_program, light.color, "u_light_color");
+	load_uniform_float(fragment_program, shadow_map_settings.intensity, "u_intensity");
+	if(shadow_map_settings.mode == MODE_PCF || shadow_map_settings.mode == MODE_PCSS) {
+		load_uniform_float(fragment_program, light.size, "u_light_size");
+		load_uniform_float(fragment_program, shadow_map_settings.rotate_samples, "u_rotate_samples");
+		load_uniform_float(fragment_program, shadow_map_settings.scale, "u_scale");
+		if(shadow_map_settings.sampling_mode == SAMPLING_MODE_GRID) {
+			load_uniform_int(fragment_program, shadow_map_settings.grid_kernel_size, "u_kernel_size");
+		} else if(shadow_map_settings.sampling_mode == SAMPLING_MODE_VOGEL) {
+			load_uniform_int(fragment_program, shadow_map_settings.vogel_sample_count, "u_vogel_sample_count");
+		}
+	}
+	if(shadow_map_settings.mode == MODE_VSM) {
+		load_uniform_float(fragment_program, shadow_map_settings.vsm_smoothstep_fix, "u_smoothstep_fix");
+		load_uniform_float(fragment_program, shadow_map_settings.vsm_smoothstep_fix_lower_bound, "u_smoothstep_fix_lower_bound");
+	} else {
+		load_uniform_float(fragment_program, shadow_map_settings.bias, "u_bias");
+	}
+	if(shadow_map_settings.mode == MODE_PCF) {
+		load_uniform_float(fragment_program, light.cascades[0].frustum_width, "u_filter_reference_width");
+	}
+}
+
+glm::vec4 get_depth_row(const glm::mat4& view, const float near_plane, const float far_plane) {
+	return (-glm::row(view, 2) - glm::vec4(0.0, 0.0, 0.0, near_plane)) / (far_plane - near_plane);
+}
+
+void load_shadow_map_uniforms() {
+	std::vector<glm::mat4> view_projections;
+	std::vector<glm::vec4> depth_rows;
+	for(int i = 0; i < get_cascade_count(); i++) {
+		auto& cascade = light.cascades[i];
+		view_projections.push_back(cascade.projection * cascade.view);
+		depth_rows.push_back(get_depth_row(cascade.view, cascade.near_plane, cascade.far_plane));
+	}
+	for(auto vertex_program : {shadow_map_pipeline.vertex_program, scene_store_shadow_pipeline.vertex_program}) {
+		load_uniform_mat_array(vertex_program, view_projections, "u_view_projections");
+		load_uniform_vec4_array(vertex_program, depth_rows, "u_depth_rows");
+	}
+}
+
+void load_renderable_uniforms(const shader_pipeline_type& pipeline, const renderable_type renderable, const bool color = true) {
+	load_uniform_mat(pipeline.vertex_program, compute_model_matrix(renderable), "u_model");
+	//without the dequantization's non uniform scale, the normals aren't quantized relative to the aabb
+	load_uniform_mat(pipeline.vertex_program, glm::transpose(glm::inverse(compute_object_matrix(renderable))), "u_normal_matrix");
+	if(color) {
+		load_uniform_vec3(pipeline.vertex_program, renderable.diffuse_color, "u_diffuse_color");
+	}
+}
+
+void load_gaussian_blur_uniforms(const bool horizontal, const GLuint texture, const int texture_layer, const int layer) {
+	auto fragment_program = gaussian_blur_pipeline.fragment_program;
+	load_uniform_texture(fragment_program, texture, "u_image");
+	load_uniform_int(fragment_program, texture_layer, "u_layer");
+	load_uniform_float(fragment_program, horizontal, "u_horizontal");
+	load_uniform_float(fragment_program, light.size, "u_light_size");
+	load_uniform_float(fragment_program, shadow_map_settings.rotate_samples, "u_rotate_samples");
+	load_uniform_float(fragment_program, shadow_map_settings.scale * get_filter_scale(layer) * get_uv_scale(), "u_scale");
+	load_uniform_float(gaussian_blur_pipeline.vertex_program, get_uv_scale(), "u_uv_scale");
+}
+
+void reserve_dynamic_buffer(dynamic_buffer_type& dynamic_buffer, const GLsizeiptr size, const std::string& name) {
+	if(dynamic_buffer.capacity < size) {
+		delete_gpu_resources(GL_BUFFER, 1, &dynamic_buffer.buffer);
+		dynamic_buffer.capacity = max(size, 2 * dynamic_buffer.capacity);
+		dynamic_buffer.buffer = create_buffer(nullptr, dynamic_buffer.capacity, name, GL_DYNAMIC_STORAGE_BIT, GPU_CATEGORY_BUFFERS);
+	}
+}
+
+void upload_dynamic_buffer(dynamic_buffer_type& dynamic_buffer, const void* data, const GLsizeiptr size, const std::string& name) {
+	reserve_dynamic_buffer(dynamic_buffer, size, name);
+	if(size > 0) {
+		glNamedBufferSubData(dynamic_buffer.buffer, 0, size, data);
+	}
+}
+
+void destroy_dynamic_buffer(dynamic_buffer_type& dynamic_buffer) {
+	delete_gpu_resources(GL_BUFFER, 1, &dynamic_buffer.buffer);
+	dynamic_buffer = dynamic_buffer_type();
+}
+
+void get_clip_space_aabb_corner_points(const glm::mat4& model_view_projection, const mesh_type& mesh, glm::vec4 (&corner_points)[8]) {
+	for(int i = 0; i < 8; i++) {
+		auto corner_point = glm::vec3(i & 1 ? mesh.aabb_max.x : mesh.aabb_min.x, i & 2 ? mesh.aabb_max.y : mesh.aabb_min.y, i & 4 ? mesh.aabb_max.z : mesh.aabb_min.z);
+		corner_points[i] = model_view_projection * glm::vec4(corner_point, 1.0);
+	}
+}
+
+bool is_shadow_caster_visible(const glm::vec4 (&corner_points)[8]) {
+	//there is no near plane, casters between the light and the cascade are extruded toward the light and flattened by depth clamping
+	for(int axis = 0; axis < 2; axis++) {
+		auto all_below = true;
+		auto all_above = true;
+		for(auto& corner_point : corner_points) {
+			all_below = all_below && corner_point[axis] < -corner_point.w;
+			all_above = all_above && corner_point[axis] > corner_point.w;
+		}
+		if(all_below || all_above) {
+			return false;
+		}
+	}
+	return !std::all_of(std::begin(corner_points), std::end(corner_points), [](const glm::vec4& corner_point) {
+		return corner_point.z > corner_point.w;
+	});
+}
+
+bool is_shadow_caster_contained(const glm::vec4 (&corner_points)[8]) {
+	return std::all_of(std::begin(corner_points), std::end(corner_points), [](const glm::vec4& corner_point) {
+		return glm::abs(corner_point.x) <= corner_point.w && glm::abs(corner_point.y) <= corner_point.w && corner_point.z <= corner_point.w;
+	});
+}
+
+void cull_shadow_casters(const bool static_casters, const GLuint layer_mask, const std::vector<glm::mat4>& models) {
+	auto cascade_count = get_cascade_count();
+	auto& culling = shadow_caster_culling;
+	culling.cascade_draw_lists.resize(cascade_count);
+	parallel_for(cascade_count, [&](int cascade_index) {
+		auto& draw_list = culling.cascade_draw_lists[cascade_index];
+		draw_list.clear();
+		if(!(layer_mask & (1u << cascade_index))) {
+			return;
+		}
+		for(int i = 0; i < renderables.size(); i++) {
+			auto& renderable = renderables[i];
+			if(renderable.is_static != static_casters || !renderable.casts_shadows) {
+				continue;
+			}
+			auto& cascade = light.cascades[cascade_index];
+			glm::vec4 corner_points[8];
+			get_clip_space_aabb_corner_points(cascade.projection * cascade.view * models[i], renderable.mesh, corner_points);
+			if(!is_shadow_caster_visible(corner_points)) {
+				continue;
+			}
+			//approximation, a caster inside a finer cascade can still shadow receivers farther away
+			auto contained = false;
+			for(int j = 0; j < cascade_index && shadow_map_settings.skip_contained_casters && !contained; j++) {
+				auto& finer_cascade = light.cascades[j];
+				get_clip_space_aabb_corner_points(finer_cascade.projection * finer_cascade.view * models[i], renderable.mesh, corner_points);
+				contained = is_shadow_caster_contained(corner_points);
+			}
+			if(!contained) {
+				draw_list.push_back(i);
+			}
+		}
+	});
+	culling.layer_masks.assign(renderables.size(), 0);
+	for(int i = 0; i < cascade_count; i++) {
+		for(auto renderable_index : culling.cascade_draw_lists[i]) {
+			culling.layer_masks[renderable_index] |= 1u << i;
+		}
+		culling.caster_counts[i] += culling.cascade_draw_lists[i].size();
+	}
+}
+
+std::vector<int> get_shadow_casters_by_vao() {
+	std::vector<int> order;
+	for(int i = 0; i < renderables.size(); i++) {
+		if(renderables[i].casts_shadows) {
+			order.push_back(i);
+		}
+	}
+	std::stable_sort(order.begin(), order.end(), [](int a, int b) {
+		return renderables[a].mesh.vao < renderables[b].mesh.vao;
+	});
+	return order;
+}
+
+bool has_meshlets(const mesh_type& mesh, const int lod) {
+	return meshlet_culling.enabled && mesh.meshlet_buffer != 0 && mesh.lods[lod].meshlet_count > 0;
+}
+
+void get_frustum_planes(const glm::mat4& view_projection, const bool near_plane, std::vector<glm::vec4>& planes) {
+	//the planes are combinations of the matrix's rows, without a near plane the shadow casters behind it are clamped, not clipped
+	auto transposed = glm::transpose(view_projection);
+	for(int i = 0; i < 6; i++) {
+		auto plane = transposed[3] + (i % 2 == 0 ? 1.0f : -1.0f) * transposed[i / 2];
+		planes.push_back(i == 4 && !near_plane ? glm::vec4(0.0, 0.0, 0.0, 1.0) : plane / glm::length(glm::vec3(plane)));
+	}
+}
+
+int cull_meshlets(std::vector<meshlet_draw_type>& meshlet_draws, const std::vector<glm::vec4>& frustum_planes, const bool orthographic, const glm::vec3& view_position, const glm::vec3& view_direction, meshlet_draw_buffers_type& buffers) {
+	//every draw has room for all of its meshlets, the visible ones are appended, and counted for the indirect count draw
+	GLuint command_count = 0;
+	for(auto& meshlet_draw : meshlet_draws) {
+		meshlet_draw.first_command = command_count;
+		command_count += renderables[meshlet_draw.renderable].mesh.lods[meshlet_draw.lod].meshlet_count;
+	}
+	if(meshlet_draws.empty()) {
+		return 0;
+	}
+	reserve_dynamic_buffer(buffers.command_buffer, command_count * sizeof(draw_elements_indirect_command_type), "<meshlet command buffer>");
+	std::vector<GLuint> counts(meshlet_draws.size(), 0);
+	upload_dynamic_buffer(buffers.count_buffer, counts.data(), counts.size() * sizeof(GLuint), "<meshlet count buffer>");
+
+	auto compute_program = meshlet_culling_pipeline.compute_program;
+	load_uniform_vec4_array(compute_program, frustum_planes, "u_frustum_planes");
+	load_uniform_vec3(compute_program, view_position, "u_view_position");
+	load_uniform_vec3(compute_program, view_direction, "u_view_direction");
+	load_uniform_int(compute_program, orthographic, "u_orthographic");
+	glBindProgramPipeline(meshlet_culling_pipeline.pipeline);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, buffers.command_buffer.buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, buffers.count_buffer.buffer);
+	for(int i = 0; i < meshlet_draws.size(); i++) {
+		auto& meshlet_draw = meshlet_draws[i];
+		auto& renderable = renderables[meshlet_draw.renderable];
+		auto& lod = renderable.mesh.lods[meshlet_draw.lod];
+		//the meshlets' bounds aren't quantized, so the dequantization is left out
+		auto model = compute_object_matrix(renderable);
+		auto scale = glm::abs(renderable.scale);
+		load_uniform_mat(compute_program, model, "u_model");
+		load_uniform_mat(compute_program, glm::transpose(glm::inverse(model)), "u_normal_matrix");
+		load_uniform_float(compute_program, max(scale.x, max(scale.y, scale.z)), "u_scale");
+		//a non uniform or mirroring scale changes the angles between the normals and the view
+		load_uniform_int(compute_program, renderable.scale.x > 0.0f && renderable.scale.x == renderable.scale.y && renderable.scale.x == renderable.scale.z, "u_cone_culling");
+		load_uniform_int(compute_program, lod.first_meshlet, "u_first_meshlet");
+		load_uniform_int(compute_program, lod.meshlet_count, "u_meshlet_count");
+		load_uniform_int(compute_program, i, "u_draw");
+		load_uniform_int(compute_program, meshlet_draw.first_command, "u_first_command");
+		load_uniform_int(compute_program, meshlet_draw.instance_count, "u_instance_count");
+		load_uniform_int(compute_program, meshlet_draw.base_instance, "u_base_instance");
+		load_uniform_int(compute_program, renderable.mesh.base_vertex, "u_base_vertex");
+		load_uniform_int(compute_program, meshlet_draw.first_frustum, "u_first_frustum");
+		load_uniform_int(compute_program, meshlet_draw.frustum_count, "u_frustum_count");
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, renderable.mesh.meshlet_buffer);
+		glDispatchCompute((lod.meshlet_count + 63) / 64, 1, 1);
+	}
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+	return command_count;
+}
+
+void draw_meshlets(const meshlet_draw_type& meshlet_draw, const int draw_index, const GLuint vao, const GLenum index_type) {
+	//the bound indirect buffer has the commands, the bound parameter buffer has the number of commands per draw
+	auto max_count = renderables[meshlet_draw.renderable].mesh.lods[meshlet_draw.lod].meshlet_count;
+	glBindVertexArray(vao);
+	glMultiDrawElementsIndirectCount(GL_TRIANGLES, index_type, reinterpret_cast<void*>(meshlet_draw.first_command * sizeof(draw_elements_indirect_command_type)), draw_index * sizeof(GLuint), max_count, 0);
+}
+
+void draw_indirect_commands(const std::vector<mesh_type>& command_meshes) {
+	//consecutive commands with the same vao are one multi draw, they share the index type too, the shadow passes only fetch the positions
+	for(int begin = 0, end = 0; begin < command_meshes.size(); begin = end) {
+		while(end < command_meshes.size() && command_meshes[end].shadow_vao == command_meshes[begin].shadow_vao) {
+			end++;
+		}
+		glBindVertexArray(command_meshes[begin].shadow_vao);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, command_meshes[begin].index_type, reinterpret_cast<void*>(begin * sizeof(draw_elements_indirect_command_type)), end - begin, 0);
+	}
+}
+
+int select_lod(const mesh_type& mesh, const int current_lod, const float error_scale, const float allowed_error);
+
+float get_cascade_texel_size(const int layer) {
+	return 2.0f / (light.cascades[layer].projection[0][0] * get_rendered_resolution());
+}
+
+int get_cascade_shadow_lod(const renderable_type& renderable, const int layer) {
+	//a static caster's lod depends only on the cascade's texel size, not on the camera's distance
+	//so a cached layer stays valid until its projection changes, which invalidates it anyway
+	if(!renderable.is_static) {
+		return renderable.shadow_lod;
+	}
+	auto scale = glm::abs(renderable.scale);
+	auto error_scale = max(scale.x, max(scale.y, scale.z));
+	return select_lod(renderable.mesh, 0, error_scale, get_cascade_texel_size(layer) * lod_settings.shadow_texel_error);
+}
+
+void draw_scene_store(const GLuint vertex_program, const int first_range, const int last_range, const int layer = -1) {
+	//every instance of a resident mesh's asset is one instanced draw over the mesh's sorted instances, the vertex shader skips the ones placing another instance
+	//there's no culling, the camera draws lod 0, a cascade draws its static casters with the lod of the mesh's largest scale
+	auto& store = scene_store;
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, store.instance_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, store.index_buffer);
+	for(int i = 0; i < store.mesh_assets.size(); i++) {
+		auto& asset = asset_loader.mesh_assets[store.mesh_assets[i]];
+		auto count = get_scene_store_instance_count(i, first_range, last_range);
+		if(asset.state != ASSET_STATE_RESIDENT || count == 0) {
+			continue;
+		}
+		auto first = store.range_offsets[i * SCENE_STORE_RANGE_COUNT + first_range];
+		for(int j = 0; j < asset.instances.size(); j++) {
+			auto& mesh = asset.meshes[asset.instances[j].mesh];
+			auto lod = 0;
+			if(layer != -1 && first_range == SCENE_STORE_RANGE_STATIC_CASTER) {
+				lod = select_lod(mesh, 0, store.max_scales[i], get_cascade_texel_size(layer) * lod_settings.shadow_texel_error);
+			}
+			load_uniform_int(vertex_program, j, "u_mesh_instance");
+			load_uniform_mat(vertex_program, asset.instances[j].transform, "u_instance_transform");
+			load_uniform_mat(vertex_program, mesh.dequantization, "u_dequantization");
+			glBindVertexArray(layer == -1 ? mesh.vao : mesh.shadow_vao);
+			glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, mesh.lods[lod].index_count, mesh.index_type, reinterpret_cast<void*>(mesh.lods[lod].first_index * get_index_size(mesh.index_type)), count, mesh.base_vertex, first);
+		}
+	}
+}
+
+void render_scene_store_shadow_casters(const bool static_casters, const GLuint layer_mask) {
+	//only the cascades, the atlas, the cube maps and the virtual shadow map draw renderables
+	if(scene_store.instance_buffer == 0) {
+		return;
+	}
+	auto range = static_casters ? SCENE_STORE_RANGE_STATIC_CASTER : SCENE_STORE_RANGE_DYNAMIC_CASTER;
+	auto vertex_program = scene_store_shadow_pipeline.vertex_program;
+	glBindProgramPipeline(scene_store_shadow_pipeline.pipeline);
+	load_shadow_map_uniforms();
+	for(int layer = 0; layer < get_cascade_count(); layer++) {
+		if(layer_mask & (1u << layer)) {
+			load_uniform_int(vertex_program, layer, "u_layer");
+			draw_scene_store(vertex_program, range, range, layer);
+		}
+	}
+}
+
+void render_shadow_casters(const bool static_casters, const GLuint layer_mask) {
+	render_scene_store_shadow_casters(static_casters, layer_mask);
+	std::vector<glm::mat4> models;
+	for(auto& renderable : renderables) {
+		models.push_back(compute_model_matrix(renderable));
+	}
+	cull_shadow_casters(static_casters, layer_mask, models);
+
+	//every run of consecutive layers with the same lod is one instanced draw, the instance index selects the layer
+	auto order = get_shadow_casters_by_vao();
+	auto& culling = shadow_caster_culling;
+	std::vector<shadow_draw_type> draws;
+	std::vector<draw_elements_indirect_command_type> commands;
+	std::vector<mesh_type> command_meshes;
+	std::vector<meshlet_draw_type> meshlet_draws;
+	for(auto renderable_index : order) {
+		auto mask = culling.layer_masks[renderable_index];
+		for(int layer = 0; mask >> layer != 0; layer++) {
+			if(!(mask & (1u << layer))) {
+				continue;
+			}
+			auto& renderable = renderables[renderable_index];
+			auto lod = get_cascade_shadow_lod(renderable, layer);
+			auto first_layer = layer;
+			while((mask & (1u << (layer + 1))) && get_cascade_shadow_lod(renderable, layer + 1) == lod) {
+				layer++;
+			}
+			shadow_draw_type draw;
+			draw.model = models[renderable_index];
+			draw.first_layer = first_layer;
+			draws.push_back(draw);
+			if(has_meshlets(renderable.mesh, lod)) {
+				meshlet_draw_type meshlet_draw;
+				meshlet_draw.renderable = renderable_index;
+				meshlet_draw.lod = lod;
+				meshlet_draw.first_frustum = first_layer;
+				meshlet_draw.frustum_count = layer - first_layer + 1;
+				meshlet_draw.instance_count = layer - first_layer + 1;
+				meshlet_draw.base_instance = draws.size() - 1;
+				meshlet_draws.push_back(meshlet_draw);
+				continue;
+			}
+			draw_elements_indirect_command_type command;
+			command.count = renderable.mesh.lods[lod].index_count;
+			command.instance_count = layer - first_layer + 1;
+			command.first_index = renderable.mesh.lods[lod].first_index;
+			command.base_vertex = renderable.mesh.base_vertex;
+			command.base_instance = draws.size() - 1;
+			commands.push_back(command);
+			command_meshes.push_back(renderable.mesh);
+		}
+	}
+	if(draws.empty()) {
+		return;
+	}
+	upload_dynamic_buffer(culling.draw_buffer, draws.data(), draws.size() * sizeof(shadow_draw_type), "<shadow draw buffer>");
+	upload_dynamic_buffer(culling.indirect_buffer, commands.data(), commands.size() * sizeof(draw_elements_indirect_command_type), "<shadow indirect buffer>");
+
+	//the meshlets are culled against the cascades they're drawn into, the light's direction is the same for all of them
+	std::vector<glm::vec4> frustum_planes;
+	for(int i = 0; i < get_cascade_count(); i++) {
+		get_frustum_planes(light.cascades[i].projection * light.cascades[i].view, false, frustum_planes);
+	}
+	meshlet_culling.shadow_meshlet_count += cull_meshlets(meshlet_draws, frustum_planes, true, glm::vec3(0.0), light.direction, meshlet_culling.shadow_buffers);
+
+	glBindProgramPipeline(shadow_map_pipeline.pipeline);
+	load_shadow_map_uniforms();
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, culling.draw_buffer.buffer);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, culling.indirect_buffer.buffer);
+	draw_indirect_commands(command_meshes);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, meshlet_culling.shadow_buffers.command_buffer.buffer);
+	glBindBuffer(GL_PARAMETER_BUFFER, meshlet_culling.shadow_buffers.count_buffer.buffer);
+	for(int i = 0; i < meshlet_draws.size(); i++) {
+		auto& mesh = renderables[meshlet_draws[i].renderable].mesh;
+		draw_meshlets(meshlet_draws[i], i, mesh.shadow_vao, mesh.index_type);
+	}
+	glBindBuffer(GL_PARAMETER_BUFFER, 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void blur_shadow_map(const GLuint layer_mask) {
+	//the intermediate texture is only taken from the pool for the blur
+	auto key = get_blur_render_target_key();
+	auto blur_texture = acquire_render_target(key.size, key.layers, key.format, false, "<blur texture>");
+	glBindFramebuffer(GL_FRAMEBUFFER, blur_fbo);
+	glBindProgramPipeline(gaussian_blur_pipeline.pipeline);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_CULL_FACE);
+	glBindVertexArray(quad_mesh.vao);
+
+	for(int i = 0; i < get_cascade_count(); i++) {
+		if(!(layer_mask & (1u << i))) {
+			continue;
+		}
+		glNamedFramebufferTextureLayer(blur_fbo, GL_COLOR_ATTACHMENT0, blur_texture, 0, 0);
+		load_gaussian_blur_uniforms(true, shadow_color_texture, i, i);
+		glDrawElements(GL_TRIANGLES, quad_mesh.index_count, quad_mesh.index_type, 0);
+
+		glNamedFramebufferTextureLayer(blur_fbo, GL_COLOR_ATTACHMENT0, shadow_color_texture, 0, i);
+		load_gaussian_blur_uniforms(false, blur_texture, 0, i);
+		glDrawElements(GL_TRIANGLES, quad_mesh.index_count, quad_mesh.index_type, 0);
+	}
+	glNamedFramebufferTexture(blur_fbo, GL_COLOR_ATTACHMENT0, 0, 0);
+	release_render_target(blur_texture);
+
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_CULL_FACE);
+}
+
+shadow_cache_key_type get_shadow_cache_key(const cascade_type& cascade) {
+	shadow_cache_key_type key;
+	key.view = cascade.view;
+	if(cascade.scrollable) {
+		//the light-space x and y translation is stored as the texel origin, so moving the view only scrolls the map
+		key.view[3].x = 0.0;
+		key.view[3].y = 0.0;
+		key.texel_origin = cascade.texel_origin;
+	}
+	key.projection = cascade.projection;
+	key.resolution = get_rendered_resolution();
+	key.mode = shadow_map_settings.mode;
+	key.static_geometry_version = shadow_cache.static_geometry_version;
+	return key;
+}
+
+bool operator==(const shadow_cache_key_type& a, const shadow_cache_key_type& b) {
+	return a.view == b.view && a.projection == b.projection && a.resolution == b.resolution && a.mode == b.mode && a.static_geometry_version == b.static_geometry_version && a.texel_origin == b.texel_origin;
+}
+
+bool is_scroll_only(const shadow_cache_key_type& a, const shadow_cache_key_type& b) {
+	auto offset = glm::abs(a.texel_origin - b.texel_origin);
+	auto b_at_a = b;
+	b_at_a.texel_origin = a.texel_origin;
+	return a == b_at_a && offset.x < a.resolution && offset.y < a.resolution;
+}
+
+void clear_shadow_map_region(const GLuint color_texture, const GLuint depth_texture, const int layer, const glm::ivec2 position, const glm::ivec2 size) {
+	//glClear would clear every layer of the layered framebuffer
+	const float clear_color[] = {1.0, 1.0, 1.0, 1.0};
+	const float clear_depth = 1.0;
+	glClearTexSubImage(color_texture, 0, position.x, position.y, layer, size.x, size.y, 1, GL_RGBA, GL_FLOAT, clear_color);
+	glClearTexSubImage(depth_texture, 0, position.x, position.y, layer, size.x, size.y, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &clear_depth);
+}
+
+void clear_static_shadow_map_region(const int layer, const glm::ivec2 position, const glm::ivec2 size) {
+	clear_shadow_map_region(static_shadow_color_texture, static_shadow_depth_texture, layer, position, size);
+}
+
+void render_static_shadow_map_layers(const GLuint layer_mask) {
+	auto resolution = get_rendered_resolution();
+	for(int i = 0; i < get_cascade_count(); i++) {
+		if(layer_mask & (1u << i)) {
+			clear_static_shadow_map_region(i, glm::ivec2(0), glm::ivec2(resolution));
+			shadow_cache.rasterized_texel_count += resolution * resolution;
+		}
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, static_shadow_map_fbo);
+	glViewport(0, 0, resolution, resolution);
+	render_shadow_casters(true, layer_mask);
+}
+
+void render_static_shadow_map_region(const int layer, const glm::ivec2 position, const glm::ivec2 size) {
+	clear_static_shadow_map_region(layer, position, size);
+	glScissor(position.x, position.y, size.x, size.y);
+	render_shadow_casters(true, 1u << layer);
+	shadow_cache.rasterized_texel_count += size.x * size.y;
+}
+
+void scroll_static_shadow_map(const int layer, const glm::ivec2 offset) {
+	//the texel at i in the new map was at i + offset in the old one, the rest is newly exposed
+	//the regions can overlap, so the shifted texels take a round trip through the working map, which is overwritten later anyway
+	auto resolution = get_rendered_resolution();
+	auto size = glm::ivec2(resolution) - glm::abs(offset);
+	auto source = glm::max(offset, glm::ivec2(0));
+	auto destination = glm::max(-offset, glm::ivec2(0));
+	glCopyImageSubData(static_shadow_color_texture, GL_TEXTURE_2D_ARRAY, 0, source.x, source.y, layer, shadow_color_texture, GL_TEXTURE_2D_ARRAY, 0, destination.x, destination.y, layer, size.x, size.y, 1);
+	glCopyImageSubData(static_shadow_depth_texture, GL_TEXTURE_2D_ARRAY, 0, source.x, source.y, layer, shadow_depth_texture, GL_TEXTURE_2D_ARRAY, 0, destination.x, destination.y, layer, size.x, size.y, 1);
+	glCopyImageSubData(shadow_color_texture, GL_TEXTURE_2D_ARRAY, 0, destination.x, destination.y, layer, static_shadow_color_texture, GL_TEXTURE_2D_ARRAY, 0, destination.x, destination.y, layer, size.x, size.y, 1);
+	glCopyImageSubData(shadow_depth_texture, GL_TEXTURE_2D_ARRAY, 0, destination.x, destination.y, layer, static_shadow_depth_texture, GL_TEXTURE_2D_ARRAY, 0, destination.x, destination.y, layer, size.x, size.y, 1);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, static_shadow_map_fbo);
+	glViewport(0, 0, resolution, resolution);
+	glEnable(GL_SCISSOR_TEST);
+	if(offset.x != 0) {
+		auto x = offset.x > 0 ? resolution - offset.x : 0;
+		render_static_shadow_map_region(layer, glm::ivec2(x, 0), glm::ivec2(glm::abs(offset.x), resolution));
+	}
+	if(offset.y != 0) {
+		auto y = offset.y > 0 ? resolution - offset.y : 0;
+		render_static_shadow_map_region(layer, glm::ivec2(0, y), glm::ivec2(resolution, glm::abs(offset.y)));
+	}
+	glDisable(GL_SCISSOR_TEST);
+}
+
+shadow_composite_key_type get_shadow_composite_key() {
+	shadow_composite_key_type key;
+	if(shadow_map_settings.mode == MODE_VSM) {
+		key.light_size = light.size;
+		key.rotate_samples = shadow_map_settings.rotate_samples;
+		key.scale = shadow_map_settings.scale;
+		key.gaussian_kernel_size = shadow_map_settings.gaussian_kernel_size;
+	}
+	return key;
+}
 
-	auto vao = create_vao("<quad>");
-	create_and_attach_vbo(vao, 0, vertices, "<quad vertex position>");
-	create_and_attach_vbo(vao, 1, normals, "<quad vertex normals>");
-	create_and_attach_vbo(vao, 2, uvs, "<quad vertex uvs>", 2);
-	create_and_attach_ebo(vao, indices, "<quad indices>");
+bool operator==(const shadow_composite_key_type& a, const shadow_composite_key_type& b) {
+	return a.light_size == b.light_size && a.rotate_samples == b.rotate_samples && a.scale == b.scale && a.gaussian_kernel_size == b.gaussian_kernel_size;
+}
 
-	mesh_type quad;
-	quad.vao = vao;
-	quad.index_count = 6;
-	return quad;
+void render_shadow_map_layers() {
+	auto resolution = get_rendered_resolution();
+	auto cascade_count = get_cascade_count();
+	auto update_layer_mask = shadow_update_scheduler.update_layer_mask;
+	if(update_layer_mask == 0) {
+		return;
+	}
+	if(!shadow_map_settings.cache_static_casters) {
+		for(int i = 0; i < cascade_count; i++) {
+			if(update_layer_mask & (1u << i)) {
+				clear_shadow_map_region(shadow_color_texture, shadow_depth_texture, i, glm::ivec2(0), glm::ivec2(resolution));
+			}
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, shadow_map_fbo);
+		glViewport(0, 0, resolution, resolution);
+		render_shadow_casters(true, update_layer_mask);
+		render_shadow_casters(false, update_layer_mask);
+		if(shadow_map_settings.mode == MODE_VSM) {
+			blur_shadow_map(update_layer_mask);
+		}
+		return;
+	}
+
+	GLuint dirty_layer_mask = 0;
+	auto static_changed = false;
+	for(int i = 0; i < cascade_count; i++) {
+		if(!(update_layer_mask & (1u << i))) {
+			continue;
+		}
+		auto& layer = shadow_cache.layers[i];
+		auto key = get_shadow_cache_key(light.cascades[i]);
+		shadow_cache.frame_count++;
+		shadow_cache.texel_count += resolution * resolution;
+		if(layer.valid && layer.key == key) {
+			shadow_cache.hit_count++;
+			continue;
+		}
+		if(layer.valid && is_scroll_only(key, layer.key)) {
+			scroll_static_shadow_map(i, key.texel_origin - layer.key.texel_origin);
+		} else {
+			dirty_layer_mask |= 1u << i;
+		}
+		layer.key = key;
+		layer.valid = true;
+		static_changed = true;
+	}
+	if(dirty_layer_mask != 0) {
+		render_static_shadow_map_layers(dirty_layer_mask);
+	}
+
+	auto has_dynamic_casters = std::any_of(renderables.begin(), renderables.end(), [](const renderable_type& renderable) {
+		return !renderable.is_static;
+	});
+	for(int i = 0; i < scene_store.mesh_assets.size(); i++) {
+		has_dynamic_casters |= get_scene_store_instance_count(i, SCENE_STORE_RANGE_DYNAMIC_CASTER, SCENE_STORE_RANGE_DYNAMIC_CASTER) > 0;
+	}
+	auto composite_key = get_shadow_composite_key();
+	if(!static_changed && !has_dynamic_casters && shadow_cache.composite_key == composite_key) {
+		return;
+	}
+	shadow_cache.composite_key = composite_key;
+	for(int i = 0; i < cascade_count; i++) {
+		if(update_layer_mask & (1u << i)) {
+			glCopyImageSubData(static_shadow_color_texture, GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, shadow_color_texture, GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, resolution, resolution, 1);
+			glCopyImageSubData(static_shadow_depth_texture, GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, shadow_depth_texture, GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, resolution, resolution, 1);
+		}
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, shadow_map_fbo);
+	glViewport(0, 0, resolution, resolution);
+	render_shadow_casters(false, update_layer_mask);
+	if(shadow_map_settings.mode == MODE_VSM) {
+		blur_shadow_map(update_layer_mask);
+	}
 }
 
-mesh_type create_mesh_from_file(const std::string& path) {
-	Assimp::Importer importer;
-	auto scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
-	if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
-		std::cout << "ASSIMP, ERROR, HIGH, " << path << ": " << importer.GetErrorString() << std::endl;
-		exit(1);
+long long get_virtual_page_key(const glm::ivec2 page) {
+	return (static_cast<long long>(page.x) << 32) | static_cast<GLuint>(page.y);
+}
+
+glm::ivec2 get_physical_page_position(const int physical_page) {
+	return glm::ivec2(physical_page % PHYSICAL_PAGE_COUNT, physical_page / PHYSICAL_PAGE_COUNT);
+}
+
+bool is_inside_virtual_map(const glm::ivec2 page) {
+	auto local_page = page - virtual_shadow_map.page_origin;
+	return glm::all(glm::greaterThanEqual(local_page, glm::ivec2(0))) && glm::all(glm::lessThan(local_page, glm::ivec2(VIRTUAL_PAGE_COUNT)));
+}
+
+bool get_virtual_page_range(const glm::mat4& model, const mesh_type& mesh, glm::ivec2& min_page, glm::ivec2& max_page) {
+	auto& cascade = light.cascades[0];
+	glm::vec4 corner_points[8];
+	get_clip_space_aabb_corner_points(cascade.projection * cascade.view * model, mesh, corner_points);
+	if(!is_shadow_caster_visible(corner_points)) {
+		return false;
+	}
+	auto min_uv = glm::vec2(INFINITY);
+	auto max_uv = glm::vec2(-INFINITY);
+	for(auto& corner_point : corner_points) {
+		auto uv = glm::vec2(corner_point) / corner_point.w * 0.5f + 0.5f;
+		min_uv = glm::min(min_uv, uv);
+		max_uv = glm::max(max_uv, uv);
+	}
+	auto last_page = glm::ivec2(VIRTUAL_PAGE_COUNT - 1);
+	min_page = virtual_shadow_map.page_origin + glm::clamp(glm::ivec2(glm::floor(min_uv * static_cast<float>(VIRTUAL_PAGE_COUNT))), glm::ivec2(0), last_page);
+	max_page = virtual_shadow_map.page_origin + glm::clamp(glm::ivec2(glm::floor(max_uv * static_cast<float>(VIRTUAL_PAGE_COUNT))), glm::ivec2(0), last_page);
+	return true;
+}
+
+void release_virtual_page(const long long key) {
+	auto& virtual_map = virtual_shadow_map;
+	auto iterator = virtual_map.resident_pages.find(key);
+	if(iterator != virtual_map.resident_pages.end()) {
+		virtual_map.physical_pages[iterator->second].resident = false;
+		virtual_map.resident_pages.erase(iterator);
 	}
+}
 
-	auto ai_meshes = scene->mMeshes;
-	auto ai_mesh = ai_meshes[0];
-	std::vector<float> vertices;
-	std::vector<float> normals;
-	std::vector<GLuint> indices;
-	for(unsigned int i = 0; i < ai_mesh->mNumVertices; i++) {
-		auto vertex = ai_mesh->mVertices[i];
-		vertices.push_back(vertex.x);
-		vertices.push_back(vertex.y);
-		vertices.push_back(vertex.z);
-		if(ai_mesh->HasNormals()) {
-			auto normal = ai_mesh->mNormals[i];
-			normals.push_back(normal.x);
-			normals.push_back(normal.y);
-			normals.push_back(normal.z);
+int allocate_physical_page() {
+	//a free page, or the least recently used one that isn't needed in this frame
+	auto& virtual_map = virtual_shadow_map;
+	auto result = -1;
+	for(int i = 0; i < virtual_map.physical_pages.size(); i++) {
+		auto& page = virtual_map.physical_pages[i];
+		if(!page.resident) {
+			return i;
+		}
+		if(page.last_used_frame < virtual_map.frame && (result == -1 || page.last_used_frame < virtual_map.physical_pages[result].last_used_frame)) {
+			result = i;
 		}
 	}
-	for(int i = 0; i < ai_mesh->mNumFaces; i++) {
-		auto face = ai_mesh->mFaces[i];
-		for(int j = 0; j < face.mNumIndices; j++) {
-			indices.push_back(face.mIndices[j]);
+	if(result != -1) {
+		release_virtual_page(get_virtual_page_key(virtual_map.physical_pages[result].virtual_page));
+	}
+	return result;
+}
+
+std::vector<int> update_virtual_pages(const std::vector<glm::mat4>& models) {
+	auto& virtual_map = virtual_shadow_map;
+	auto& cascade = light.cascades[0];
+	virtual_map.frame++;
+	read_back_virtual_page_requests();
+	auto extent = shadow_map_settings.virtual_shadow_map_extent;
+	if(!shadow_map_settings.cache_static_casters || virtual_map.view != cascade.view || virtual_map.extent != extent || virtual_map.static_geometry_version != shadow_cache.static_geometry_version) {
+		release_virtual_pages();
+		virtual_map.view = cascade.view;
+		virtual_map.extent = extent;
+		virtual_map.static_geometry_version = shadow_cache.static_geometry_version;
+	}
+
+	//pages under dynamic casters are rendered again, and so are the ones they have just left
+	std::vector<long long> dynamic_pages;
+	for(int i = 0; i < renderables.size(); i++) {
+		glm::ivec2 min_page;
+		glm::ivec2 max_page;
+		if(renderables[i].is_static || !renderables[i].casts_shadows || !get_virtual_page_range(models[i], renderables[i].mesh, min_page, max_page)) {
+			continue;
+		}
+		for(int y = min_page.y; y <= max_page.y; y++) {
+			for(int x = min_page.x; x <= max_page.x; x++) {
+				dynamic_pages.push_back(get_virtual_page_key(glm::ivec2(x, y)));
+			}
+		}
+	}
+	for(auto key : virtual_map.dynamic_pages) {
+		release_virtual_page(key);
+	}
+	for(auto key : dynamic_pages) {
+		release_virtual_page(key);
+	}
+	virtual_map.dynamic_pages = dynamic_pages;
+
+	//the resident pages are touched first, so making room for the missing ones doesn't evict them
+	std::vector<glm::ivec2> missing_pages;
+	for(auto& page : virtual_map.requested_pages) {
+		if(!is_inside_virtual_map(page)) {
+			continue;
+		}
+		auto iterator = virtual_map.resident_pages.find(get_virtual_page_key(page));
+		if(iterator != virtual_map.resident_pages.end()) {
+			virtual_map.physical_pages[iterator->second].last_used_frame = virtual_map.frame;
+		} else {
+			missing_pages.push_back(page);
 		}
 	}
+	std::vector<int> dirty_pages;
+	virtual_map.missing_page_count = 0;
+	for(auto& page : missing_pages) {
+		auto physical_page = allocate_physical_page();
+		if(physical_page == -1) {
+			virtual_map.missing_page_count++;
+			continue;
+		}
+		auto& physical = virtual_map.physical_pages[physical_page];
+		physical.resident = true;
+		physical.virtual_page = page;
+		physical.last_used_frame = virtual_map.frame;
+		virtual_map.resident_pages[get_virtual_page_key(page)] = physical_page;
+		dirty_pages.push_back(physical_page);
+	}
 
-	auto vao = create_vao("<" + path + ">");
-	create_and_attach_vbo(vao, 0, vertices, "<" + path + " vertex positions>");
-	create_and_attach_vbo(vao, 1, normals, "<" + path + " vertex normals>");
-	create_and_attach_ebo(vao, indices, "<" + path + " indices>");
+	//every resident page inside the map is mapped, not just the requested ones
+	std::fill(virtual_map.page_table.begin(), virtual_map.page_table.end(), INVALID_PAGE);
+	for(auto& entry : virtual_map.resident_pages) {
+		auto page = virtual_map.physical_pages[entry.second].virtual_page;
+		if(!is_inside_virtual_map(page)) {
+			continue;
+		}
+		auto local_page = page - virtual_map.page_origin;
+		auto position = get_physical_page_position(entry.second);
+		virtual_map.page_table[local_page.y * VIRTUAL_PAGE_COUNT + local_page.x] = position.x | (position.y << 16);
+	}
+	glTextureSubImage2D(virtual_map.page_table_texture, 0, 0, 0, VIRTUAL_PAGE_COUNT, VIRTUAL_PAGE_COUNT, GL_RED_INTEGER, GL_UNSIGNED_INT, virtual_map.page_table.data());
 
-	mesh_type mesh;
-	mesh.vao = vao;
-	mesh.index_count = indices.size();
-	return mesh;
+	virtual_map.requested_page_count = virtual_map.requested_pages.size();
+	virtual_map.rendered_page_count = dirty_pages.size();
+	virtual_map.resident_page_count = virtual_map.resident_pages.size();
+	return dirty_pages;
 }
 
-void create_renderables() {
-	auto box_mesh = create_mesh_from_file("res/mesh/box.glb");
-	renderable_type box;
-	box.mesh = box_mesh;
-	box.position = glm::vec3(0.0, 0.0, -30.0);
-	renderables.push_back(box);
+void render_virtual_shadow_map() {
+	auto& virtual_map = virtual_shadow_map;
+	std::vector<glm::mat4> models;
+	for(auto& renderable : renderables) {
+		models.push_back(compute_model_matrix(renderable));
+	}
+	auto dirty_pages = update_virtual_pages(models);
+	if(dirty_pages.empty()) {
+		return;
+	}
+	const float clear_depth = 1.0;
+	for(auto physical_page : dirty_pages) {
+		auto position = get_physical_page_position(physical_page) * VIRTUAL_PAGE_SIZE;
+		glClearTexSubImage(virtual_map.physical_texture, 0, position.x, position.y, 0, VIRTUAL_PAGE_SIZE, VIRTUAL_PAGE_SIZE, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &clear_depth);
+	}
 
-	renderable_type helmet;
-	helmet.mesh = create_mesh_from_file("res/mesh/DamagedHelmet.glb");
-	helmet.position = glm::vec3(0.0, 10.0, -50.0);
-	helmet.scale = glm::vec3(10.0);
-	helmet.rotation = glm::angleAxis(glm::radians(-90.0f), glm::vec3(0.0, 1.0, 0.0)) * glm::angleAxis(glm::radians(90.0f), glm::vec3(1.0, 0.0, 0.0));
-	renderables.push_back(helmet);
+	//one draw per caster and overlapped page, the vertex shader clips the caster to its page
+	std::vector<virtual_page_draw_type> draws;
+	std::vector<draw_elements_indirect_command_type> commands;
+	std::vector<mesh_type> command_meshes;
+	for(auto renderable_index : get_shadow_casters_by_vao()) {
+		auto& renderable = renderables[renderable_index];
+		glm::ivec2 min_page;
+		glm::ivec2 max_page;
+		if(!get_virtual_page_range(models[renderable_index], renderable.mesh, min_page, max_page)) {
+			continue;
+		}
+		auto draw_count = draws.size();
+		for(auto physical_page : dirty_pages) {
+			auto page = virtual_map.physical_pages[physical_page].virtual_page;
+			if(glm::any(glm::lessThan(page, min_page)) || glm::any(glm::greaterThan(page, max_page))) {
+				continue;
+			}
+			virtual_page_draw_type draw;
+			draw.model = models[renderable_index];
+			draw.virtual_page = page - virtual_map.page_origin;
+			draw.physical_page = get_physical_page_position(physical_page);
+			draws.push_back(draw);
+			draw_elements_indirect_command_type command;
+			command.count = renderable.mesh.lods[renderable.shadow_lod].index_count;
+			command.instance_count = 1;
+			command.first_index = renderable.mesh.lods[renderable.shadow_lod].first_index;
+			command.base_vertex = renderable.mesh.base_vertex;
+			command.base_instance = draws.size() - 1;
+			commands.push_back(command);
+			command_meshes.push_back(renderable.mesh);
+		}
+		if(draws.size() > draw_count) {
+			shadow_caster_culling.caster_counts[0]++;
+		}
+	}
+	if(commands.empty()) {
+		return;
+	}
+	upload_dynamic_buffer(virtual_map.draw_buffer, draws.data(), draws.size() * sizeof(virtual_page_draw_type), "<virtual shadow map draw buffer>");
+	upload_dynamic_buffer(virtual_map.indirect_buffer, commands.data(), commands.size() * sizeof(draw_elements_indirect_command_type), "<virtual shadow map indirect buffer>");
 
-	renderable_type camera;
-	camera.mesh = create_mesh_from_file("res/mesh/AntiqueCamera.glb");
-	camera.position = glm::vec3(0.0, 10.0, -65.0);
-	renderables.push_back(camera);
+	auto& cascade = light.cascades[0];
+	auto vertex_program = virtual_shadow_map_pipeline.vertex_program;
+	load_uniform_mat(vertex_program, cascade.projection * cascade.view, "u_view_projection");
+	load_uniform_vec4(vertex_program, get_depth_row(cascade.view, cascade.near_plane, cascade.far_plane), "u_depth_row");
+	load_uniform_int(vertex_program, VIRTUAL_PAGE_COUNT, "u_page_count");
+	load_uniform_int(vertex_program, PHYSICAL_PAGE_COUNT, "u_physical_page_count");
+	glBindFramebuffer(GL_FRAMEBUFFER, virtual_map.fbo);
+	glViewport(0, 0, PHYSICAL_PAGE_COUNT * VIRTUAL_PAGE_SIZE, PHYSICAL_PAGE_COUNT * VIRTUAL_PAGE_SIZE);
+	for(int i = 0; i < 4; i++) {
+		glEnable(GL_CLIP_DISTANCE0 + i);
+	}
+	glBindProgramPipeline(virtual_shadow_map_pipeline.pipeline);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, virtual_map.draw_buffer.buffer);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, virtual_map.indirect_buffer.buffer);
+	draw_indirect_commands(command_meshes);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	for(int i = 0; i < 4; i++) {
+		glDisable(GL_CLIP_DISTANCE0 + i);
+	}
+}
 
-	renderable_type camera_2;
-	camera_2.mesh = camera.mesh;
-	camera_2.position = glm::vec3(-10.0, 0.0, -70.0);
-	renderables.push_back(camera_2);
+void create_shadowed_lights() {
+	shadowed_light_type helmet_spot_light;
+	helmet_spot_light.name = "helmet spot";
+	helmet_spot_light.position = glm::vec3(15.0, 35.0, -40.0);
+	helmet_spot_light.direction = glm::normalize(glm::vec3(0.0, 10.0, -50.0) - helmet_spot_light.position);
+	helmet_spot_light.color = glm::vec3(0.8, 0.6, 0.4);
+	shadowed_lights.push_back(helmet_spot_light);
 
-	renderable_type camera_3;
-	camera_3.mesh = camera.mesh;
-	camera_3.position = glm::vec3(-19.0, -9.0, -75.0);
-	renderables.push_back(camera_3);
+	shadowed_light_type camera_spot_light;
+	camera_spot_light.name = "camera spot";
+	camera_spot_light.position = glm::vec3(-30.0, 30.0, -55.0);
+	camera_spot_light.direction = glm::normalize(glm::vec3(-10.0, 0.0, -70.0) - camera_spot_light.position);
+	camera_spot_light.color = glm::vec3(0.4, 0.6, 0.8);
+	camera_spot_light.angle = 25.0;
+	camera_spot_light.range = 60.0;
+	shadowed_lights.push_back(camera_spot_light);
 
-	renderable_type quad;
-	quad_mesh = create_quad();
-	quad.mesh = quad_mesh;
-	quad.rotation = glm::angleAxis(glm::radians(-90.0f), glm::vec3(1.0, 0.0, 0.0));
-	quad.scale = glm::vec3(500.0);
-	quad.diffuse_color = glm::vec3(1.0, 0.7, 0.4);
-	renderables.push_back(quad);
+	shadowed_light_type directional_light;
+	directional_light.name = "directional";
+	directional_light.type = LIGHT_TYPE_DIRECTIONAL;
+	directional_light.position = glm::vec3(0.0, 0.0, -60.0);
+	directional_light.direction = glm::normalize(glm::vec3(1.0, -1.0, -0.3));
+	directional_light.color = glm::vec3(0.2, 0.2, 0.3);
+	directional_light.range = 40.0;
+	shadowed_lights.push_back(directional_light);
+
+	shadowed_light_type point_light;
+	point_light.name = "point";
+	point_light.type = LIGHT_TYPE_POINT;
+	point_light.position = glm::vec3(-5.0, 12.0, -62.0);
+	point_light.color = glm::vec3(1.0, 0.7, 0.3);
+	point_light.range = 35.0;
+	shadowed_lights.push_back(point_light);
 }
 
-GLuint create_fbo(const std::string& name) {
-	GLuint fbo;
-	glCreateFramebuffers(1, &fbo);
-	glObjectLabel(GL_FRAMEBUFFER, fbo, name.length(), name.c_str());
-	return fbo;
+void create_shadow_atlas() {
+	shadow_atlas.fbo = create_fbo("<shadow atlas fbo>");
+	glNamedFramebufferDrawBuffer(shadow_atlas.fbo, GL_NONE);
+	shadow_atlas.depth_texture = create_and_attach_texture(shadow_atlas.fbo, GL_DEPTH_ATTACHMENT, glm::ivec2(SHADOW_ATLAS_SIZE), GL_DEPTH_COMPONENT32F, "<shadow atlas depth texture>", false);
+	check_fbo(shadow_atlas.fbo);
+	shadow_atlas.nodes.resize(SHADOW_ATLAS_SIZE);
+	stbrp_init_target(&shadow_atlas.context, SHADOW_ATLAS_SIZE, SHADOW_ATLAS_SIZE, shadow_atlas.nodes.data(), shadow_atlas.nodes.size());
 }
 
-GLuint create_and_attach_texture(const GLuint fbo, const GLenum attachment, const glm::ivec2 size, const GLenum internal_format, const std::string& name, const bool border) {
-	GLuint texture;
-	glCreateTextures(GL_TEXTURE_2D, 1, &texture);
-	glObjectLabel(GL_TEXTURE, texture, name.length(), name.c_str());
-	glTextureStorage2D(texture, 1, internal_format, size.x, size.y);
-	if(border) {
-		glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-		glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-		auto border_color = glm::vec4(1.0);
-		glTextureParameterfv(texture, GL_TEXTURE_BORDER_COLOR, &border_color.x);
+void create_point_shadow_maps() {
+	auto& maps = point_shadow_maps;
+	maps.fbo = create_fbo("<point shadow map fbo>");
+	glNamedFramebufferDrawBuffer(maps.fbo, GL_NONE);
+	glCreateTextures(GL_TEXTURE_CUBE_MAP_ARRAY, 1, &maps.depth_texture);
+	glTextureStorage3D(maps.depth_texture, 1, GL_DEPTH_COMPONENT32F, POINT_SHADOW_MAP_RESOLUTION, POINT_SHADOW_MAP_RESOLUTION, 6 * POINT_SHADOW_MAP_COUNT);
+	auto size = static_cast<GLsizeiptr>(POINT_SHADOW_MAP_RESOLUTION) * POINT_SHADOW_MAP_RESOLUTION * 6 * POINT_SHADOW_MAP_COUNT * get_texel_size(GL_DEPTH_COMPONENT32F);
+	register_gpu_resource(GL_TEXTURE, maps.depth_texture, "<point shadow map depth texture>", GPU_CATEGORY_SHADOW_TARGETS, GL_DEPTH_COMPONENT32F, "depth attachment", size);
+	glTextureParameteri(maps.depth_texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(maps.depth_texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	//the whole array is attached, so the framebuffer is layered and the geometry shader selects the face
+	glNamedFramebufferTexture(maps.fbo, GL_DEPTH_ATTACHMENT, maps.depth_texture, 0);
+	check_fbo(maps.fbo);
+}
+
+void compute_shadowed_light_matrices(shadowed_light_type& shadowed_light) {
+	auto up = glm::abs(shadowed_light.direction.y) > 0.99f ? glm::vec3(1.0, 0.0, 0.0) : glm::vec3(0.0, 1.0, 0.0);
+	if(shadowed_light.type == LIGHT_TYPE_SPOT) {
+		shadowed_light.view = glm::lookAt(shadowed_light.position, shadowed_light.position + shadowed_light.direction, up);
+		shadowed_light.near_plane = 0.5;
+		shadowed_light.far_plane = shadowed_light.range;
+		shadowed_light.projection = glm::perspective(glm::radians(2.0f * shadowed_light.angle), 1.0f, shadowed_light.near_plane, shadowed_light.far_plane);
+	} else if(shadowed_light.type == LIGHT_TYPE_POINT) {
+		//the faces' views are made when the cube is rendered, they share this projection
+		shadowed_light.view = glm::translate(glm::mat4(1.0), -shadowed_light.position);
+		shadowed_light.near_plane = 0.1f;
+		shadowed_light.far_plane = shadowed_light.range;
+		shadowed_light.projection = glm::perspective(glm::radians(90.0f), 1.0f, shadowed_light.near_plane, shadowed_light.far_plane);
 	} else {
-		glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		auto eye = shadowed_light.position - shadowed_light.direction * shadowed_light.range;
+		shadowed_light.view = glm::lookAt(eye, eye + shadowed_light.direction, up);
+		shadowed_light.near_plane = 0.0;
+		shadowed_light.far_plane = 2.0f * shadowed_light.range;
+		shadowed_light.projection = glm::ortho(-shadowed_light.range, shadowed_light.range, -shadowed_light.range, shadowed_light.range, shadowed_light.near_plane, shadowed_light.far_plane);
 	}
-	glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glNamedFramebufferTexture(fbo, attachment, texture, 0);
-	return texture;
 }
 
-std::string get_fbo_error(const GLenum type) {
-	switch(type) {
-		case GL_FRAMEBUFFER_UNDEFINED: return "FRAMEBUFFER_UNDEFINED";
-		case GL_FRAMEBUFFER_INCOMPLETE_ATTACHMENT: return "FRAMEBUFFER_INCOMPLETE_ATTACHMENT";
-		case GL_FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT: return "FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT";
-		case GL_FRAMEBUFFER_INCOMPLETE_DRAW_BUFFER: return "FRAMEBUFFER_INCOMPLETE_DRAW_BUFFER";
-		case GL_FRAMEBUFFER_INCOMPLETE_READ_BUFFER: return "FRAMEBUFFER_INCOMPLETE_READ_BUFFER";
-		case GL_FRAMEBUFFER_UNSUPPORTED: return "FRAMEBUFFER_UNSUPPORTED";
-		case GL_FRAMEBUFFER_INCOMPLETE_MULTISAMPLE: return "FRAMEBUFFER_INCOMPLETE_MULTISAMPLE";
-		case GL_FRAMEBUFFER_INCOMPLETE_LAYER_TARGETS: return "FRAMEBUFFER_INCOMPLETE_LAYER_TARGETS";
-		default: return "UNKNOWN";
+bool is_sphere_visible(const glm::mat4& view_projection, const glm::vec3 center, const float radius) {
+	//the frustum planes are combinations of the matrix's rows
+	auto transposed = glm::transpose(view_projection);
+	for(int i = 0; i < 6; i++) {
+		auto plane = transposed[3] + (i % 2 == 0 ? 1.0f : -1.0f) * transposed[i / 2];
+		if(glm::dot(glm::vec3(plane), center) + plane.w < -radius * glm::length(glm::vec3(plane))) {
+			return false;
+		}
 	}
+	return true;
 }
 
-void create_render_targets() {
-	glDeleteTextures(1, &shadow_color_texture);
-	glDeleteTextures(1, &shadow_color_texture_2);
-	glDeleteTextures(1, &shadow_depth_texture);
-	glDeleteFramebuffers(1, &shadow_map_fbo);
-	shadow_color_texture_2 = 0;
-	shadow_map_fbo = create_fbo("<shadow map fbo>");
-	auto internal_format = shadow_map_settings.mode == MODE_VSM ? GL_RG32F : GL_R32F;
-	if(shadow_map_settings.mode == MODE_VSM) {
-		shadow_color_texture_2 = create_and_attach_texture(shadow_map_fbo, GL_COLOR_ATTACHMENT0, glm::ivec2(shadow_map_settings.resolution), internal_format, "<shadow map color texture 2>", false);
+void get_shadowed_light_bounds(const shadowed_light_type& shadowed_light, glm::vec3& center, float& radius) {
+	center = shadowed_light.position;
+	radius = glm::sqrt(2.0f) * shadowed_light.range;
+	if(shadowed_light.type == LIGHT_TYPE_POINT) {
+		radius = shadowed_light.range;
+	} else if(shadowed_light.type == LIGHT_TYPE_SPOT) {
+		auto base_radius = shadowed_light.range * glm::tan(glm::radians(shadowed_light.angle));
+		center = shadowed_light.position + shadowed_light.direction * shadowed_light.range / 2.0f;
+		radius = glm::sqrt(shadowed_light.range * shadowed_light.range / 4.0f + base_radius * base_radius);
 	}
-	shadow_color_texture = create_and_attach_texture(shadow_map_fbo, GL_COLOR_ATTACHMENT0, glm::ivec2(shadow_map_settings.resolution), internal_format, "<shadow map color texture>", shadow_map_settings.mode != MODE_VSM);
-	shadow_depth_texture = create_and_attach_texture(shadow_map_fbo, GL_DEPTH_ATTACHMENT, glm::ivec2(shadow_map_settings.resolution), GL_DEPTH_COMPONENT32F, "<shadow map depth texture>", true);
-	auto status = glCheckNamedFramebufferStatus(shadow_map_fbo, GL_FRAMEBUFFER);
-	if(status != GL_FRAMEBUFFER_COMPLETE) {
-		std::cout << get_fbo_error(status) << std::endl;
+}
+
+float get_shadowed_light_importance(const shadowed_light_type& shadowed_light) {
+	//the size of the light's bounding sphere on the screen, relative to the screen's height
+	glm::vec3 center;
+	float radius;
+	get_shadowed_light_bounds(shadowed_light, center, radius);
+	if(!is_sphere_visible(player.projection * player.view, center, radius)) {
+		return 0.0;
 	}
+	auto distance = glm::length(center - player.position);
+	if(distance <= radius) {
+		return 1.0;
+	}
+	return min(radius * player.projection[1][1] / distance, 1.0f);
 }
 
-void load_uniform_float(const GLuint program, const float value, const std::string& name) {
-	auto location = glGetUniformLocation(program, name.c_str());
-	if(location == -1) {
-		std::cout << name << " doesn't found" << std::endl;
+int find_shadow_atlas_tile(const int light_index) {
+	for(int i = 0; i < shadow_atlas.tiles.size(); i++) {
+		if(shadow_atlas.tiles[i].light == light_index) {
+			return i;
+		}
 	}
-	glUniform1f(location, value);
+	return -1;
 }
 
-void load_uniform_int(const GLuint program, const int value, const std::string& name) {
-	auto location = glGetUniformLocation(program, name.c_str());
-	if(location == -1) {
-		std::cout << name << " doesn't found" << std::endl;
+int get_shadowed_light_resolution(const int light_index, const float importance) {
+	if(importance <= 0.0f) {
+		return 0;
 	}
-	glUniform1i(location, value);
+	auto max_resolution = SHADOW_ATLAS_SIZE / 2;
+	auto resolution = importance * max_resolution;
+	auto power_of_two_resolution = glm::clamp(static_cast<int>(glm::exp2(glm::ceil(glm::log2(resolution)))), SHADOW_ATLAS_MIN_TILE_SIZE, max_resolution);
+	//hysteresis: a tile grows right away, but only shrinks when it's clearly too big
+	auto tile_index = find_shadow_atlas_tile(light_index);
+	if(tile_index != -1) {
+		auto size = shadow_atlas.tiles[tile_index].size;
+		if(power_of_two_resolution < size && resolution > 0.4f * size) {
+			return size;
+		}
+	}
+	return power_of_two_resolution;
 }
 
-void load_uniform_vec3(const GLuint program, const glm::vec3 value, const std::string& name) {
-	auto location = glGetUniformLocation(program, name.c_str());
-	if(location == -1) {
-		std::cout << name << " doesn't found" << std::endl;
+bool pack_shadow_atlas_tile(shadow_atlas_tile_type& tile) {
+	stbrp_rect rect = {};
+	rect.w = tile.size;
+	rect.h = tile.size;
+	stbrp_pack_rects(&shadow_atlas.context, &rect, 1);
+	if(!rect.was_packed) {
+		return false;
 	}
-	glUniform3fv(location, 1, &value[0]);
+	tile.position = glm::ivec2(rect.x, rect.y);
+	return true;
 }
 
-void load_uniform_mat(const GLuint program, const glm::mat4 value, const std::string& name) {
-	auto location = glGetUniformLocation(program, name.c_str());
-	if(location == -1) {
-		std::cout << name << " doesn't found" << std::endl;
+void repack_shadow_atlas() {
+	//the most recently used tiles go first, whatever doesn't fit anymore is evicted
+	auto& atlas = shadow_atlas;
+	stbrp_init_target(&atlas.context, SHADOW_ATLAS_SIZE, SHADOW_ATLAS_SIZE, atlas.nodes.data(), atlas.nodes.size());
+	std::stable_sort(atlas.tiles.begin(), atlas.tiles.end(), [](const shadow_atlas_tile_type& a, const shadow_atlas_tile_type& b) {
+		return a.last_used_frame > b.last_used_frame || (a.last_used_frame == b.last_used_frame && a.size > b.size);
+	});
+	std::vector<shadow_atlas_tile_type> tiles;
+	for(auto tile : atlas.tiles) {
+		auto position = tile.position;
+		if(!pack_shadow_atlas_tile(tile)) {
+			atlas.evicted_tile_count++;
+			continue;
+		}
+		tile.valid = tile.valid && tile.position == position;
+		tiles.push_back(tile);
 	}
-	glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+	atlas.tiles = tiles;
+	atlas.repack_count++;
 }
 
-void load_uniform_texture(const GLuint program, const GLuint texture, const std::string& name) {
-	auto location = glGetUniformLocation(program, name.c_str());
-	if(location == -1) {
-		std::cout << name << " doesn't found" << std::endl;
+bool allocate_shadow_atlas_tile(const int light_index, const int size) {
+	shadow_atlas_tile_type tile;
+	tile.light = light_index;
+	tile.size = size;
+	tile.last_used_frame = shadow_atlas.frame;
+	if(!pack_shadow_atlas_tile(tile)) {
+		repack_shadow_atlas();
+		if(!pack_shadow_atlas_tile(tile)) {
+			return false;
+		}
 	}
-	glBindTextureUnit(0, texture);
-	glUniform1i(location, 0);
+	shadow_atlas.tiles.push_back(tile);
+	return true;
 }
 
-void compute_matrices() {
-	player.view = glm::toMat4(player.rotation);
-	player.view = glm::translate(player.view, -player.position);
+void update_shadow_atlas() {
+	auto& atlas = shadow_atlas;
+	atlas.frame++;
+	for(int i = 0; i < shadowed_lights.size(); i++) {
+		auto& shadowed_light = shadowed_lights[i];
+		compute_shadowed_light_matrices(shadowed_light);
+		//point lights use the cube map array instead of the atlas
+		shadowed_light.resolution = shadowed_light.enabled && shadowed_light.casts_shadow && shadowed_light.type != LIGHT_TYPE_POINT ? get_shadowed_light_resolution(i, get_shadowed_light_importance(shadowed_light)) : 0;
+	}
+	//the tiles that can stay are touched first, so making room for the others doesn't evict them
+	std::vector<int> missing_lights;
+	for(int i = 0; i < shadowed_lights.size(); i++) {
+		auto resolution = shadowed_lights[i].resolution;
+		auto tile_index = find_shadow_atlas_tile(i);
+		if(tile_index != -1 && atlas.tiles[tile_index].size == resolution) {
+			atlas.tiles[tile_index].last_used_frame = atlas.frame;
+		} else if(resolution > 0) {
+			if(tile_index != -1) {
+				atlas.tiles.erase(atlas.tiles.begin() + tile_index);
+			}
+			missing_lights.push_back(i);
+		}
+	}
+	for(auto light_index : missing_lights) {
+		auto& shadowed_light = shadowed_lights[light_index];
+		//if even the smallest tile doesn't fit, the light isn't shadowed in this frame
+		while(shadowed_light.resolution >= SHADOW_ATLAS_MIN_TILE_SIZE && !allocate_shadow_atlas_tile(light_index, shadowed_light.resolution)) {
+			shadowed_light.resolution /= 2;
+		}
+		if(shadowed_light.resolution < SHADOW_ATLAS_MIN_TILE_SIZE) {
+			shadowed_light.resolution = 0;
+		}
+	}
+}
 
-	player.projection = glm::perspective(glm::radians(70.0), 1.0 * window.size.x / window.size.y, 1.0, 100.0);
-
-	if(shadow_map_settings.match_frustums) {
-		auto light_rotation = glm::quatLookAt(light.direction, glm::vec3(0.0, 1.0, 0.0));
-		auto inverse_view = glm::inverse(player.view);
-		auto inverse_projection = glm::inverse(player.projection);
-		light.view = glm::inverse(glm::translate(glm::mat4(1.0), -light.direction * light.distance + player.position) * glm::toMat4(light_rotation));
-		auto min_distances = glm::vec3(INFINITY);
-		auto max_distances = glm::vec3(-INFINITY);
-		for(auto ndc_corner_point : NDC_FRUSTUM_CORNER_POINTS) {
-			auto light_view_corner_point = inverse_projection * ndc_corner_point;
-			light_view_corner_point /= light_view_corner_point.w;
-			light_view_corner_point = light.view * inverse_view * light_view_corner_point;
-			for(int i = 0; i < 3; i++) {
-				min_distances[i] = min(min_distances[i], light_view_corner_point[i]);
-				max_distances[i] = max(max_distances[i], light_view_corner_point[i]);
-			}
-		}
-		shadow_map_settings.near_plane = -max_distances[2] - light.distance;
-		shadow_map_settings.far_plane = -min_distances[2];
-		shadow_map_settings.frustum_width = max_distances[0] - min_distances[0];
-		light.projection = glm::ortho(min_distances[0], max_distances[0], min_distances[1], max_distances[1], shadow_map_settings.near_plane, shadow_map_settings.far_plane);
-	} else {
-		light.view = glm::lookAt(glm::vec3(0.0), light.direction, glm::vec3(0.0, 1.0, 0.0));
-		light.view = glm::translate(light.view, glm::vec3(-30.0, -50.0, 90.0));
-		shadow_map_settings.frustum_width = 100.0;
-		shadow_map_settings.near_plane = 1.0;
-		shadow_map_settings.far_plane = 100.0;
+void upload_shadowed_lights() {
+	std::vector<shadowed_light_data_type> lights;
+	for(int i = 0; i < shadowed_lights.size(); i++) {
+		auto& shadowed_light = shadowed_lights[i];
+		if(!shadowed_light.enabled) {
+			continue;
+		}
+		shadowed_light_data_type data;
+		data.view_projection = shadowed_light.projection * shadowed_light.view;
+		data.depth_row = get_depth_row(shadowed_light.view, shadowed_light.near_plane, shadowed_light.far_plane);
+		data.position_type = glm::vec4(shadowed_light.position, shadowed_light.type);
+		data.direction_cos_angle = glm::vec4(shadowed_light.direction, glm::cos(glm::radians(shadowed_light.angle)));
+		data.color_range = glm::vec4(shadowed_light.color, shadowed_light.range);
+		data.tile = glm::vec4(0.0);
+		auto tile_index = shadowed_light.resolution > 0 ? find_shadow_atlas_tile(i) : -1;
+		if(tile_index != -1) {
+			auto& tile = shadow_atlas.tiles[tile_index];
+			data.tile = glm::vec4(glm::vec2(tile.position), glm::vec2(tile.size)) / static_cast<float>(SHADOW_ATLAS_SIZE);
+		}
+		data.parameters = glm::vec4(shadowed_light.bias, shadowed_light.cube, shadowed_light.filter_radius, 0.0);
+		glm::vec3 center;
+		float radius;
+		get_shadowed_light_bounds(shadowed_light, center, radius);
+		data.bounds = glm::vec4(center, shadowed_light.type == LIGHT_TYPE_DIRECTIONAL ? -1.0f : radius);
+		lights.push_back(data);
+	}
+	shadowed_light_count = lights.size();
+	upload_dynamic_buffer(shadow_atlas.light_buffer, lights.data(), lights.size() * sizeof(shadowed_light_data_type), "<shadowed light buffer>");
+}
 
-		light.projection = glm::ortho(-30.0, 30.0, -30.0, 30.0, 1.0, 130.0);
+void render_shadow_atlas_tiles(const std::vector<int>& tile_indices, const std::vector<glm::mat4>& models) {
+	//a batch of tiles is rendered with one draw per caster and run of consecutive tiles, the instance selects the viewport
+	auto& atlas = shadow_atlas;
+	std::vector<glm::mat4> view_projections;
+	std::vector<glm::vec4> depth_rows;
+	for(int i = 0; i < tile_indices.size(); i++) {
+		auto& tile = atlas.tiles[tile_indices[i]];
+		auto& shadowed_light = shadowed_lights[tile.light];
+		view_projections.push_back(tile.view_projection);
+		depth_rows.push_back(get_depth_row(shadowed_light.view, shadowed_light.near_plane, shadowed_light.far_plane));
+		glViewportIndexedf(i, tile.position.x, tile.position.y, tile.size, tile.size);
+		glScissorIndexed(i, tile.position.x, tile.position.y, tile.size, tile.size);
 	}
+	std::vector<shadow_draw_type> draws;
+	std::vector<draw_elements_indirect_command_type> commands;
+	std::vector<mesh_type> command_meshes;
+	for(auto renderable_index : get_shadow_casters_by_vao()) {
+		auto& renderable = renderables[renderable_index];
+		GLuint mask = 0;
+		for(int i = 0; i < tile_indices.size(); i++) {
+			glm::vec4 corner_points[8];
+			get_clip_space_aabb_corner_points(view_projections[i] * models[renderable_index], renderable.mesh, corner_points);
+			if(is_shadow_caster_visible(corner_points)) {
+				mask |= 1u << i;
+			}
+		}
+		for(int viewport = 0; mask >> viewport != 0; viewport++) {
+			if(!(mask & (1u << viewport))) {
+				continue;
+			}
+			auto first_viewport = viewport;
+			while(mask & (1u << (viewport + 1))) {
+				viewport++;
+			}
+			shadow_draw_type draw;
+			draw.model = models[renderable_index];
+			draw.first_layer = first_viewport;
+			draws.push_back(draw);
+			draw_elements_indirect_command_type command;
+			command.count = renderable.mesh.lods[renderable.shadow_lod].index_count;
+			command.instance_count = viewport - first_viewport + 1;
+			command.first_index = renderable.mesh.lods[renderable.shadow_lod].first_index;
+			command.base_vertex = renderable.mesh.base_vertex;
+			command.base_instance = draws.size() - 1;
+			commands.push_back(command);
+			command_meshes.push_back(renderable.mesh);
+		}
+	}
+	if(commands.empty()) {
+		return;
+	}
+	upload_dynamic_buffer(atlas.draw_buffer, draws.data(), draws.size() * sizeof(shadow_draw_type), "<shadow atlas draw buffer>");
+	upload_dynamic_buffer(atlas.indirect_buffer, commands.data(), commands.size() * sizeof(draw_elements_indirect_command_type), "<shadow atlas indirect buffer>");
+	load_uniform_mat_array(shadow_atlas_pipeline.vertex_program, view_projections, "u_view_projections");
+	load_uniform_vec4_array(shadow_atlas_pipeline.vertex_program, depth_rows, "u_depth_rows");
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, atlas.draw_buffer.buffer);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, atlas.indirect_buffer.buffer);
+	draw_indirect_commands(command_meshes);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
 }
 
-void load_uniforms() {
-	load_uniform_mat(lambertian_program, player.view, "u_view");
-	load_uniform_mat(lambertian_program, player.projection, "u_projection");
+void render_shadow_atlas() {
+	auto& atlas = shadow_atlas;
+	std::vector<glm::mat4> models;
+	for(auto& renderable : renderables) {
+		models.push_back(compute_model_matrix(renderable));
+	}
 
-	auto shadow_map = shadow_map_settings.mode == MODE_VSM ? shadow_color_texture : shadow_depth_texture;
-	load_uniform_texture(lambertian_program, shadow_map, "u_shadow_map");
+	//a tile is rendered again if it's new or moved, if its light or the static geometry has changed, or if a dynamic caster is in its view
+	std::vector<int> dirty_tiles;
+	for(int i = 0; i < atlas.tiles.size(); i++) {
+		auto& tile = atlas.tiles[i];
+		if(tile.last_used_frame != atlas.frame) {
+			continue;
+		}
+		auto& shadowed_light = shadowed_lights[tile.light];
+		auto view_projection = shadowed_light.projection * shadowed_light.view;
+		auto dirty = !tile.valid || !shadow_map_settings.cache_static_casters || tile.view_projection != view_projection || tile.static_geometry_version != shadow_cache.static_geometry_version;
+		for(int j = 0; j < renderables.size() && !dirty; j++) {
+			glm::vec4 corner_points[8];
+			get_clip_space_aabb_corner_points(view_projection * models[j], renderables[j].mesh, corner_points);
+			dirty = !renderables[j].is_static && is_shadow_caster_visible(corner_points);
+		}
+		if(dirty) {
+			tile.valid = true;
+			tile.view_projection = view_projection;
+			tile.static_geometry_version = shadow_cache.static_geometry_version;
+			dirty_tiles.push_back(i);
+		}
+	}
+	atlas.rendered_tile_count = dirty_tiles.size();
+	if(dirty_tiles.empty()) {
+		return;
+	}
+	const float clear_depth = 1.0;
+	for(auto tile_index : dirty_tiles) {
+		auto& tile = atlas.tiles[tile_index];
+		glClearTexSubImage(atlas.depth_texture, 0, tile.position.x, tile.position.y, 0, tile.size, tile.size, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &clear_depth);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, atlas.fbo);
+	glBindProgramPipeline(shadow_atlas_pipeline.pipeline);
+	glEnable(GL_SCISSOR_TEST);
+	for(int begin = 0; begin < dirty_tiles.size(); begin += SHADOW_ATLAS_VIEWPORT_COUNT) {
+		auto end = min(begin + SHADOW_ATLAS_VIEWPORT_COUNT, static_cast<int>(dirty_tiles.size()));
+		render_shadow_atlas_tiles(std::vector<int>(dirty_tiles.begin() + begin, dirty_tiles.begin() + end), models);
+	}
+	glDisable(GL_SCISSOR_TEST);
+}
 
-	load_uniform_mat(lambertian_program, light.view, "u_light_view");
-	load_uniform_mat(lambertian_program, light.projection, "u_light_projection");
-	load_uniform_vec3(lambertian_program, light.direction, "u_light_direction");
+void get_cube_face_view_projections(const shadowed_light_type& shadowed_light, glm::mat4 (&view_projections)[6]) {
+	//the faces are oriented like the cube map's faces, so the receivers can sample with the direction from the light
+	static const glm::vec3 directions[] = {glm::vec3(1.0, 0.0, 0.0), glm::vec3(-1.0, 0.0, 0.0), glm::vec3(0.0, 1.0, 0.0), glm::vec3(0.0, -1.0, 0.0), glm::vec3(0.0, 0.0, 1.0), glm::vec3(0.0, 0.0, -1.0)};
+	static const glm::vec3 ups[] = {glm::vec3(0.0, -1.0, 0.0), glm::vec3(0.0, -1.0, 0.0), glm::vec3(0.0, 0.0, 1.0), glm::vec3(0.0, 0.0, -1.0), glm::vec3(0.0, -1.0, 0.0), glm::vec3(0.0, -1.0, 0.0)};
+	for(int i = 0; i < 6; i++) {
+		view_projections[i] = shadowed_light.projection * glm::lookAt(shadowed_light.position, shadowed_light.position + directions[i], ups[i]);
+	}
+}
 
-	load_uniform_vec3(lambertian_program, light.color, "u_light_color");
-	load_uniform_float(lambertian_program, shadow_map_settings.intensity, "u_intensity");
-	if(shadow_map_settings.mode == MODE_PCF || shadow_map_settings.mode == MODE_PCSS) {
-		load_uniform_float(lambertian_program, light.size, "u_light_size");
-		load_uniform_float(lambertian_program, shadow_map_settings.rotate_samples, "u_rotate_samples");
-		load_uniform_float(lambertian_program, shadow_map_settings.scale, "u_scale");
-		if(shadow_map_settings.sampling_mode == SAMPLING_MODE_GRID) {
-			load_uniform_int(lambertian_program, shadow_map_settings.grid_kernel_size, "u_kernel_size");
-		} else if(shadow_map_settings.sampling_mode == SAMPLING_MODE_VOGEL) {
-			load_uniform_int(lambertian_program, shadow_map_settings.vogel_sample_count, "u_vogel_sample_count");
+void get_bounding_sphere(const glm::mat4& model, const mesh_type& mesh, glm::vec3& center, float& radius) {
+	center = glm::vec3(model * glm::vec4((mesh.aabb_min + mesh.aabb_max) / 2.0f, 1.0));
+	radius = 0.0;
+	for(int i = 0; i < 8; i++) {
+		auto corner_point = glm::vec3(i & 1 ? mesh.aabb_max.x : mesh.aabb_min.x, i & 2 ? mesh.aabb_max.y : mesh.aabb_min.y, i & 4 ? mesh.aabb_max.z : mesh.aabb_min.z);
+		radius = max(radius, glm::distance(center, glm::vec3(model * glm::vec4(corner_point, 1.0))));
+	}
+}
+
+GLuint get_cube_face_mask(const shadowed_light_type& shadowed_light, const glm::mat4 (&view_projections)[6], const glm::mat4& model, const mesh_type& mesh) {
+	glm::vec3 center;
+	float radius;
+	get_bounding_sphere(model, mesh, center, radius);
+	if(glm::distance(center, shadowed_light.position) > shadowed_light.range + radius) {
+		return 0;
+	}
+	GLuint mask = 0;
+	for(int i = 0; i < 6; i++) {
+		if(is_sphere_visible(view_projections[i], center, radius)) {
+			mask |= 1u << i;
 		}
 	}
-	if(shadow_map_settings.mode == MODE_VSM) {
-		load_uniform_float(lambertian_program, shadow_map_settings.vsm_smoothstep_fix, "u_smoothstep_fix");
-		load_uniform_float(lambertian_program, shadow_map_settings.vsm_smoothstep_fix_lower_bound, "u_smoothstep_fix_lower_bound");
+	return mask;
+}
+
+void update_point_shadow_maps() {
+	//a point light keeps its cube while it's visible, the others get the free cubes in order
+	auto& maps = point_shadow_maps;
+	std::vector<int> missing_lights;
+	for(int i = 0; i < shadowed_lights.size(); i++) {
+		auto& shadowed_light = shadowed_lights[i];
+		if(shadowed_light.type != LIGHT_TYPE_POINT) {
+			continue;
+		}
+		auto visible = shadowed_light.enabled && shadowed_light.casts_shadow && get_shadowed_light_importance(shadowed_light) > 0.0f;
+		if(!visible && shadowed_light.cube != -1) {
+			maps.cubes[shadowed_light.cube] = point_shadow_cube_type();
+			shadowed_light.cube = -1;
+		} else if(visible && shadowed_light.cube == -1) {
+			missing_lights.push_back(i);
+		}
+	}
+	for(auto light_index : missing_lights) {
+		for(int i = 0; i < POINT_SHADOW_MAP_COUNT; i++) {
+			if(maps.cubes[i].light == -1) {
+				maps.cubes[i].light = light_index;
+				shadowed_lights[light_index].cube = i;
+				break;
+			}
+		}
+	}
+	for(auto& shadowed_light : shadowed_lights) {
+		if(shadowed_light.type == LIGHT_TYPE_POINT) {
+			shadowed_light.resolution = shadowed_light.cube == -1 ? 0 : POINT_SHADOW_MAP_RESOLUTION;
+		}
+	}
+}
+
+void render_point_shadow_maps() {
+	auto& maps = point_shadow_maps;
+	maps.rendered_cube_count = 0;
+	maps.rendered_face_count = 0;
+	maps.naive_face_count = 0;
+	std::vector<glm::mat4> models;
+	for(auto& renderable : renderables) {
+		models.push_back(compute_model_matrix(renderable));
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, maps.fbo);
+	glViewport(0, 0, POINT_SHADOW_MAP_RESOLUTION, POINT_SHADOW_MAP_RESOLUTION);
+	glBindProgramPipeline(point_shadow_map_pipeline.pipeline);
+	const float clear_depth = 1.0;
+	for(int i = 0; i < POINT_SHADOW_MAP_COUNT; i++) {
+		auto& cube = maps.cubes[i];
+		if(cube.light == -1) {
+			continue;
+		}
+		auto& shadowed_light = shadowed_lights[cube.light];
+		glm::mat4 view_projections[6];
+		get_cube_face_view_projections(shadowed_light, view_projections);
+
+		//a cube is rendered again if it's new, if its light or the static geometry has changed, or if a dynamic caster is in its range
+		std::vector<GLuint> face_masks;
+		auto dirty = !cube.valid || !shadow_map_settings.cache_static_casters || cube.position != shadowed_light.position || cube.range != shadowed_light.range || cube.static_geometry_version != shadow_cache.static_geometry_version;
+		for(int j = 0; j < renderables.size(); j++) {
+			face_masks.push_back(get_cube_face_mask(shadowed_light, view_projections, models[j], renderables[j].mesh));
+			dirty = dirty || (!renderables[j].is_static && face_masks[j] != 0);
+		}
+		if(!dirty) {
+			continue;
+		}
+		cube.valid = true;
+		cube.position = shadowed_light.position;
+		cube.range = shadowed_light.range;
+		cube.static_geometry_version = shadow_cache.static_geometry_version;
+		maps.rendered_cube_count++;
+		maps.naive_face_count += 6 * renderables.size();
+		glClearTexSubImage(maps.depth_texture, 0, 0, 0, 6 * i, POINT_SHADOW_MAP_RESOLUTION, POINT_SHADOW_MAP_RESOLUTION, 6, GL_DEPTH_COMPONENT, GL_FLOAT, &clear_depth);
+
+		//one draw per caster in range, the geometry shader sends each triangle only to the faces it overlaps
+		std::vector<point_shadow_draw_type> draws;
+		std::vector<draw_elements_indirect_command_type> commands;
+		std::vector<mesh_type> command_meshes;
+		for(auto renderable_index : get_shadow_casters_by_vao()) {
+			auto& renderable = renderables[renderable_index];
+			if(face_masks[renderable_index] == 0) {
+				continue;
+			}
+			maps.rendered_face_count += glm::bitCount(face_masks[renderable_index]);
+			point_shadow_draw_type draw;
+			draw.model = models[renderable_index];
+			draw.face_mask = face_masks[renderable_index];
+			draws.push_back(draw);
+			draw_elements_indirect_command_type command;
+			command.count = renderable.mesh.lods[renderable.shadow_lod].index_count;
+			command.instance_count = 1;
+			command.first_index = renderable.mesh.lods[renderable.shadow_lod].first_index;
+			command.base_vertex = renderable.mesh.base_vertex;
+			command.base_instance = draws.size() - 1;
+			commands.push_back(command);
+			command_meshes.push_back(renderable.mesh);
+		}
+		if(commands.empty()) {
+			continue;
+		}
+		upload_dynamic_buffer(maps.draw_buffer, draws.data(), draws.size() * sizeof(point_shadow_draw_type), "<point shadow map draw buffer>");
+		upload_dynamic_buffer(maps.indirect_buffer, commands.data(), commands.size() * sizeof(draw_elements_indirect_command_type), "<point shadow map indirect buffer>");
+		load_uniform_mat_array(point_shadow_map_pipeline.geometry_program, std::vector<glm::mat4>(std::begin(view_projections), std::end(view_projections)), "u_view_projections");
+		load_uniform_int(point_shadow_map_pipeline.geometry_program, 6 * i, "u_first_layer");
+		load_uniform_vec3(point_shadow_map_pipeline.fragment_program, shadowed_light.position, "u_light_position");
+		load_uniform_float(point_shadow_map_pipeline.fragment_program, shadowed_light.range, "u_range");
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, maps.draw_buffer.buffer);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, maps.indirect_buffer.buffer);
+		draw_indirect_commands(command_meshes);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+}
+
+void create_light_clusters() {
+	auto& clusters = light_clusters;
+	clusters.cluster_buffer = create_buffer(nullptr, CLUSTER_COUNT * sizeof(glm::uvec2), "<cluster buffer>", GL_NONE, GPU_CATEGORY_BUFFERS);
+	clusters.light_index_buffer = create_buffer(nullptr, LIGHT_INDEX_CAPACITY * sizeof(GLuint), "<light index buffer>", GL_NONE, GPU_CATEGORY_BUFFERS);
+	clusters.light_index_count_buffer = create_buffer(nullptr, sizeof(GLuint), "<light index count buffer>", GL_NONE, GPU_CATEGORY_BUFFERS);
+}
+
+void cull_lights() {
+	//one invocation per froxel, it collects the lights whose bounding sphere touches its box into the compact index list
+	auto compute_program = light_culling_pipeline.compute_program;
+	load_uniform_mat(compute_program, glm::inverse(player.projection), "u_inverse_projection");
+	load_uniform_mat(compute_program, player.view, "u_view");
+	load_uniform_float(compute_program, player.near_plane, "u_near_plane");
+	load_uniform_float(compute_program, player.far_plane, "u_far_plane");
+	load_uniform_int(compute_program, shadowed_light_count, "u_shadowed_light_count");
+	load_uniform_int(compute_program, LIGHT_INDEX_CAPACITY, "u_light_index_capacity");
+	const GLuint zero = 0;
+	glClearNamedBufferData(light_clusters.light_index_count_buffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+	glBindProgramPipeline(light_culling_pipeline.pipeline);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, shadow_atlas.light_buffer.buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, light_clusters.cluster_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, light_clusters.light_index_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, light_clusters.light_index_count_buffer);
+	glDispatchCompute((CLUSTER_COUNT + 63) / 64, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void render_shadow_map() {
+	std::fill(std::begin(shadow_caster_culling.caster_counts), std::end(shadow_caster_culling.caster_counts), 0);
+	meshlet_culling.shadow_meshlet_count = 0;
+	glEnable(GL_DEPTH_CLAMP);
+	if(is_virtual_shadow_map_active()) {
+		render_virtual_shadow_map();
 	} else {
-		load_uniform_float(lambertian_program, shadow_map_settings.bias, "u_bias");
+		render_shadow_map_layers();
+	}
+	update_shadow_atlas();
+	update_point_shadow_maps();
+	upload_shadowed_lights();
+	render_shadow_atlas();
+	glDisable(GL_DEPTH_CLAMP);
+	//the cubes need near plane clipping, the triangles behind a face's near plane would be projected through the light
+	render_point_shadow_maps();
+}
+
+int select_lod(const mesh_type& mesh, const int current_lod, const float error_scale, const float allowed_error) {
+	//the coarsest lod within the allowed error, getting coarser needs a margin, so a lod near the threshold doesn't pop back and forth
+	if(!lod_settings.enabled) {
+		return 0;
 	}
-	if(shadow_map_settings.mode == MODE_PCSS) {
-		load_uniform_float(lambertian_program, shadow_map_settings.near_plane, "u_near_plane");
-		load_uniform_float(lambertian_program, shadow_map_settings.far_plane, "u_far_plane");
-		load_uniform_float(lambertian_program, shadow_map_settings.frustum_width, "u_frustum_width");
+	for(int i = mesh.lod_count - 1; i > 0; i--) {
+		auto threshold = i > current_lod ? allowed_error * (1.0f - lod_settings.hysteresis) : allowed_error;
+		if(mesh.lods[i].error * error_scale <= threshold) {
+			return i;
+		}
 	}
+	return 0;
 }
 
-void load_shadow_map_uniforms() {
-	load_uniform_mat(shadow_map_program, light.view, "u_view");
-	load_uniform_mat(shadow_map_program, light.projection, "u_projection");
+void update_lods() {
+	auto cascade_count = get_cascade_count();
+	auto resolution = is_virtual_shadow_map_active() ? VIRTUAL_SHADOW_MAP_RESOLUTION : get_rendered_resolution();
+	lod_settings.triangle_count = 0;
+	lod_settings.shadow_triangle_count = 0;
+	lod_settings.full_triangle_count = 0;
+	for(auto& renderable : renderables) {
+		auto& mesh = renderable.mesh;
+		glm::vec3 center;
+		float radius;
+		get_bounding_sphere(compute_model_matrix(renderable), mesh, center, radius);
+		auto scale = glm::abs(renderable.scale);
+		auto error_scale = max(scale.x, max(scale.y, scale.z));
+
+		//the camera allows an error of a few pixels at the nearest point of the bounding sphere
+		auto distance = max(glm::distance(center, player.position) - radius, player.near_plane);
+		auto pixel_size = 2.0f * distance / (player.projection[1][1] * window.size.y);
+		renderable.lod = select_lod(mesh, renderable.lod, error_scale, pixel_size * lod_settings.pixel_error);
+
+		//the shadows allow an error of a few texels of the cascade the renderable is in, they are blurred and seen from afar anyway
+		auto depth = -(player.view * glm::vec4(center, 1.0)).z;
+		auto cascade = 0;
+		while(cascade + 1 < cascade_count && depth > light.cascades[cascade].split_far) {
+			cascade++;
+		}
+		auto texel_size = 2.0f / (light.cascades[cascade].projection[0][0] * resolution);
+		renderable.shadow_lod = select_lod(mesh, renderable.shadow_lod, error_scale, texel_size * lod_settings.shadow_texel_error);
+
+		lod_settings.triangle_count += mesh.lods[renderable.lod].index_count / 3;
+		lod_settings.shadow_triangle_count += renderable.casts_shadows ? mesh.lods[renderable.shadow_lod].index_count / 3 : 0;
+		lod_settings.full_triangle_count += mesh.lods[0].index_count / 3;
+	}
+	//the loaded scene's instances are submitted at lod 0, so their shadow count is an upper bound
+	auto& store = scene_store;
+	for(int i = 0; i < store.mesh_assets.size(); i++) {
+		auto& asset = asset_loader.mesh_assets[store.mesh_assets[i]];
+		if(asset.state != ASSET_STATE_RESIDENT) {
+			continue;
+		}
+		auto instance_count = static_cast<long long>(get_scene_store_instance_count(i, SCENE_STORE_RANGE_RECEIVER, SCENE_STORE_RANGE_DYNAMIC_CASTER));
+		auto caster_count = static_cast<long long>(get_scene_store_instance_count(i, SCENE_STORE_RANGE_STATIC_CASTER, SCENE_STORE_RANGE_DYNAMIC_CASTER));
+		for(auto& instance : asset.instances) {
+			auto triangle_count = asset.meshes[instance.mesh].lods[0].index_count / 3;
+			lod_settings.triangle_count += triangle_count * instance_count;
+			lod_settings.shadow_triangle_count += triangle_count * caster_count;
+			lod_settings.full_triangle_count += triangle_count * instance_count;
+		}
+	}
 }
 
-void load_renderable_uniforms(const GLuint program, const renderable_type renderable, const bool color = true) {
-	auto model = glm::mat4(1.0);
-	model = glm::translate(model, renderable.position);
-	model = glm::rotate(model, glm::angle(renderable.rotation), glm::axis(renderable.rotation));
-	model = glm::scale(model, renderable.scale);
-	load_uniform_mat(program, model, "u_model");
-	if(color) {
-		load_uniform_vec3(program, renderable.diffuse_color, "u_diffuse_color");
+void render_geometry() {
+	cull_lights();
+	std::vector<meshlet_draw_type> meshlet_draws;
+	std::vector<int> meshlet_draw_indices(renderables.size(), -1);
+	for(int i = 0; i < renderables.size(); i++) {
+		if(has_meshlets(renderables[i].mesh, renderables[i].lod)) {
+			meshlet_draw_indices[i] = meshlet_draws.size();
+			meshlet_draw_type meshlet_draw;
+			meshlet_draw.renderable = i;
+			meshlet_draw.lod = renderables[i].lod;
+			meshlet_draws.push_back(meshlet_draw);
+		}
+	}
+	std::vector<glm::vec4> frustum_planes;
+	get_frustum_planes(player.projection * player.view, true, frustum_planes);
+	meshlet_culling.camera_meshlet_count = cull_meshlets(meshlet_draws, frustum_planes, false, player.position, player.forward, meshlet_culling.camera_buffers);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, scene_fbo);
+	glViewport(0, 0, window.size.x, window.size.y);
+	glClearColor(0.5, 0.8, 1.0, 1.0);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glBindProgramPipeline(lambertian_pipeline.pipeline);
+	load_uniforms();
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, meshlet_culling.camera_buffers.command_buffer.buffer);
+	glBindBuffer(GL_PARAMETER_BUFFER, meshlet_culling.camera_buffers.count_buffer.buffer);
+	for(int i = 0; i < renderables.size(); i++) {
+		auto& renderable = renderables[i];
+		load_renderable_uniforms(lambertian_pipeline, renderable);
+		if(meshlet_draw_indices[i] != -1) {
+			draw_meshlets(meshlet_draws[meshlet_draw_indices[i]], meshlet_draw_indices[i], renderable.mesh.vao, renderable.mesh.index_type);
+			continue;
+		}
+		auto& lod = renderable.mesh.lods[renderable.lod];
+		glBindVertexArray(renderable.mesh.vao);
+		glDrawElementsBaseVertex(GL_TRIANGLES, lod.index_count, renderable.mesh.index_type, reinterpret_cast<void*>(lod.first_index * get_index_size(renderable.mesh.index_type)), renderable.mesh.base_vertex);
 	}
+	if(scene_store.instance_buffer != 0) {
+		glBindProgramPipeline(scene_store_pipeline.pipeline);
+		draw_scene_store(scene_store_pipeline.vertex_program, SCENE_STORE_RANGE_RECEIVER, SCENE_STORE_RANGE_DYNAMIC_CASTER);
+	}
+	glBindBuffer(GL_PARAMETER_BUFFER, 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
 }
 
-void load_gaussian_blur_uniforms(const bool horizontal, const GLuint texture) {
-	load_uniform_texture(gaussian_blur_program, texture, "u_image");
-	load_uniform_float(gaussian_blur_program, horizontal, "u_horizontal");
-	load_uniform_float(gaussian_blur_program, light.size, "u_light_size");
-	load_uniform_float(gaussian_blur_program, shadow_map_settings.rotate_samples, "u_rotate_samples");
-	load_uniform_float(gaussian_blur_program, shadow_map_settings.scale, "u_scale");
+void create_gpu_timer(gpu_timer_type& timer) {
+	glCreateQueries(GL_TIME_ELAPSED, 3, timer.queries);
 }
 
-void render_shadow_map() {
-	glBindFramebuffer(GL_FRAMEBUFFER, shadow_map_fbo);
-	glViewport(0, 0, shadow_map_settings.resolution, shadow_map_settings.resolution);
-	glClearColor(1.0, 1.0, 1.0, 1.0);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glUseProgram(shadow_map_program);
-	load_shadow_map_uniforms();
-	for(auto& renderable : renderables) {
-		load_renderable_uniforms(shadow_map_program, renderable, false);
-		glBindVertexArray(renderable.mesh.vao);
-		glDrawElements(GL_TRIANGLES, renderable.mesh.index_count, GL_UNSIGNED_INT, 0);
-	}
+void destroy_gpu_timer(gpu_timer_type& timer) {
+	glDeleteQueries(3, timer.queries);
+	timer = gpu_timer_type();
+}
 
-	if(shadow_map_settings.mode == MODE_VSM) {
-		glUseProgram(gaussian_blur_program);
-		glDisable(GL_DEPTH_TEST);
-		glDisable(GL_CULL_FACE);
+void begin_gpu_timer(gpu_timer_type& timer) {
+	//the oldest query is reused, its result is collected first if it's ready, otherwise it's dropped
+	auto query = timer.queries[timer.index];
+	if(timer.pending[timer.index]) {
+		GLint available = GL_FALSE;
+		glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if(available) {
+			GLuint64 elapsed_time;
+			glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed_time);
+			timer.time = elapsed_time / 1000.0 / 1000.0;
+		}
+	}
+	glBeginQuery(GL_TIME_ELAPSED, query);
+}
 
-		glNamedFramebufferTexture(shadow_map_fbo, GL_COLOR_ATTACHMENT0, shadow_color_texture_2, 0);
-		load_gaussian_blur_uniforms(true, shadow_color_texture);
-		glBindVertexArray(quad_mesh.vao);
-		glDrawElements(GL_TRIANGLES, quad_mesh.index_count, GL_UNSIGNED_INT, 0);
+void end_gpu_timer(gpu_timer_type& timer) {
+	glEndQuery(GL_TIME_ELAPSED);
+	timer.pending[timer.index] = true;
+	timer.index = (timer.index + 1) % 3;
+}
 
-		glNamedFramebufferTexture(shadow_map_fbo, GL_COLOR_ATTACHMENT0, shadow_color_texture, 0);
-		load_gaussian_blur_uniforms(false, shadow_color_texture_2);
-		glBindVertexArray(quad_mesh.vao);
-		glDrawElements(GL_TRIANGLES, quad_mesh.index_count, GL_UNSIGNED_INT, 0);
+int round_resolution(const float resolution) {
+	//multiples of 64 keep the number of distinct sizes, and so cache invalidations, low
+	auto rounded = static_cast<int>(resolution / 64.0f) * 64;
+	return glm::clamp(rounded, min(shadow_map_settings.min_resolution, shadow_map_settings.resolution), shadow_map_settings.resolution);
+}
 
-		glEnable(GL_DEPTH_TEST);
-		glEnable(GL_CULL_FACE);
+void update_resolution_governor() {
+	auto& governor = resolution_governor;
+	if(!shadow_map_settings.dynamic_resolution) {
+		governor.rendered_resolution = shadow_map_settings.resolution;
+		return;
+	}
+	//the shadow pass cost is assumed to scale with the texel count, the rest of the frame is fixed
+	auto shadow_time = max(governor.shadow_timer.time, 0.01);
+	auto scene_time = governor.scene_timer.time;
+	auto target_time = static_cast<double>(shadow_map_settings.target_gpu_time);
+	auto total_time = shadow_time + scene_time;
+	//hysteresis: shrinking is quick, growing needs a clear margin for a longer time
+	governor.frames_over_budget = total_time > target_time ? governor.frames_over_budget + 1 : 0;
+	governor.frames_under_budget = total_time < 0.8 * target_time ? governor.frames_under_budget + 1 : 0;
+	auto resolution = governor.rendered_resolution;
+	if(governor.frames_over_budget >= 5 || governor.frames_under_budget >= 60) {
+		auto shadow_budget = max(target_time - scene_time, 0.1 * shadow_time);
+		auto ratio = glm::sqrt(shadow_budget / shadow_time);
+		if(governor.frames_under_budget > 0) {
+			//grows in small steps, the prediction is less reliable upward
+			ratio = min(ratio, 1.25);
+		}
+		resolution = round_resolution(static_cast<float>(governor.rendered_resolution * ratio));
+		governor.frames_over_budget = 0;
+		governor.frames_under_budget = 0;
+	}
+	if(resolution != governor.rendered_resolution) {
+		governor.rendered_resolution = resolution;
+		//stale views were rendered at the old size
+		for(auto& valid : shadow_update_scheduler.valid) {
+			valid = false;
+		}
 	}
 }
 
-void render_geometry() {
+void present_scene() {
+	glBlitNamedFramebuffer(scene_fbo, 0, 0, 0, window.size.x, window.size.y, 0, 0, window.size.x, window.size.y, GL_COLOR_BUFFER_BIT, GL_NEAREST);
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	glViewport(0, 0, window.size.x, window.size.y);
-	glClearColor(0.5, 0.8, 1.0, 1.0);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glUseProgram(lambertian_program);
-	load_uniforms();
-	for(auto& renderable : renderables) {
-		load_renderable_uniforms(lambertian_program, renderable);
-		glBindVertexArray(renderable.mesh.vao);
-		glDrawElements(GL_TRIANGLES, renderable.mesh.index_count, GL_UNSIGNED_INT, 0);
-	}
 }
 
 void handle_time() {
@@ -777,6 +6321,30 @@ void handle_time() {
 		time_handler.average_frame_time = time_handler.frame_time_sum / time_handler.current_frame_count;
 		time_handler.frame_time_sum = 0;
 		time_handler.current_frame_count = 0;
+		shadow_cache.hit_rate = shadow_cache.frame_count > 0 ? shadow_cache.hit_count / shadow_cache.frame_count : 0.0;
+		shadow_cache.hit_count = 0;
+		shadow_cache.frame_count = 0;
+		shadow_cache.rasterized_texel_rate = shadow_cache.texel_count > 0 ? shadow_cache.rasterized_texel_count / shadow_cache.texel_count : 0.0;
+		shadow_cache.rasterized_texel_count = 0;
+		shadow_cache.texel_count = 0;
+	}
+}
+
+void update_light() {
+	if(light.time_of_day) {
+		auto angle = glm::radians(light.time_of_day_speed * static_cast<float>(time_handler.delta_time));
+		light.direction = glm::normalize(glm::angleAxis(angle, glm::normalize(glm::vec3(1.0, 0.0, 1.0))) * light.direction);
+	}
+}
+
+void update_renderables() {
+	if(!scene_settings.spin_dynamic_renderables) {
+		return;
+	}
+	for(auto& renderable : renderables) {
+		if(!renderable.is_static) {
+			renderable.rotation = glm::normalize(glm::angleAxis(static_cast<float>(time_handler.delta_time), glm::vec3(0.0, 1.0, 0.0)) * renderable.rotation);
+		}
 	}
 }
 
@@ -836,13 +6404,286 @@ void handle_input() {
 }
 
 void set_scale() {
-	if(shadow_map_settings.mode == MODE_PCF) {
+	if(shadow_map_settings.mode == MODE_PCF && is_virtual_shadow_map_active()) {
+		//the same few texels as the cascades, the virtual map covers a much larger area
+		shadow_map_settings.scale = 4.0 / VIRTUAL_SHADOW_MAP_RESOLUTION;
+	} else if(shadow_map_settings.mode == MODE_PCF) {
 		shadow_map_settings.scale = shadow_map_settings.match_frustums ? 1.0 / 1024.0 : 1.0 / 256.0;
 	} else if(shadow_map_settings.mode == MODE_PCSS) {
 		shadow_map_settings.scale = shadow_map_settings.match_frustums ? 4.0 : 1.0 / 2.0;
 	} else if(shadow_map_settings.mode == MODE_VSM) {
 		shadow_map_settings.scale = shadow_map_settings.match_frustums ? 1.0 / 768.0 : 1.0 / 256.0;
 	}
+	shadow_map_settings.scale *= shadow_map_settings.filter_scale;
+}
+
+void save_camera_path(const std::string& path, const std::vector<camera_path_frame_type>& frames) {
+	std::ofstream file(path);
+	if(!file) {
+		std::cout << "Couldn't write the camera path " << path << std::endl;
+		return;
+	}
+	for(auto& frame : frames) {
+		file << frame.position.x << " " << frame.position.y << " " << frame.position.z << " ";
+		file << frame.rotation.w << " " << frame.rotation.x << " " << frame.rotation.y << " " << frame.rotation.z << std::endl;
+	}
+}
+
+bool load_camera_path(const std::string& path, std::vector<camera_path_frame_type>& frames) {
+	std::ifstream file(path);
+	if(!file) {
+		std::cout << "Couldn't read the camera path " << path << std::endl;
+		return false;
+	}
+	camera_path_frame_type frame;
+	while(file >> frame.position.x >> frame.position.y >> frame.position.z >> frame.rotation.w >> frame.rotation.x >> frame.rotation.y >> frame.rotation.z) {
+		frames.push_back(frame);
+	}
+	if(frames.empty()) {
+		std::cout << "The camera path " << path << " is empty" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void record_camera_path() {
+	if(camera_path_recorder.recording) {
+		camera_path_recorder.frames.push_back({player.position, player.rotation});
+	}
+}
+
+void apply_shadow_map_settings(const shadow_map_settings_type& settings) {
+	shadow_map_settings = settings;
+	set_scale();
+	create_lambertian_fragment_program();
+	create_shadow_map_fragment_program();
+	create_gaussian_blur_fragment_program();
+	create_render_targets();
+}
+
+std::vector<shadow_map_settings_type> get_tuning_candidates(const shadow_map_settings_type& base_settings) {
+	//the cross product of the resolutions, cascade counts, modes, sample patterns, sample counts, filter scales and sample rotation, pruned by these rules:
+	//- the sample and kernel counts are the UI's steps, without the ones that barely differ from their neighbours
+	//- a regular grid isn't rotated, that only adds noise, and VSM doesn't take point samples
+	//- the normal mode has no filter, so only its resolution and cascade count vary
+	//- the cascade count only varies with matched frustums, otherwise there is one view
+	//with matched frustums it's 6 * 3 * 121 = 2178 candidates, otherwise 726
+	std::vector<int> cascade_counts = {base_settings.cascade_count};
+	if(base_settings.match_frustums) {
+		cascade_counts = {1, 2, 4};
+	}
+	std::vector<shadow_map_settings_type> candidates;
+	for(auto resolution : {128, 256, 512, 1024, 2048, 4096}) {
+		for(auto cascade_count : cascade_counts) {
+			auto settings = base_settings;
+			settings.resolution = resolution;
+			settings.cascade_count = cascade_count;
+			settings.mode = MODE_NORMAL;
+			settings.rotate_samples = false;
+			settings.filter_scale = 1.0;
+			candidates.push_back(settings);
+			for(auto filter_scale : {0.5f, 1.0f, 2.0f}) {
+				settings.filter_scale = filter_scale;
+				for(auto mode : {MODE_PCF, MODE_PCSS}) {
+					settings.mode = mode;
+					settings.rotate_samples = false;
+					settings.sampling_mode = SAMPLING_MODE_GRID;
+					for(auto kernel_size : {3, 5, 9, 13}) {
+						settings.grid_kernel_size = kernel_size;
+						candidates.push_back(settings);
+					}
+					for(auto rotate_samples : {false, true}) {
+						settings.rotate_samples = rotate_samples;
+						settings.sampling_mode = SAMPLING_MODE_POISSON;
+						for(auto sample_count : {25, 64, 128}) {
+							settings.poisson_sample_count = sample_count;
+							candidates.push_back(settings);
+						}
+						settings.sampling_mode = SAMPLING_MODE_VOGEL;
+						for(auto sample_count : {16, 32, 64, 128}) {
+							settings.vogel_sample_count = sample_count;
+							candidates.push_back(settings);
+						}
+					}
+				}
+				settings.mode = MODE_VSM;
+				settings.rotate_samples = false;
+				for(auto kernel_size : {3, 5, 9, 13}) {
+					settings.gaussian_kernel_size = kernel_size;
+					candidates.push_back(settings);
+				}
+			}
+		}
+	}
+	return candidates;
+}
+
+double render_tuning_frame(const GLuint query, std::vector<unsigned char>& image) {
+	update_render_target_pool();
+	update_renderables();
+	update_light();
+	compute_matrices();
+	update_lods();
+	glBeginQuery(GL_TIME_ELAPSED, query);
+	render_shadow_map();
+	render_geometry();
+	glEndQuery(GL_TIME_ELAPSED);
+	if(shadow_map_settings.match_frustums && shadow_map_settings.sdsm) {
+		reduce_scene_depth();
+	}
+	if(is_virtual_shadow_map_active()) {
+		mark_virtual_pages();
+	}
+	GLuint64 elapsed_time;
+	glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed_time);
+	glGetTextureImage(scene_color_texture, 0, GL_RGB, GL_UNSIGNED_BYTE, image.size(), image.data());
+	return elapsed_time / 1000.0 / 1000.0;
+}
+
+tuning_result_type render_tuning_path(const std::vector<camera_path_frame_type>& frames, const std::vector<renderable_type>& initial_renderables, const light_type& initial_light, std::vector<std::vector<unsigned char>>& images, const bool reference) {
+	//every run starts from the same state, with a fixed time step, so the images are comparable
+	renderables = initial_renderables;
+	light = initial_light;
+	time_handler.delta_time = 1.0 / 60.0;
+	GLuint query;
+	glCreateQueries(GL_TIME_ELAPSED, 1, &query);
+	tuning_result_type result;
+	result.settings = shadow_map_settings;
+	std::vector<unsigned char> image(window.size.x * window.size.y * 3);
+	double squared_error_sum = 0.0;
+	for(int i = 0; i < frames.size(); i++) {
+		player.position = frames[i].position;
+		player.rotation = frames[i].rotation;
+		result.frame_time += render_tuning_frame(query, image) / frames.size();
+		if(reference) {
+			images.push_back(image);
+			continue;
+		}
+		for(int j = 0; j < image.size(); j++) {
+			auto difference = (image[j] - images[i][j]) / 255.0;
+			squared_error_sum += difference * difference;
+		}
+	}
+	result.error = glm::sqrt(squared_error_sum / (frames.size() * image.size()));
+	glDeleteQueries(1, &query);
+	return result;
+}
+
+std::vector<tuning_result_type> get_pareto_front(std::vector<tuning_result_type> results) {
+	//a result is kept if nothing is both faster and more accurate
+	std::sort(results.begin(), results.end(), [](const tuning_result_type& a, const tuning_result_type& b) {
+		return a.frame_time < b.frame_time || (a.frame_time == b.frame_time && a.error < b.error);
+	});
+	std::vector<tuning_result_type> pareto_front;
+	for(auto& result : results) {
+		if(pareto_front.empty() || result.error < pareto_front.back().error) {
+			pareto_front.push_back(result);
+		}
+	}
+	return pareto_front;
+}
+
+bool save_shadow_profile(const std::string& path, const std::vector<tuning_result_type>& pareto_front, const float quality_threshold) {
+	std::ofstream file(path);
+	if(!file) {
+		std::cout << "Couldn't write the shadow profile " << path << std::endl;
+		return false;
+	}
+	file << "quality_threshold " << quality_threshold << std::endl;
+	for(auto& result : pareto_front) {
+		auto& settings = result.settings;
+		file << "entry " << settings.mode << " " << settings.resolution << " " << settings.sampling_mode << " " << settings.grid_kernel_size << " ";
+		file << settings.poisson_sample_count << " " << settings.vogel_sample_count << " " << settings.gaussian_kernel_size << " ";
+		file << settings.rotate_samples << " " << settings.cascade_count << " " << settings.filter_scale << " ";
+		file << result.frame_time << " " << result.error << std::endl;
+	}
+	return true;
+}
+
+void load_shadow_profile(const std::string& path) {
+	//the profile is optional, without it the defaults are used
+	std::ifstream file(path);
+	if(!file) {
+		return;
+	}
+	float quality_threshold = 0.0;
+	std::vector<tuning_result_type> entries;
+	std::string keyword;
+	while(file >> keyword) {
+		if(keyword == "quality_threshold") {
+			file >> quality_threshold;
+		} else if(keyword == "entry") {
+			tuning_result_type entry;
+			entry.settings = shadow_map_settings;
+			auto& settings = entry.settings;
+			file >> settings.mode >> settings.resolution >> settings.sampling_mode >> settings.grid_kernel_size;
+			file >> settings.poisson_sample_count >> settings.vogel_sample_count >> settings.gaussian_kernel_size;
+			file >> settings.rotate_samples >> settings.cascade_count >> settings.filter_scale;
+			file >> entry.frame_time >> entry.error;
+			entries.push_back(entry);
+		}
+	}
+	if(entries.empty()) {
+		std::cout << "The shadow profile " << path << " has no entries" << std::endl;
+		return;
+	}
+	//the cheapest entry meeting the threshold, or the most accurate one if none does
+	auto best = std::min_element(entries.begin(), entries.end(), [&](const tuning_result_type& a, const tuning_result_type& b) {
+		auto a_meets = a.error <= quality_threshold;
+		auto b_meets = b.error <= quality_threshold;
+		if(a_meets != b_meets) {
+			return a_meets;
+		}
+		return a_meets ? a.frame_time < b.frame_time : a.error < b.error;
+	});
+	shadow_map_settings = best->settings;
+	resolution_governor.rendered_resolution = shadow_map_settings.resolution;
+	std::cout << "Shadow profile loaded, expected frame time: " << best->frame_time << " ms, error: " << best->error << std::endl;
+}
+
+bool tune(const std::string& camera_path, const float quality_threshold) {
+	std::vector<camera_path_frame_type> frames;
+	if(!load_camera_path(camera_path, frames)) {
+		return false;
+	}
+	wait_for_assets();
+	auto initial_renderables = renderables;
+	auto initial_light = light;
+	auto base_settings = shadow_map_settings;
+	//caching and amortization would hide the real cost of a setting
+	base_settings.cache_static_casters = false;
+	base_settings.amortized_updates = false;
+	base_settings.dynamic_resolution = false;
+
+	auto reference_settings = base_settings;
+	reference_settings.mode = MODE_PCSS;
+	reference_settings.resolution = 4096;
+	reference_settings.sampling_mode = SAMPLING_MODE_POISSON;
+	reference_settings.poisson_sample_count = 128;
+	apply_shadow_map_settings(reference_settings);
+	std::vector<std::vector<unsigned char>> reference_images;
+	render_tuning_path(frames, initial_renderables, initial_light, reference_images, true);
+
+	std::vector<tuning_result_type> results;
+	auto candidates = get_tuning_candidates(base_settings);
+	std::cout << candidates.size() << " candidates, " << frames.size() << " frames each" << std::endl;
+	for(int i = 0; i < candidates.size(); i++) {
+		apply_shadow_map_settings(candidates[i]);
+		//one untimed run, so shader compilation and allocations don't count
+		std::vector<std::vector<unsigned char>> warm_up_images;
+		render_tuning_path(frames, initial_renderables, initial_light, warm_up_images, true);
+		auto result = render_tuning_path(frames, initial_renderables, initial_light, reference_images, false);
+		results.push_back(result);
+		std::cout << i + 1 << "/" << candidates.size() << ", mode: " << result.settings.mode << ", resolution: " << result.settings.resolution << ", cascades: " << result.settings.cascade_count;
+		std::cout << ", frame time: " << result.frame_time << " ms, error: " << result.error << std::endl;
+	}
+
+	auto pareto_front = get_pareto_front(results);
+	if(!save_shadow_profile(SHADOW_PROFILE_PATH, pareto_front, quality_threshold)) {
+		return false;
+	}
+	std::cout << pareto_front.size() << " settings on the Pareto front, written to " << SHADOW_PROFILE_PATH << std::endl;
+	return true;
 }
 
 void render_ui() {
@@ -856,51 +6697,129 @@ void render_ui() {
 	ImGui::Begin("Stats", &overlay, ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoSavedSettings);
 	ImGui::Text("FPS: %.2f", time_handler.fps);
 	ImGui::Text("Frame time: %.2f ms", time_handler.average_frame_time / 1000 / 1000);
+	if(shadow_map_settings.cache_static_casters) {
+		ImGui::Text("Shadow cache hit rate: %.1f%%", shadow_cache.hit_rate * 100.0);
+		ImGui::Text("Static shadow texels rasterized: %.1f%%", shadow_cache.rasterized_texel_rate * 100.0);
+	}
+	for(int i = 0; i < get_cascade_count(); i++) {
+		ImGui::Text("Cascade %d casters: %d", i, shadow_caster_culling.caster_counts[i]);
+	}
+	ImGui::Text("Shadow views updated: %d / %d", shadow_update_scheduler.update_count, get_cascade_count());
+	ImGui::Text("Shadow pass GPU time: %.2f ms", resolution_governor.shadow_timer.time);
+	ImGui::Text("Scene pass GPU time: %.2f ms", resolution_governor.scene_timer.time);
+	ImGui::Text("Rendered shadow resolution: %d", get_rendered_resolution());
+	if(is_virtual_shadow_map_active()) {
+		auto& virtual_map = virtual_shadow_map;
+		ImGui::Text("Virtual pages requested: %d", virtual_map.requested_page_count);
+		ImGui::Text("Virtual pages rendered: %d", virtual_map.rendered_page_count);
+		ImGui::Text("Virtual pages resident: %d / %d", virtual_map.resident_page_count, PHYSICAL_PAGE_COUNT * PHYSICAL_PAGE_COUNT);
+		ImGui::Text("Virtual pages missing: %d", virtual_map.missing_page_count);
+	}
+	if(streaming.enabled) {
+		auto& stream = streaming;
+		ImGui::Text("Streamed cells: %d resident / %d", stream.resident_cell_count, static_cast<int>(stream.cells.size()));
+		ImGui::Text("Stream queue depth: %d", stream.queue_depth);
+		ImGui::Text("Stream bytes in flight: %.2f MB", stream.bytes_in_flight / (1024.0 * 1024.0));
+		ImGui::Text("Mesh GPU memory: %.2f / %.2f MB", stream.memory / (1024.0 * 1024.0), stream.budget / (1024.0 * 1024.0));
+		ImGui::Text("Evicted cells: %d", stream.evicted_cell_count);
+	}
 	ImGui::End();
 
 	ImGui::Begin("Shadow map settings");
 	const char* items[] = {"normal", "PCF", "PCSS", "VSM"};
 	if(ImGui::Combo("Type", &shadow_map_settings.mode, items, 4, -1)) {
 		set_scale();
-		create_shader_programs();
+		create_lambertian_fragment_program();
+		create_shadow_map_fragment_program();
 		create_render_targets();
 	}
-	static int shadow_map_resolution_index = 3;
+	//the indices are derived from the settings, because a loaded profile can change them
+	int shadow_map_resolution_index = static_cast<int>(glm::log2(static_cast<float>(shadow_map_settings.resolution))) - 7;
 	const char* shadow_map_resolutions[] = {"128", "256", "512", "1024", "2048", "4096"};
 	if(ImGui::Combo("Resolution", &shadow_map_resolution_index, shadow_map_resolutions, 6, -1)) {
 		shadow_map_settings.resolution = pow(2, shadow_map_resolution_index + 7);
+		resolution_governor.rendered_resolution = shadow_map_settings.resolution;
 		create_render_targets();
 	}
+	ImGui::Checkbox("Dynamic resolution", &shadow_map_settings.dynamic_resolution);
+	if(shadow_map_settings.dynamic_resolution) {
+		ImGui::SliderFloat("Target GPU time (ms)", &shadow_map_settings.target_gpu_time, 1.0, 33.0);
+		ImGui::SliderInt("Min resolution", &shadow_map_settings.min_resolution, 64, 1024);
+	}
 	ImGui::SliderFloat("Intensity", &shadow_map_settings.intensity, 0.0, 1.0);
 	if(shadow_map_settings.mode != MODE_VSM) {
 		ImGui::SliderFloat("Bias", &shadow_map_settings.bias, 0.0, 1.0);
 	}
 	if(ImGui::Checkbox("Match frustums", &shadow_map_settings.match_frustums)) {
 		set_scale();
+		create_lambertian_fragment_program();
+		create_render_targets();
+	}
+	if(shadow_map_settings.match_frustums && shadow_map_settings.mode != MODE_VSM) {
+		if(ImGui::Checkbox("Virtual shadow map", &shadow_map_settings.virtual_shadow_map)) {
+			set_scale();
+			create_lambertian_fragment_program();
+			create_render_targets();
+		}
+		if(is_virtual_shadow_map_active()) {
+			ImGui::SliderFloat("Virtual extent", &shadow_map_settings.virtual_shadow_map_extent, 64.0, 2048.0);
+		}
+	}
+	if(shadow_map_settings.match_frustums && !is_virtual_shadow_map_active()) {
+		if(ImGui::Checkbox("LiSPSM", &shadow_map_settings.lispsm)) {
+			create_shadow_map_fragment_program();
+		}
+		if(!shadow_map_settings.lispsm) {
+			ImGui::Checkbox("SDSM", &shadow_map_settings.sdsm);
+		}
+		if(!shadow_map_settings.lispsm && !shadow_map_settings.sdsm) {
+			ImGui::Checkbox("Stable fit", &shadow_map_settings.stable_fit);
+		}
+		if(ImGui::SliderInt("Cascades", &shadow_map_settings.cascade_count, 1, MAX_CASCADE_COUNT)) {
+			create_render_targets();
+		}
+		ImGui::SliderFloat("Split lambda", &shadow_map_settings.cascade_split_lambda, 0.0, 1.0);
+		ImGui::SliderFloat("Cascade blend", &shadow_map_settings.cascade_blend, 0.0, 0.5);
+		ImGui::Checkbox("Skip contained casters", &shadow_map_settings.skip_contained_casters);
+		ImGui::Checkbox("Amortized updates", &shadow_map_settings.amortized_updates);
+		if(shadow_map_settings.amortized_updates) {
+			ImGui::SliderInt("Max updates per frame", &shadow_map_settings.max_updates_per_frame, 1, MAX_CASCADE_COUNT);
+			for(int i = 0; i < shadow_map_settings.cascade_count; i++) {
+				ImGui::SliderInt(("Cascade " + std::to_string(i) + " period").c_str(), &shadow_map_settings.update_periods[i], 1, 16);
+			}
+		}
+	}
+	if(ImGui::Checkbox("Cache static casters", &shadow_map_settings.cache_static_casters)) {
+		create_render_targets();
 	}
 	if(shadow_map_settings.mode != MODE_NORMAL) {
 		ImGui::Text("Sampling");
 		if(shadow_map_settings.mode == MODE_PCF || shadow_map_settings.mode == MODE_PCSS) {
 			if(ImGui::RadioButton("Grid", &shadow_map_settings.sampling_mode, 0)) {
-				create_shader_programs();
+				create_lambertian_fragment_program();
 			}
 			ImGui::SameLine();
 			if(ImGui::RadioButton("Poisson", &shadow_map_settings.sampling_mode, 1)) {
-				create_shader_programs();
+				create_lambertian_fragment_program();
 			}
 			ImGui::SameLine();
 			if(ImGui::RadioButton("Vogel", &shadow_map_settings.sampling_mode, 2)) {
-				create_shader_programs();
+				create_lambertian_fragment_program();
 			}
 			if(shadow_map_settings.sampling_mode == SAMPLING_MODE_GRID) {
-				static int shadow_map_grid_kernel_size_index = 2;
+				int shadow_map_grid_kernel_size_index = (shadow_map_settings.grid_kernel_size - 1) / 2;
 				const char* shadow_map_grid_kernel_sizes[] = {"1x1", "3x3", "5x5", "7x7", "9x9", "11x11", "13x13"};
 				if(ImGui::Combo("Kernel size", &shadow_map_grid_kernel_size_index, shadow_map_grid_kernel_sizes, 7, -1)) {
 					shadow_map_settings.grid_kernel_size = 2 * shadow_map_grid_kernel_size_index + 1;
 				}
 			} else if(shadow_map_settings.sampling_mode == SAMPLING_MODE_POISSON) {
-				static int shadow_map_poisson_sample_count_index = 0;
 				const char* shadow_map_poisson_sample_counts[] = {"25", "32", "64", "128"};
+				int shadow_map_poisson_sample_count_index = 0;
+				for(int i = 0; i < 4; i++) {
+					if(std::to_string(shadow_map_settings.poisson_sample_count) == shadow_map_poisson_sample_counts[i]) {
+						shadow_map_poisson_sample_count_index = i;
+					}
+				}
 				if(ImGui::Combo("Sample count", &shadow_map_poisson_sample_count_index, shadow_map_poisson_sample_counts, 4, -1)) {
 					switch(shadow_map_poisson_sample_count_index) {
 						case 0: shadow_map_settings.poisson_sample_count = 25; break;
@@ -908,13 +6827,13 @@ void render_ui() {
 						case 2: shadow_map_settings.poisson_sample_count = 64; break;
 						case 3: shadow_map_settings.poisson_sample_count = 128; break;
 					}
-					create_shader_programs();
+					create_lambertian_fragment_program();
 				}
 			} else if(shadow_map_settings.sampling_mode == SAMPLING_MODE_VOGEL) {
 				ImGui::SliderInt("Sample count", &shadow_map_settings.vogel_sample_count, 1, 128);
 			}
 		} else if(shadow_map_settings.mode == MODE_VSM) {
-			static int shadow_map_gaussian_kernel_size_index = 1;
+			int shadow_map_gaussian_kernel_size_index = (shadow_map_settings.gaussian_kernel_size - 3) / 2;
 			const char* shadow_map_gaussian_kernel_sizes[] = {"3x3", "5x5", "7x7", "9x9", "11x11", "13x13"};
 			if(ImGui::Combo("Kernel size", &shadow_map_gaussian_kernel_size_index, shadow_map_gaussian_kernel_sizes, 6, -1)) {
 				switch(shadow_map_gaussian_kernel_size_index) {
@@ -925,10 +6844,13 @@ void render_ui() {
 					case 4: shadow_map_settings.gaussian_kernel_size = 11; break;
 					case 5: shadow_map_settings.gaussian_kernel_size = 13; break;
 				}
-				create_shader_programs();
+				create_gaussian_blur_fragment_program();
 			}
 		}
 		ImGui::Checkbox("Rotate samples", &shadow_map_settings.rotate_samples);
+		if(ImGui::SliderFloat("Filter scale", &shadow_map_settings.filter_scale, 0.25, 4.0)) {
+			set_scale();
+		}
 	}
 	if(shadow_map_settings.mode == MODE_VSM) {
 		ImGui::Checkbox("Smoothstep fix", &shadow_map_settings.vsm_smoothstep_fix);
@@ -943,14 +6865,259 @@ void render_ui() {
 	if(shadow_map_settings.mode != MODE_NORMAL) {
 		ImGui::SliderFloat("Light size", &light.size, 0.0, 10.0);
 	}
+	ImGui::Checkbox("Time of day", &light.time_of_day);
+	if(light.time_of_day) {
+		ImGui::SliderFloat("Time of day speed", &light.time_of_day_speed, 0.0, 10.0);
+	}
+	ImGui::End();
+
+	ImGui::Begin("Shadowed lights");
+	ImGui::Text("Atlas tiles: %d", static_cast<int>(shadow_atlas.tiles.size()));
+	ImGui::Text("Atlas tiles rendered: %d", shadow_atlas.rendered_tile_count);
+	ImGui::Text("Atlas repacks: %d, evicted tiles: %d", shadow_atlas.repack_count, shadow_atlas.evicted_tile_count);
+	ImGui::Text("Point shadow cubes rendered: %d", point_shadow_maps.rendered_cube_count);
+	ImGui::Text("Point shadow caster faces: %d of %d", point_shadow_maps.rendered_face_count, point_shadow_maps.naive_face_count);
+	ImGui::Text("Lights: %d", shadowed_light_count);
+	for(auto& shadowed_light : shadowed_lights) {
+		if(!shadowed_light.casts_shadow) {
+			continue;
+		}
+		ImGui::Checkbox(shadowed_light.name.c_str(), &shadowed_light.enabled);
+		ImGui::SameLine();
+		ImGui::Text("%d", shadowed_light.resolution);
+	}
+	if(ImGui::Button("Add spot light")) {
+		shadowed_light_type spot_light;
+		spot_light.name = "spot " + std::to_string(shadowed_lights.size());
+		spot_light.position = player.position;
+		spot_light.direction = player.forward;
+		shadowed_lights.push_back(spot_light);
+	}
+	ImGui::SameLine();
+	if(ImGui::Button("Add point light")) {
+		shadowed_light_type point_light;
+		point_light.name = "point " + std::to_string(shadowed_lights.size());
+		point_light.type = LIGHT_TYPE_POINT;
+		point_light.position = player.position;
+		point_light.range = 30.0;
+		shadowed_lights.push_back(point_light);
+	}
+	if(ImGui::Button("Add 100 lights without shadows")) {
+		//scattered around the player, they only cost the fragments of the clusters they reach
+		for(int i = 0; i < 100; i++) {
+			auto random = glm::vec3(std::rand(), std::rand(), std::rand()) / static_cast<float>(RAND_MAX);
+			shadowed_light_type point_light;
+			point_light.name = "point " + std::to_string(shadowed_lights.size());
+			point_light.type = LIGHT_TYPE_POINT;
+			point_light.position = player.position + glm::vec3(random.x * 120.0f - 60.0f, 0.0, random.z * 120.0f - 60.0f);
+			point_light.position.y = 2.0f + random.y * 10.0f;
+			point_light.color = glm::vec3(random.y, random.z, random.x);
+			point_light.range = 10.0f + random.x * 10.0f;
+			point_light.casts_shadow = false;
+			shadowed_lights.push_back(point_light);
+		}
+	}
+	ImGui::Image((ImTextureID) shadow_atlas.depth_texture, ImVec2(256, 256), ImVec2(0, 1), ImVec2(1, 0));
+	ImGui::End();
+
+	ImGui::Begin("Camera path");
+	if(ImGui::Checkbox("Record", &camera_path_recorder.recording)) {
+		if(camera_path_recorder.recording) {
+			camera_path_recorder.frames.clear();
+		} else {
+			save_camera_path(CAMERA_PATH_PATH, camera_path_recorder.frames);
+		}
+	}
+	ImGui::Text("Recorded frames: %d", static_cast<int>(camera_path_recorder.frames.size()));
+	ImGui::End();
+
+	ImGui::Begin("Renderables");
+	ImGui::Checkbox("Spin dynamic renderables", &scene_settings.spin_dynamic_renderables);
+	auto removed_renderable = -1;
+	//a stress scene has too many renderables for a row each, only the visible rows are built
+	ImGui::BeginChild("Renderable list", ImVec2(0.0f, 200.0f), true);
+	ImGuiListClipper clipper;
+	clipper.Begin(renderables.size());
+	while(clipper.Step()) {
+		for(int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+			auto& renderable = renderables[i];
+			ImGui::PushID(i);
+			if(ImGui::Checkbox("Static", &renderable.is_static)) {
+				invalidate_static_shadow_casters();
+			}
+			ImGui::SameLine();
+			if(ImGui::Checkbox("Shadows", &renderable.casts_shadows)) {
+				invalidate_static_shadow_casters();
+			}
+			ImGui::SameLine();
+			if(ImGui::Button("Remove")) {
+				removed_renderable = i;
+			}
+			ImGui::SameLine();
+			ImGui::Text("%s, LOD %d/%d, shadow LOD %d", renderable.name.c_str(), renderable.lod, renderable.mesh.lod_count, renderable.shadow_lod);
+			ImGui::PopID();
+		}
+	}
+	ImGui::EndChild();
+	if(removed_renderable != -1) {
+		remove_renderable(removed_renderable);
+	}
+	if(ImGui::Button("Add helmet")) {
+		static int helmet_count = 0;
+		helmet_count++;
+		renderable_type helmet;
+		helmet.name = "helmet " + std::to_string(helmet_count + 1);
+		helmet.position = glm::vec3(10.0f * helmet_count, 10.0, -50.0);
+		helmet.scale = glm::vec3(10.0);
+		helmet.rotation = glm::angleAxis(glm::radians(-90.0f), glm::vec3(0.0, 1.0, 0.0));
+		add_renderable(helmet, get_mesh_asset("res/mesh/DamagedHelmet.glb"));
+	}
+	ImGui::Separator();
+	auto& scene = scene_settings;
+	if(ImGui::BeginCombo("Layout", get_scene_layout_name(scene.layout).c_str())) {
+		for(int layout = SCENE_LAYOUT_GRID; layout <= SCENE_LAYOUT_CITY; layout++) {
+			if(ImGui::Selectable(get_scene_layout_name(layout).c_str(), scene.layout == layout)) {
+				scene.layout = layout;
+			}
+		}
+		ImGui::EndCombo();
+	}
+	ImGui::SliderInt("Instances", &scene.instance_count, MIN_GENERATED_INSTANCE_COUNT, MAX_GENERATED_INSTANCE_COUNT, "%d", ImGuiSliderFlags_Logarithmic);
+	ImGui::InputInt("Seed", &scene.seed);
+	ImGui::SliderFloat("Caster density", &scene.caster_density, 0.0f, 1.0f);
+	ImGui::SliderFloat("Spacing", &scene.spacing, 1.0f, 20.0f);
+	if(ImGui::Button("Generate")) {
+		generate_scene();
+	}
+	ImGui::InputText("Scene", scene.path, sizeof(scene.path));
+	if(ImGui::Button("Save scene")) {
+		save_scene(scene.path);
+	}
+	ImGui::SameLine();
+	if(ImGui::Button("Load scene")) {
+		load_scene(scene.path);
+	}
+	auto streamed = streaming.enabled;
+	if(ImGui::Checkbox("Stream cells", &streamed)) {
+		set_streaming(streamed);
+	}
+	ImGui::SliderFloat("Stream radius", &streaming.load_radius, STREAM_CELL_SIZE, 2000.0f);
+	ImGui::SliderFloat("Stream lookahead (s)", &streaming.lookahead, 0.0f, 5.0f);
+	auto streaming_budget = static_cast<int>(streaming.budget / (1024 * 1024));
+	if(ImGui::SliderInt("Stream mesh GPU budget (MB)", &streaming_budget, 1, 1024)) {
+		streaming.budget = static_cast<GLsizeiptr>(streaming_budget) * 1024 * 1024;
+	}
+	ImGui::Text("Renderables: %d, pending: %d, last load: %.2f ms", static_cast<int>(renderables.size()), static_cast<int>(asset_loader.pending_renderables.size()), scene.load_time);
+	if(scene_store.instance_buffer != 0) {
+		ImGui::Text("Scene file instances: %d, meshes waiting: %d, edited: %d", static_cast<int>(scene_store.instance_count), scene_store.pending_mesh_count, static_cast<int>(scene_store.edited_instances.size()));
+		//only the edited instances become renderables, the others are drawn from the file's records
+		static int edited_instance = 0;
+		ImGui::InputInt("Scene file instance", &edited_instance);
+		ImGui::SameLine();
+		if(ImGui::Button("Edit")) {
+			edit_scene_store_instance(edited_instance);
+		}
+	}
+	ImGui::Separator();
+	//the cached static shadows were rendered with the static casters' old lods
+	if(ImGui::Checkbox("LODs", &lod_settings.enabled)) {
+		invalidate_static_shadow_casters();
+	}
+	ImGui::SliderFloat("LOD pixel error", &lod_settings.pixel_error, 0.25f, 8.0f);
+	if(ImGui::SliderFloat("Shadow LOD texel error", &lod_settings.shadow_texel_error, 0.5f, 8.0f)) {
+		invalidate_static_shadow_casters();
+	}
+	ImGui::SliderFloat("LOD hysteresis", &lod_settings.hysteresis, 0.0f, 0.9f);
+	ImGui::Text("Triangles: %lld, in the shadow maps: %lld per view, without LODs: %lld", lod_settings.triangle_count, lod_settings.shadow_triangle_count, lod_settings.full_triangle_count);
+	ImGui::Checkbox("Meshlet culling", &meshlet_culling.enabled);
+	ImGui::Text("Meshlets tested: %d by the camera, %d by the cascades", meshlet_culling.camera_meshlet_count, meshlet_culling.shadow_meshlet_count);
+	ImGui::Separator();
+	auto& loader = asset_loader;
+	auto budget = static_cast<int>(loader.gpu_budget / (1024 * 1024));
+	if(ImGui::SliderInt("Mesh budget (MB)", &budget, 1, 1024)) {
+		loader.gpu_budget = static_cast<GLsizeiptr>(budget) * 1024 * 1024;
+	}
+	ImGui::Text("Mesh memory: %.2f MB, evicted meshes: %d", loader.gpu_size / (1024.0 * 1024.0), loader.evicted_mesh_count);
+	if(ImGui::Button("Unload unused meshes")) {
+		evict_meshes(0);
+	}
+	for(auto& asset : loader.mesh_assets) {
+		ImGui::Text("%s: %s, %d meshes, %d instances, %d references, %.2f MB", asset.path.c_str(), get_asset_state_name(asset.state).c_str(), static_cast<int>(asset.meshes.size()), static_cast<int>(asset.instances.size()), asset.reference_count, asset.gpu_size / (1024.0 * 1024.0));
+		if(asset.state == ASSET_STATE_FAILED) {
+			ImGui::TextWrapped("%s", asset.error.c_str());
+		}
+	}
+	ImGui::End();
+
+	ImGui::Begin("GPU memory");
+	auto& registry = gpu_memory_registry;
+	auto gpu_budget = static_cast<int>(registry.budget / (1024 * 1024));
+	if(ImGui::SliderInt("Budget (MB)", &gpu_budget, 64, 8192)) {
+		registry.budget = static_cast<GLsizeiptr>(gpu_budget) * 1024 * 1024;
+		registry.over_budget = registry.size > registry.budget;
+	}
+	if(registry.over_budget) {
+		ImGui::TextColored(ImVec4(1.0f, 0.2f, 0.2f, 1.0f), "Over the budget");
+	}
+	ImGui::Text("Total: %.2f MB, peak: %.2f MB, objects: %d", registry.size / (1024.0 * 1024.0), registry.peak_size / (1024.0 * 1024.0), static_cast<int>(registry.resources.size()));
+	for(int i = 0; i < GPU_CATEGORY_COUNT; i++) {
+		ImGui::Text("%s: %.2f MB", get_gpu_category_name(i).c_str(), registry.category_sizes[i] / (1024.0 * 1024.0));
+	}
+	auto& pool = render_target_pool;
+	auto used_target_count = 0;
+	GLsizeiptr idle_size = 0;
+	for(auto& target : pool.targets) {
+		used_target_count += target.in_use;
+		auto iterator = registry.resources.find(get_gpu_resource_key(GL_TEXTURE, target.texture));
+		idle_size += !target.in_use && iterator != registry.resources.end() ? iterator->second.size : 0;
+	}
+	ImGui::Text("Pooled render targets: %d, in use: %d, idle: %.2f MB, allocations: %d, reuses: %d", static_cast<int>(pool.targets.size()), used_target_count, idle_size / (1024.0 * 1024.0), pool.allocation_count, pool.reuse_count);
+	if(ImGui::BeginTable("GPU resources", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_Resizable | ImGuiTableFlags_ScrollY, ImVec2(0.0f, 300.0f))) {
+		ImGui::TableSetupScrollFreeze(0, 1);
+		ImGui::TableSetupColumn("Name");
+		ImGui::TableSetupColumn("Category");
+		ImGui::TableSetupColumn("Format");
+		ImGui::TableSetupColumn("Usage");
+		ImGui::TableSetupColumn("Size (KB)");
+		ImGui::TableHeadersRow();
+		//the biggest first
+		std::vector<const gpu_resource_type*> resources;
+		for(auto& entry : registry.resources) {
+			resources.push_back(&entry.second);
+		}
+		std::sort(resources.begin(), resources.end(), [](const gpu_resource_type* a, const gpu_resource_type* b) {
+			return a->size > b->size;
+		});
+		ImGuiListClipper resource_clipper;
+		resource_clipper.Begin(resources.size());
+		while(resource_clipper.Step()) {
+			for(int i = resource_clipper.DisplayStart; i < resource_clipper.DisplayEnd; i++) {
+				auto& resource = *resources[i];
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(resource.name.c_str());
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(get_gpu_category_name(resource.category).c_str());
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(get_format_name(resource.format).c_str());
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(resource.usage.c_str());
+				ImGui::TableNextColumn();
+				ImGui::Text("%.1f", resource.size / 1024.0);
+			}
+		}
+		ImGui::EndTable();
+	}
 	ImGui::End();
 
 	ImGui::Begin("Shadow map");
-	if(shadow_map_settings.mode == MODE_VSM) {
-		ImGui::Image((ImTextureID) shadow_color_texture, ImVec2(256, 256), ImVec2(0, 1), ImVec2(1, 0));
-		ImGui::Image((ImTextureID) shadow_color_texture_2, ImVec2(256, 256), ImVec2(0, 1), ImVec2(1, 0));
+	if(is_virtual_shadow_map_active()) {
+		ImGui::Image((ImTextureID) virtual_shadow_map.physical_texture, ImVec2(512, 512), ImVec2(0, 1), ImVec2(1, 0));
 	} else {
-		ImGui::Image((ImTextureID) shadow_depth_texture, ImVec2(256, 256), ImVec2(0, 1), ImVec2(1, 0));
+		for(auto preview_texture : shadow_map_preview_textures) {
+			auto uv_scale = get_uv_scale();
+			ImGui::Image((ImTextureID) preview_texture, ImVec2(256, 256), ImVec2(0, uv_scale), ImVec2(uv_scale, 0));
+		}
 	}
 	ImGui::End();
 
@@ -958,26 +7125,263 @@ void render_ui() {
 	ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
 
+void update_streaming() {
+	auto& stream = streaming;
+	auto& loader = asset_loader;
+	if(!stream.enabled) {
+		return;
+	}
+	//the cells ahead of the player are loaded first, the velocity predicts where the player is going to be
+	stream.velocity = time_handler.delta_time > 0.0 ? (player.position - stream.last_player_position) / static_cast<float>(time_handler.delta_time) : glm::vec3(0.0);
+	stream.last_player_position = player.position;
+	auto predicted_position = player.position + stream.velocity * stream.lookahead;
+	std::vector<glm::vec4> frustum_planes;
+	get_frustum_planes(player.projection * player.view, true, frustum_planes);
+
+	//a loading cell is resident when none of its renderables waits for its mesh
+	std::vector<int> pending_counts(stream.cells.size(), 0);
+	for(auto& renderable : loader.pending_renderables) {
+		if(renderable.cell != -1) {
+			pending_counts[renderable.cell]++;
+		}
+	}
+	std::vector<std::pair<float, int>> queue;
+	std::vector<bool> wanted(stream.cells.size(), false);
+	stream.resident_cell_count = 0;
+	auto loading_cell_count = 0;
+	for(int i = 0; i < stream.cells.size(); i++) {
+		auto& cell = stream.cells[i];
+		if(cell.state == CELL_STATE_LOADING && pending_counts[i] == 0) {
+			cell.state = CELL_STATE_RESIDENT;
+		}
+		auto center = (cell.aabb_min + cell.aabb_max) * 0.5f;
+		auto radius = glm::distance(cell.aabb_min, cell.aabb_max) * 0.5f + cell.margin;
+		auto predicted_distance = glm::distance(center, predicted_position);
+		auto distance = min(glm::distance(center, player.position), predicted_distance) - radius;
+		wanted[i] = distance < stream.load_radius;
+		auto visible = std::all_of(frustum_planes.begin(), frustum_planes.end(), [&](const glm::vec4& plane) {
+			return glm::dot(glm::vec3(plane), center) + plane.w >= -radius;
+		});
+		if(wanted[i] && visible) {
+			cell.last_visible_frame = loader.frame;
+		}
+		if(wanted[i] && cell.state == CELL_STATE_UNLOADED) {
+			queue.push_back(std::make_pair(predicted_distance, i));
+		}
+		if(cell.state == CELL_STATE_LOADING) {
+			loading_cell_count++;
+		} else if(cell.state == CELL_STATE_RESIDENT) {
+			stream.resident_cell_count++;
+		}
+	}
+
+	//a few cells per frame, the meshes are imported and uploaded by the asset loader, so nothing waits here
+	std::sort(queue.begin(), queue.end());
+	auto loaded_cell_count = min(static_cast<int>(queue.size()), STREAM_CELLS_PER_FRAME);
+	for(int i = 0; i < loaded_cell_count; i++) {
+		load_stream_cell(queue[i].second);
+	}
+	stream.queue_depth = queue.size() + loading_cell_count;
+
+	//over the budget, the least recently visible cell the player doesn't need is evicted, one per frame
+	stream.memory = loader.gpu_size;
+	if(stream.memory > stream.budget) {
+		auto evicted = -1;
+		for(int i = 0; i < stream.cells.size(); i++) {
+			auto& cell = stream.cells[i];
+			if(!wanted[i] && cell.state != CELL_STATE_UNLOADED && (evicted == -1 || cell.last_visible_frame < stream.cells[evicted].last_visible_frame)) {
+				evicted = i;
+			}
+		}
+		if(evicted != -1) {
+			evict_stream_cell(evicted);
+			evict_meshes(stream.budget);
+		}
+	}
+
+	//the imported meshes waiting for the staging buffer, and the copies the gpu hasn't finished yet
+	stream.bytes_in_flight = 0;
+	for(auto& asset : loader.mesh_assets) {
+		if(asset.state == ASSET_STATE_IMPORTED) {
+			for(auto& buffer : asset.data.buffers) {
+				stream.bytes_in_flight += buffer.size;
+			}
+		}
+	}
+	for(auto& region : loader.staging_regions) {
+		stream.bytes_in_flight += region.size;
+	}
+}
+
 void run() {
 	while(!glfwWindowShouldClose(window.handler)) {
 		handle_time();
+		update_assets();
+		update_resolution_governor();
 		handle_input();
+		record_camera_path();
+		update_streaming();
+		update_render_target_pool();
+		update_renderables();
+		update_light();
 		compute_matrices();
+		update_lods();
+		begin_gpu_timer(resolution_governor.shadow_timer);
 		render_shadow_map();
+		end_gpu_timer(resolution_governor.shadow_timer);
+		begin_gpu_timer(resolution_governor.scene_timer);
 		render_geometry();
+		end_gpu_timer(resolution_governor.scene_timer);
+		if(shadow_map_settings.match_frustums && shadow_map_settings.sdsm) {
+			reduce_scene_depth();
+		}
+		if(is_virtual_shadow_map_active()) {
+			mark_virtual_pages();
+		}
+		present_scene();
 		render_ui();
 		glfwSwapBuffers(window.handler);
 		glfwPollEvents();
 	}
 }
 
-void initialize() {
-	create_window();
+void reload_meshes(const bool quantize_vertices) {
+	//every renderable is removed and added again, and the loaded scene's meshes are released, so the meshes are evicted and imported in the new format
+	mesh_cache.quantize_vertices = quantize_vertices;
+	auto scene_renderables = renderables;
+	while(!renderables.empty()) {
+		remove_renderable(renderables.size() - 1);
+	}
+	release_scene_store_meshes();
+	evict_meshes(0);
+	for(auto& renderable : scene_renderables) {
+		add_renderable(renderable, renderable.mesh_asset);
+	}
+	acquire_scene_store_meshes();
+	wait_for_assets();
+}
+
+void measure_passes(const int frame_count, double& shadow_time, double& scene_time) {
+	GLuint queries[2];
+	glCreateQueries(GL_TIME_ELAPSED, 2, queries);
+	shadow_time = 0.0;
+	scene_time = 0.0;
+	//the first frames compile and allocate, they aren't timed
+	auto warm_up_frame_count = 10;
+	for(int i = 0; i < warm_up_frame_count + frame_count; i++) {
+		update_render_target_pool();
+		update_renderables();
+		update_light();
+		compute_matrices();
+		update_lods();
+		glBeginQuery(GL_TIME_ELAPSED, queries[0]);
+		render_shadow_map();
+		glEndQuery(GL_TIME_ELAPSED);
+		glBeginQuery(GL_TIME_ELAPSED, queries[1]);
+		render_geometry();
+		glEndQuery(GL_TIME_ELAPSED);
+		if(shadow_map_settings.match_frustums && shadow_map_settings.sdsm) {
+			reduce_scene_depth();
+		}
+		if(is_virtual_shadow_map_active()) {
+			mark_virtual_pages();
+		}
+		GLuint64 elapsed_times[2];
+		glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &elapsed_times[0]);
+		glGetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &elapsed_times[1]);
+		if(i >= warm_up_frame_count) {
+			shadow_time += elapsed_times[0] / 1000.0 / 1000.0 / frame_count;
+			scene_time += elapsed_times[1] / 1000.0 / 1000.0 / frame_count;
+		}
+	}
+	glDeleteQueries(2, queries);
+}
+
+void disable_shadow_caching() {
+	//caching and amortization would hide the cost of the passes
+	auto settings = shadow_map_settings;
+	settings.cache_static_casters = false;
+	settings.amortized_updates = false;
+	settings.dynamic_resolution = false;
+	apply_shadow_map_settings(settings);
+	time_handler.delta_time = 1.0 / 60.0;
+}
+
+void benchmark_vertex_formats(const int frame_count) {
+	wait_for_assets();
+	disable_shadow_caching();
+	for(auto quantize_vertices : {true, false}) {
+		reload_meshes(quantize_vertices);
+		GLsizeiptr vertex_size = 0;
+		for(auto& asset : asset_loader.mesh_assets) {
+			vertex_size += asset.vertex_gpu_size;
+		}
+		double shadow_time;
+		double scene_time;
+		measure_passes(frame_count, shadow_time, scene_time);
+		std::cout << "BENCHMARK, " << (quantize_vertices ? "quantized" : "float") << " vertices: " << vertex_size / 1024.0 << " KB, ";
+		std::cout << "shadow pass: " << shadow_time << " ms, scene pass: " << scene_time << " ms" << std::endl;
+	}
+}
+
+void benchmark_scene_scaling(const int max_instance_count, const int frame_count) {
+	//every layout at every power of 10, the lines are comma separated, so they can be plotted as they are
+	disable_shadow_caching();
+	std::cout << "BENCHMARK, layout, objects, shadow casters, triangles, shadow triangles, load ms, shadow pass ms, scene pass ms" << std::endl;
+	for(int layout = SCENE_LAYOUT_GRID; layout <= SCENE_LAYOUT_CITY; layout++) {
+		for(int instance_count = MIN_GENERATED_INSTANCE_COUNT; instance_count <= max_instance_count; instance_count *= 10) {
+			scene_settings.layout = layout;
+			scene_settings.instance_count = instance_count;
+			generate_scene();
+			if(!save_scene(BENCHMARK_SCENE_PATH) || !load_scene(BENCHMARK_SCENE_PATH)) {
+				return;
+			}
+			wait_for_assets();
+			double shadow_time;
+			double scene_time;
+			measure_passes(frame_count, shadow_time, scene_time);
+			//the ground is the only renderable, the instances are drawn from the loaded file
+			auto object_count = renderables.size() + scene_store.instance_count;
+			auto caster_count = std::count_if(renderables.begin(), renderables.end(), [](const renderable_type& renderable) {
+				return renderable.casts_shadows;
+			});
+			for(int i = 0; i < scene_store.mesh_assets.size(); i++) {
+				caster_count += get_scene_store_instance_count(i, SCENE_STORE_RANGE_STATIC_CASTER, SCENE_STORE_RANGE_DYNAMIC_CASTER);
+			}
+			std::cout << "BENCHMARK, " << get_scene_layout_name(layout) << ", " << object_count << ", " << caster_count << ", " << lod_settings.triangle_count << ", ";
+			std::cout << lod_settings.shadow_triangle_count << ", " << scene_settings.load_time << ", " << shadow_time << ", " << scene_time << std::endl;
+			if(instance_count > MAX_GENERATED_INSTANCE_COUNT / 10) {
+				break;
+			}
+		}
+	}
+}
+
+bool initialize(const bool headless) {
+	create_window(headless);
 	initialize_opengl();
+	create_worker_pool(worker_pool, max(std::thread::hardware_concurrency(), 2u) - 1);
+	create_worker_pool(asset_worker_pool, ASSET_WORKER_COUNT);
 	initialize_imgui();
+	if(!headless) {
+		load_shadow_profile(SHADOW_PROFILE_PATH);
+		set_scale();
+	}
 	create_shader_programs();
-	create_renderables();
+	create_asset_loader();
+	//everything is still created on a failure, so destroy can release it as usual
+	auto renderables_created = create_renderables();
+	create_shadowed_lights();
+	create_scene_render_targets();
+	create_sdsm_buffers();
+	create_virtual_shadow_map_buffers();
+	create_shadow_atlas();
+	create_point_shadow_maps();
+	create_light_clusters();
+	create_gpu_timer(resolution_governor.shadow_timer);
+	create_gpu_timer(resolution_governor.scene_timer);
 	create_render_targets();
+	return renderables_created;
 }
 
 void destroy_imgui() {
@@ -987,16 +7391,61 @@ void destroy_imgui() {
 }
 
 void destroy_opengl() {
-	glDeleteTextures(1, &shadow_color_texture);
-	glDeleteTextures(1, &shadow_color_texture_2);
-	glDeleteTextures(1, &shadow_depth_texture);
-	glDeleteFramebuffers(1, &shadow_map_fbo);
-	for(auto& renderable : renderables) {
-		glDeleteVertexArrays(1, &renderable.mesh.vao);
+	delete_gpu_resources(GL_FRAMEBUFFER, 1, &shadow_map_fbo);
+	delete_gpu_resources(GL_FRAMEBUFFER, 1, &blur_fbo);
+	delete_gpu_resources(GL_TEXTURE, shadow_map_preview_textures.size(), shadow_map_preview_textures.data());
+	delete_gpu_resources(GL_FRAMEBUFFER, 1, &static_shadow_map_fbo);
+	destroy_pipeline(shadow_map_pipeline);
+	destroy_pipeline(lambertian_pipeline);
+	destroy_pipeline(scene_store_shadow_pipeline);
+	destroy_pipeline(scene_store_pipeline);
+	destroy_pipeline(gaussian_blur_pipeline);
+	destroy_pipeline(sdsm_pipeline);
+	destroy_gpu_timer(resolution_governor.shadow_timer);
+	destroy_gpu_timer(resolution_governor.scene_timer);
+	for(int i = 0; i < 2; i++) {
+		glDeleteSync(sdsm.fences[i]);
+		glUnmapNamedBuffer(sdsm.buffers[i]);
 	}
-	glDeleteProgram(shadow_map_program);
-	glDeleteProgram(lambertian_program);
-	glDeleteProgram(gaussian_blur_program);
+	delete_gpu_resources(GL_BUFFER, 2, sdsm.buffers);
+	delete_gpu_resources(GL_TEXTURE, 1, &scene_color_texture);
+	delete_gpu_resources(GL_TEXTURE, 1, &scene_depth_texture);
+	delete_gpu_resources(GL_FRAMEBUFFER, 1, &scene_fbo);
+	destroy_dynamic_buffer(shadow_caster_culling.draw_buffer);
+	destroy_dynamic_buffer(shadow_caster_culling.indirect_buffer);
+	destroy_pipeline(virtual_shadow_map_pipeline);
+	destroy_pipeline(virtual_page_marking_pipeline);
+	for(int i = 0; i < 2; i++) {
+		glDeleteSync(virtual_shadow_map.fences[i]);
+		glUnmapNamedBuffer(virtual_shadow_map.request_buffers[i]);
+	}
+	delete_gpu_resources(GL_BUFFER, 2, virtual_shadow_map.request_buffers);
+	delete_gpu_resources(GL_TEXTURE, 1, &virtual_shadow_map.page_table_texture);
+	delete_gpu_resources(GL_FRAMEBUFFER, 1, &virtual_shadow_map.fbo);
+	destroy_dynamic_buffer(virtual_shadow_map.draw_buffer);
+	destroy_dynamic_buffer(virtual_shadow_map.indirect_buffer);
+	destroy_pipeline(shadow_atlas_pipeline);
+	delete_gpu_resources(GL_TEXTURE, 1, &shadow_atlas.depth_texture);
+	delete_gpu_resources(GL_FRAMEBUFFER, 1, &shadow_atlas.fbo);
+	destroy_dynamic_buffer(shadow_atlas.light_buffer);
+	destroy_dynamic_buffer(shadow_atlas.draw_buffer);
+	destroy_dynamic_buffer(shadow_atlas.indirect_buffer);
+	destroy_pipeline(point_shadow_map_pipeline);
+	delete_gpu_resources(GL_TEXTURE, 1, &point_shadow_maps.depth_texture);
+	delete_gpu_resources(GL_FRAMEBUFFER, 1, &point_shadow_maps.fbo);
+	destroy_dynamic_buffer(point_shadow_maps.draw_buffer);
+	destroy_dynamic_buffer(point_shadow_maps.indirect_buffer);
+	destroy_pipeline(light_culling_pipeline);
+	delete_gpu_resources(GL_BUFFER, 1, &light_clusters.cluster_buffer);
+	delete_gpu_resources(GL_BUFFER, 1, &light_clusters.light_index_buffer);
+	delete_gpu_resources(GL_BUFFER, 1, &light_clusters.light_index_count_buffer);
+	destroy_pipeline(meshlet_culling_pipeline);
+	destroy_dynamic_buffer(meshlet_culling.camera_buffers.command_buffer);
+	destroy_dynamic_buffer(meshlet_culling.camera_buffers.count_buffer);
+	destroy_dynamic_buffer(meshlet_culling.shadow_buffers.command_buffer);
+	destroy_dynamic_buffer(meshlet_culling.shadow_buffers.count_buffer);
+	destroy_render_target_pool();
+	destroy_asset_loader();
 }
 
 void destroy_window() {
@@ -1005,13 +7454,130 @@ void destroy_window() {
 }
 
 void destroy() {
+	//the running imports finish first, so nothing writes the assets while they are released
+	destroy_worker_pool(asset_worker_pool);
 	destroy_imgui();
 	destroy_opengl();
 	destroy_window();
+	destroy_worker_pool(worker_pool);
+}
+
+bool parse_int(const std::string& text, int& value) {
+	try {
+		size_t length;
+		value = std::stoi(text, &length);
+		return length == text.size();
+	} catch(const std::exception&) {
+		return false;
+	}
+}
+
+bool parse_float(const std::string& text, float& value) {
+	try {
+		size_t length;
+		value = std::stof(text, &length);
+		return length == text.size();
+	} catch(const std::exception&) {
+		return false;
+	}
 }
 
-int main() {
-	initialize();
+int main(int argc, char** argv) {
+	//--no-mesh-cache imports the meshes with assimp on every start, to compare the startup times
+	for(int i = 1; i < argc; i++) {
+		if(std::string(argv[i]) == "--no-mesh-cache") {
+			mesh_cache.enabled = false;
+		}
+		if(std::string(argv[i]) == "--no-vertex-quantization") {
+			mesh_cache.quantize_vertices = false;
+		}
+		//--scene path loads a scene instead of the demo, --generate-scene layout count [seed] generates one, --save-scene path saves the result
+		if(std::string(argv[i]) == "--scene" && i + 1 < argc) {
+			scene_settings.load_path = argv[i + 1];
+		}
+		if(std::string(argv[i]) == "--generate-scene" && i + 2 < argc) {
+			scene_settings.generate = true;
+			scene_settings.layout = get_scene_layout(argv[i + 1]);
+			auto valid = parse_int(argv[i + 2], scene_settings.instance_count);
+			if(i + 3 < argc && argv[i + 3][0] != '-') {
+				valid = valid && parse_int(argv[i + 3], scene_settings.seed);
+			}
+			if(!valid) {
+				std::cout << "Usage: --generate-scene layout count [seed]" << std::endl;
+				return 1;
+			}
+		}
+		if(std::string(argv[i]) == "--save-scene" && i + 1 < argc) {
+			scene_settings.save_path = argv[i + 1];
+		}
+		//--gpu-memory-budget megabytes ends the program when the gl objects take more
+		if(std::string(argv[i]) == "--gpu-memory-budget" && i + 1 < argc) {
+			int megabytes;
+			if(!parse_int(argv[i + 1], megabytes) || megabytes <= 0) {
+				std::cout << "Usage: --gpu-memory-budget megabytes" << std::endl;
+				return 1;
+			}
+			gpu_memory_registry.budget = static_cast<GLsizeiptr>(megabytes) * 1024 * 1024;
+			gpu_memory_registry.strict = true;
+		}
+		//--stream-cells puts the loaded or generated scene into cells, which are streamed in around the player
+		if(std::string(argv[i]) == "--stream-cells") {
+			streaming.enabled = true;
+		}
+	}
+	//--tune [camera path] [quality threshold] renders the camera path with every setting and writes a profile
+	if(argc >= 2 && std::string(argv[1]) == "--tune") {
+		auto camera_path = argc >= 3 ? std::string(argv[2]) : CAMERA_PATH_PATH;
+		auto quality_threshold = 0.02f;
+		if(argc >= 4 && !parse_float(argv[3], quality_threshold)) {
+			std::cout << "Usage: --tune [camera path] [quality threshold]" << std::endl;
+			return 1;
+		}
+		if(!initialize(true)) {
+			destroy();
+			return 1;
+		}
+		auto tuned = tune(camera_path, quality_threshold);
+		destroy();
+		return tuned ? 0 : 1;
+	}
+	//--benchmark-vertex-formats [frame count] measures both passes with quantized and with float vertices
+	if(argc >= 2 && std::string(argv[1]) == "--benchmark-vertex-formats") {
+		auto frame_count = 300;
+		if(argc >= 3 && (!parse_int(argv[2], frame_count) || frame_count <= 0)) {
+			std::cout << "Usage: --benchmark-vertex-formats [frame count]" << std::endl;
+			return 1;
+		}
+		if(!initialize(true)) {
+			destroy();
+			return 1;
+		}
+		benchmark_vertex_formats(frame_count);
+		destroy();
+		return 0;
+	}
+	//--benchmark-scene-scaling [max count] [frame count] loads a saved scene of every layout at growing instance counts, and measures both passes
+	if(argc >= 2 && std::string(argv[1]) == "--benchmark-scene-scaling") {
+		auto max_instance_count = 100000;
+		auto frame_count = 100;
+		auto valid = !(argc >= 3 && argv[2][0] != '-') || parse_int(argv[2], max_instance_count);
+		valid = valid && (!(argc >= 4 && argv[3][0] != '-') || (parse_int(argv[3], frame_count) && frame_count > 0));
+		if(!valid) {
+			std::cout << "Usage: --benchmark-scene-scaling [max count] [frame count]" << std::endl;
+			return 1;
+		}
+		if(!initialize(true)) {
+			destroy();
+			return 1;
+		}
+		benchmark_scene_scaling(glm::clamp(max_instance_count, MIN_GENERATED_INSTANCE_COUNT, MAX_GENERATED_INSTANCE_COUNT), frame_count);
+		destroy();
+		return 0;
+	}
+	if(!initialize(false)) {
+		destroy();
+		return 1;
+	}
 	run();
 	destroy();
 }
@@ -0,0 +1,9 @@
+layout(location = 0) in vec3 io_ws_position;
+
+uniform vec3 u_light_position;
+uniform float u_range;
+
+void main(){
+	//the distance from the light is stored, so the receivers can compare in any direction without knowing the face
+	gl_FragDepth = distance(io_ws_position, u_light_position) / u_range;
+}
@@ -0,0 +1,20 @@
+layout(location = 0) in vec3 i_position;
+
+struct draw_type {
+	mat4 model;
+	//the faces of the cube that the caster's bounds overlap
+	uint face_mask;
+};
+
+layout(std430, binding = 0) readonly buffer draw_buffer {
+	draw_type draws[];
+};
+
+layout(location = 0) out vec3 io_ws_position;
+layout(location = 1) flat out uint io_face_mask;
+
+void main() {
+	draw_type draw = draws[gl_BaseInstance];
+	io_ws_position = vec3(draw.model * vec4(i_position, 1.0));
+	io_face_mask = draw.face_mask;
+}
@@ -1,6 +1,7 @@
-in vec2 io_texture_coordinates;
+layout(location = 0) in vec2 io_texture_coordinates;
 
-uniform sampler2D u_image;
+uniform sampler2DArray u_image;
+uniform int u_layer;
 uniform bool u_horizontal;
 uniform float u_scale;
 uniform float u_light_size;
@@ -34,7 +35,7 @@ const float[] weights_13 = float[](924.0 / 4096.0, 792.0 / 4096.0, 495.0 / 4096.
 #endif
 
 void main() {
-    vec3 result = texture(u_image, io_texture_coordinates).rgb * WEIGHTS[0];
+    vec3 result = texture(u_image, vec3(io_texture_coordinates, u_layer)).rgb * WEIGHTS[0];
     vec2 offset_vector = mix(vec2(0.0, 1.0), vec2(1.0, 0.0), u_horizontal);
     float angle = mix(0.0, interleaved_gradient_noise(), u_rotate_samples);
 	float rotation_cos = cos(angle);
@@ -45,8 +46,8 @@ void main() {
 	);
     for(int i = 1; i < WEIGHTS.length(); i++) {
         vec2 real_offset = offset_vector * float(i) / (WEIGHTS.length() - 1) * rotator * u_light_size * u_scale;
-        result += texture(u_image, io_texture_coordinates + real_offset).rgb * WEIGHTS[i];
-        result += texture(u_image, io_texture_coordinates - real_offset).rgb * WEIGHTS[i];
+        result += texture(u_image, vec3(io_texture_coordinates + real_offset, u_layer)).rgb * WEIGHTS[i];
+        result += texture(u_image, vec3(io_texture_coordinates - real_offset, u_layer)).rgb * WEIGHTS[i];
     }
     o_color = vec4(result, 1.0);
 }
@@ -1,9 +1,15 @@
 layout(location = 0) in vec3 i_position;
 layout(location = 2) in vec2 i_texture_coordinates;
 
-out vec2 io_texture_coordinates;
+uniform float u_uv_scale;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+layout(location = 0) out vec2 io_texture_coordinates;
 
 void main(){
-    io_texture_coordinates = i_texture_coordinates;
+    io_texture_coordinates = i_texture_coordinates * u_uv_scale;
     gl_Position = vec4(i_position, 1.0);
 }
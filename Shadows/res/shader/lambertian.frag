@@ -1,25 +1,231 @@
-in vec3 io_normal;
-in vec4 io_lvs_position;
+layout(location = 0) in vec3 io_normal;
+layout(location = 1) in vec3 io_ws_position;
+layout(location = 2) in float io_vs_depth;
+layout(location = 3) in vec3 io_diffuse_color;
 
+uniform sampler2DArray u_shadow_map;
+#ifdef VIRTUAL_SHADOW_MAP
+//the page table maps the virtual map's pages to pages of the physical texture
+uniform sampler2D u_physical_texture;
+uniform usampler2D u_page_table;
+uniform int u_page_count;
+uniform int u_physical_page_count;
+#endif
+uniform mat4 u_light_views[8];
+uniform mat4 u_light_projections[8];
+//the first element is the camera's near plane, the others are the far ends of the cascades
+uniform float u_split_distances[9];
+uniform int u_cascade_count;
+uniform float u_cascade_blend;
+//only the bottom left part of the shadow map is rendered when the resolution is lowered
+uniform float u_uv_scale;
+uniform float u_near_planes[8];
+uniform float u_far_planes[8];
+uniform float u_filter_reference_width;
 uniform float u_bias;
 uniform vec3 u_light_direction;
 uniform vec3 u_light_color;
-uniform vec3 u_diffuse_color;
+uniform sampler2D u_shadow_atlas;
+uniform vec2 u_viewport_size;
+//maps the log of the view space depth to the cluster's depth slice
+uniform float u_cluster_depth_scale;
+uniform float u_cluster_depth_bias;
+
+struct shadowed_light_type {
+	mat4 view_projection;
+	vec4 depth_row;
+	vec4 position_type;
+	vec4 direction_cos_angle;
+	vec4 color_range;
+	//uv offset and size in the atlas, zero size if the light has no tile
+	vec4 tile;
+	//x: bias, y: the point light's cube in the cube map array, z: the point light's filter radius
+	vec4 parameters;
+	//world space bounding sphere, only used by the light culling
+	vec4 bounds;
+};
+
+layout(std430, binding = 1) readonly buffer shadowed_light_buffer {
+	shadowed_light_type shadowed_lights[];
+};
+
+layout(std430, binding = 2) readonly buffer cluster_buffer {
+	//offset and count in the light index list
+	uvec2 clusters[];
+};
+
+layout(std430, binding = 3) readonly buffer light_index_buffer {
+	uint light_indices[];
+};
+
+const int LIGHT_TYPE_DIRECTIONAL = 0;
+const int LIGHT_TYPE_POINT = 2;
 
 out vec4 o_color;
 
 float bias;
+int cascade;
 
 float compute_shadow();
+float compute_point_shadow(vec3 to_fragment, int cube, float range, float bias, float filter_radius);
 
 float get_bias() {
 	return bias;
 }
 
+vec4 get_lvs_position() {
+	return u_light_views[cascade] * vec4(io_ws_position, 1.0);
+}
+
+vec2 get_shadow_map_uv(vec4 lvs_position) {
+	vec4 lcs_position = u_light_projections[cascade] * lvs_position;
+	return lcs_position.xy / lcs_position.w * 0.5 + 0.5;
+}
+
+float get_linear_depth(vec4 lvs_position) {
+	return (-lvs_position.z - u_near_planes[cascade]) / (u_far_planes[cascade] - u_near_planes[cascade]);
+}
+
+//the depth is linear, like an ortho projection's, even if the projection is warped, because the shadow pass writes it the same way
+vec3 get_shadow_map_coordinates() {
+	vec4 lvs_position = get_lvs_position();
+	return vec3(get_shadow_map_uv(lvs_position), get_linear_depth(lvs_position));
+}
+
+//a warped projection stretches texels unevenly, so the scale is measured at the receiver
+float get_world_to_uv_scale() {
+	const float step = 0.01;
+	vec4 lvs_position = get_lvs_position();
+	vec2 uv = get_shadow_map_uv(lvs_position);
+	vec2 x_step = get_shadow_map_uv(lvs_position + vec4(step, 0.0, 0.0, 0.0)) - uv;
+	vec2 y_step = get_shadow_map_uv(lvs_position + vec4(0.0, step, 0.0, 0.0)) - uv;
+	return sqrt(length(x_step) * length(y_step)) / step;
+}
+
+vec4 sample_shadow_map(vec2 uv) {
+	//the border has to be emulated, because the rendered part doesn't end at the texture's edge
+	if(any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0)))) {
+		return vec4(1.0);
+	}
+#ifdef VIRTUAL_SHADOW_MAP
+	vec2 page_position = uv * u_page_count;
+	uint page = texelFetch(u_page_table, min(ivec2(page_position), u_page_count - 1), 0).r;
+	//pages that aren't resident yet are lit
+	if(page == 0xFFFFFFFFu) {
+		return vec4(1.0);
+	}
+	vec2 physical_page = vec2(page & 0xFFFFu, page >> 16);
+	return texture(u_physical_texture, (physical_page + fract(page_position)) / u_physical_page_count);
+#else
+	return texture(u_shadow_map, vec3(uv * u_uv_scale, cascade));
+#endif
+}
+
+float get_filter_scale() {
+	return get_world_to_uv_scale() * u_filter_reference_width;
+}
+
+float get_near_plane() {
+	return u_near_planes[cascade];
+}
+
+float get_far_plane() {
+	return u_far_planes[cascade];
+}
+
+int select_cascade() {
+	for(int i = 0; i < u_cascade_count - 1; i++) {
+		if(io_vs_depth < u_split_distances[i + 1]) {
+			return i;
+		}
+	}
+	return u_cascade_count - 1;
+}
+
+float compute_cascaded_shadow() {
+	cascade = select_cascade();
+	float shadow = compute_shadow();
+	if(cascade == u_cascade_count - 1) {
+		return shadow;
+	}
+	//the end of each cascade is blended with the next one, which also covers this band
+	float split_near = u_split_distances[cascade];
+	float split_far = u_split_distances[cascade + 1];
+	float blend_start = split_far - u_cascade_blend * (split_far - split_near);
+	if(io_vs_depth <= blend_start) {
+		return shadow;
+	}
+	cascade++;
+	float next_shadow = compute_shadow();
+	return mix(shadow, next_shadow, (io_vs_depth - blend_start) / (split_far - blend_start));
+}
+
+float compute_shadowed_light_shadow(shadowed_light_type shadowed_light) {
+	if(int(shadowed_light.position_type.w) == LIGHT_TYPE_POINT) {
+		int cube = int(shadowed_light.parameters.y);
+		return cube < 0 ? 1.0 : compute_point_shadow(io_ws_position - shadowed_light.position_type.xyz, cube, shadowed_light.color_range.w, shadowed_light.parameters.x, shadowed_light.parameters.z);
+	}
+	if(shadowed_light.tile.z == 0.0) {
+		return 1.0;
+	}
+	vec4 lcs_position = shadowed_light.view_projection * vec4(io_ws_position, 1.0);
+	vec2 uv = lcs_position.xy / lcs_position.w * 0.5 + 0.5;
+	if(lcs_position.w <= 0.0 || any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0)))) {
+		return 1.0;
+	}
+	float depth = dot(shadowed_light.depth_row, vec4(io_ws_position, 1.0));
+	//3x3 pcf, the samples are clamped to the tile, so they don't read the neighboring tiles
+	vec2 texel_size = 1.0 / vec2(textureSize(u_shadow_atlas, 0));
+	vec2 tile_min = shadowed_light.tile.xy + 0.5 * texel_size;
+	vec2 tile_max = shadowed_light.tile.xy + shadowed_light.tile.zw - 0.5 * texel_size;
+	float result = 0.0;
+	for(int i = -1; i <= 1; i++) {
+		for(int j = -1; j <= 1; j++) {
+			vec2 atlas_uv = clamp(shadowed_light.tile.xy + uv * shadowed_light.tile.zw + vec2(i, j) * texel_size, tile_min, tile_max);
+			float blocker_depth = texture(u_shadow_atlas, atlas_uv).r;
+			result += depth > blocker_depth + shadowed_light.parameters.x ? 0.0 : 1.0;
+		}
+	}
+	return result / 9.0;
+}
+
+vec3 compute_shadowed_light(shadowed_light_type shadowed_light, vec3 normal) {
+	vec3 light_direction = -shadowed_light.direction_cos_angle.xyz;
+	float attenuation = 1.0;
+	if(int(shadowed_light.position_type.w) != LIGHT_TYPE_DIRECTIONAL) {
+		vec3 to_light = shadowed_light.position_type.xyz - io_ws_position;
+		float distance = length(to_light);
+		light_direction = to_light / distance;
+		float cos_angle = dot(-light_direction, shadowed_light.direction_cos_angle.xyz);
+		float cos_outer_angle = shadowed_light.direction_cos_angle.w;
+		attenuation = clamp(1.0 - distance / shadowed_light.color_range.w, 0.0, 1.0);
+		if(int(shadowed_light.position_type.w) != LIGHT_TYPE_POINT) {
+			attenuation *= smoothstep(cos_outer_angle, mix(cos_outer_angle, 1.0, 0.2), cos_angle);
+		}
+	}
+	float lambert = max(dot(normal, light_direction), 0.0) * attenuation;
+	if(lambert == 0.0) {
+		return vec3(0.0);
+	}
+	return io_diffuse_color * shadowed_light.color_range.rgb * lambert * compute_shadowed_light_shadow(shadowed_light);
+}
+
+int get_cluster() {
+	ivec2 tile = ivec2(gl_FragCoord.xy / u_viewport_size * vec2(CLUSTER_COUNT_X, CLUSTER_COUNT_Y));
+	int slice = int(log(io_vs_depth) * u_cluster_depth_scale + u_cluster_depth_bias);
+	ivec3 cluster = clamp(ivec3(tile, slice), ivec3(0), ivec3(CLUSTER_COUNT_X - 1, CLUSTER_COUNT_Y - 1, CLUSTER_COUNT_Z - 1));
+	return (cluster.z * CLUSTER_COUNT_Y + cluster.y) * CLUSTER_COUNT_X + cluster.x;
+}
+
 void main() {
 	vec3 normal = normalize(io_normal);
 	vec3 light_direction = -normalize(u_light_direction);
 	bias = (1.0 - dot(normal, light_direction)) * u_bias;
-	float shadow = compute_shadow();
-	o_color = vec4(vec3(0.1), 1.0) + vec4(u_diffuse_color * dot(normal, light_direction) * u_light_color, 1.0) * shadow;
+	float shadow = compute_cascaded_shadow();
+	o_color = vec4(vec3(0.1), 1.0) + vec4(io_diffuse_color * dot(normal, light_direction) * u_light_color, 1.0) * shadow;
+	//only the lights reaching the fragment's cluster are evaluated
+	uvec2 light_list = clusters[get_cluster()];
+	for(uint i = 0u; i < light_list.y; i++) {
+		o_color.rgb += compute_shadowed_light(shadowed_lights[light_indices[light_list.x + i]], normal);
+	}
 }
@@ -1,20 +1,45 @@
-in vec3 i_position;
-in vec3 i_normal;
+layout(location = 0) in vec3 i_position;
+layout(location = 1) in vec3 i_normal;
 
+#ifdef SCENE_INSTANCES
+bool get_scene_instance(out mat4 object, out vec3 color);
+
+uniform mat4 u_dequantization;
+#else
 uniform mat4 u_model;
+uniform mat4 u_normal_matrix;
+uniform vec3 u_diffuse_color;
+#endif
 uniform mat4 u_view;
 uniform mat4 u_projection;
-uniform mat4 u_light_view;
-uniform mat4 u_light_projection;
 
-out vec3 io_normal;
-out vec4 io_lvs_position;
-out vec4 io_lcs_position;
+out gl_PerVertex {
+	vec4 gl_Position;
+};
+
+layout(location = 0) out vec3 io_normal;
+layout(location = 1) out vec3 io_ws_position;
+layout(location = 2) out float io_vs_depth;
+layout(location = 3) out vec3 io_diffuse_color;
 
 void main(){
-	vec3 ws_position = vec3(u_model * vec4(i_position, 1.0));
-	gl_Position = u_projection * u_view * vec4(ws_position, 1.0);
-	io_normal = mat3(inverse(transpose(u_model))) * i_normal;
-	io_lvs_position = u_light_view * vec4(ws_position, 1.0);
-	io_lcs_position = u_light_projection * io_lvs_position;
+#ifdef SCENE_INSTANCES
+	mat4 object;
+	if(!get_scene_instance(object, io_diffuse_color)) {
+		//outside of the clip volume, so the triangles are dropped
+		gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+		return;
+	}
+	mat4 model = object * u_dequantization;
+	mat3 normal_matrix = transpose(inverse(mat3(object)));
+#else
+	mat4 model = u_model;
+	mat3 normal_matrix = mat3(u_normal_matrix);
+	io_diffuse_color = u_diffuse_color;
+#endif
+	io_ws_position = vec3(model * vec4(i_position, 1.0));
+	vec4 vs_position = u_view * vec4(io_ws_position, 1.0);
+	gl_Position = u_projection * vs_position;
+	io_normal = normal_matrix * i_normal;
+	io_vs_depth = -vs_position.z;
 }
@@ -1,6 +1,3 @@
-in vec4 io_lcs_position;
-
-uniform sampler2D u_shadow_map;
 uniform float u_intensity;
 uniform float u_light_size;
 uniform int u_kernel_size;
@@ -9,6 +6,9 @@ uniform bool u_rotate_samples;
 uniform float u_scale;
 
 float get_bias();
+vec3 get_shadow_map_coordinates();
+vec4 sample_shadow_map(vec2 uv);
+float get_filter_scale();
 vec2[25] get_poisson_25();
 vec2[32] get_poisson_32();
 vec2[64] get_poisson_64();
@@ -34,8 +34,7 @@ vec2 vogel_disk_sample(int sample_index, int samples_count, float angle);
 #endif
 
 float compute_shadow() {
-	vec3 uv = io_lcs_position.xyz / io_lcs_position.w;
-	uv = uv * 0.5 + 0.5;
+	vec3 uv = get_shadow_map_coordinates();
 	float real_depth = uv.z;
 	if(real_depth > 1.0) {
 		return 1.0;
@@ -53,8 +52,8 @@ float compute_shadow() {
 	const int subtract = u_kernel_size / 2;
 	for(int i = 0; i < u_kernel_size; i++){
 		for(int j = 0; j < u_kernel_size; j++){
-			vec2 offset = vec2(i - subtract, j - subtract) / u_kernel_size * rotator * u_light_size * u_scale;
-			float depth = texture(u_shadow_map, uv.xy + offset).r + get_bias();
+			vec2 offset = vec2(i - subtract, j - subtract) / u_kernel_size * rotator * u_light_size * u_scale * get_filter_scale();
+			float depth = sample_shadow_map(uv.xy + offset).r + get_bias();
 			result += mix(u_intensity, 1.0, depth > real_depth);
 		}
 	}
@@ -62,15 +61,15 @@ float compute_shadow() {
 #elif SAMPLING_MODE_POISSON
     vec2[POISSON_SIZE] poisson = POISSON();
 	for(int i = 0; i < poisson.length(); i++) {
-		vec2 offset = poisson[i] * rotator * u_light_size * u_scale;
-		float depth = texture(u_shadow_map, uv.xy + offset).r + get_bias();
+		vec2 offset = poisson[i] * rotator * u_light_size * u_scale * get_filter_scale();
+		float depth = sample_shadow_map(uv.xy + offset).r + get_bias();
 		result += mix(u_intensity, 1.0, depth > real_depth);
 	}
 	return result / poisson.length();
 #elif SAMPLING_MODE_VOGEL
 	for(int i = 0; i < u_vogel_sample_count; i++) {
-		vec2 offset = vogel_disk_sample(i, u_vogel_sample_count, angle) * u_light_size * u_scale;
-		float depth = texture(u_shadow_map, uv.xy + offset).r + get_bias();
+		vec2 offset = vogel_disk_sample(i, u_vogel_sample_count, angle) * u_light_size * u_scale * get_filter_scale();
+		float depth = sample_shadow_map(uv.xy + offset).r + get_bias();
 		result += mix(u_intensity, 1.0, depth > real_depth);
 	}
 	return result / u_vogel_sample_count;
@@ -1,18 +1,17 @@
-in vec4 io_lvs_position;
-in vec4 io_lcs_position;
-
-uniform sampler2D u_shadow_map;
 uniform float u_intensity;
 uniform float u_light_size;
 uniform int u_kernel_size;
 uniform int u_vogel_sample_count;
 uniform bool u_rotate_samples;
 uniform float u_scale;
-uniform float u_near_plane;
-uniform float u_far_plane;
-uniform float u_frustum_width;
 
 float get_bias();
+vec4 get_lvs_position();
+vec3 get_shadow_map_coordinates();
+vec4 sample_shadow_map(vec2 uv);
+float get_near_plane();
+float get_far_plane();
+float get_world_to_uv_scale();
 vec2[25] get_poisson_25();
 vec2[32] get_poisson_32();
 vec2[64] get_poisson_64();
@@ -38,13 +37,12 @@ vec2 vogel_disk_sample(int sample_index, int samples_count, float angle);
 #endif
 
 float compute_search_region_radius() {
-	float lvs_distance = -io_lvs_position.z;
-	return (lvs_distance - u_near_plane) / lvs_distance * u_light_size / u_frustum_width;
+	float lvs_distance = -get_lvs_position().z;
+	return (lvs_distance - get_near_plane()) / lvs_distance * u_light_size * get_world_to_uv_scale();
 }
 
 float compute_average_blocker_depth(float search_region_radius){
-	vec3 uv = io_lcs_position.xyz / io_lcs_position.w;
-	uv = uv * 0.5 + 0.5;
+	vec3 uv = get_shadow_map_coordinates();
 	float real_depth = uv.z;
 	int blocker_count = 0;
 	float blocker_depth_sum = 0;
@@ -64,7 +62,7 @@ float compute_average_blocker_depth(float search_region_radius){
 	for(int i = 0; i < u_kernel_size; i++){
 		for(int j = 0; j < u_kernel_size; j++){
 			vec2 offset = vec2(i - subtract, j - subtract) / u_kernel_size * rotator * search_region_radius;
-			float depth = texture(u_shadow_map, uv.xy + offset).r + get_bias();
+			float depth = sample_shadow_map(uv.xy + offset).r + get_bias();
 			blocker_count = mix(blocker_count, blocker_count + 1, depth < real_depth);
 			blocker_depth_sum = mix(blocker_depth_sum, blocker_depth_sum + depth, depth < real_depth);
 		}
@@ -73,14 +71,14 @@ float compute_average_blocker_depth(float search_region_radius){
     vec2[POISSON_SIZE] poisson = POISSON();
 	for(int i = 0; i< poisson.length(); i++) {
 		vec2 offset = poisson[i] * rotator * search_region_radius;
-		float depth = texture(u_shadow_map, uv.xy + offset).r + get_bias();
+		float depth = sample_shadow_map(uv.xy + offset).r + get_bias();
 		blocker_count = mix(blocker_count, blocker_count + 1, depth < real_depth);
 		blocker_depth_sum = mix(blocker_depth_sum, blocker_depth_sum + depth, depth < real_depth);
 	}
 #elif SAMPLING_MODE_VOGEL
 	for(int i = 0; i< u_vogel_sample_count; i++) {
 		vec2 offset = vogel_disk_sample(i, u_vogel_sample_count, angle) * search_region_radius;
-		float depth = texture(u_shadow_map, uv.xy + offset).r + get_bias();
+		float depth = sample_shadow_map(uv.xy + offset).r + get_bias();
 		blocker_count = mix(blocker_count, blocker_count + 1, depth < real_depth);
 		blocker_depth_sum = mix(blocker_depth_sum, blocker_depth_sum + depth, depth < real_depth);
 	}
@@ -89,20 +87,16 @@ float compute_average_blocker_depth(float search_region_radius){
 }
 
 float compute_blocker_distance(float average_blocker_depth) {
-    return average_blocker_depth * (u_far_plane - u_near_plane) + u_near_plane;
+    return average_blocker_depth * (get_far_plane() - get_near_plane()) + get_near_plane();
 }
 
 float compute_penumbra_radius(float blocker_distance) {
-	float lvs_distance = -io_lvs_position.z;
-
-	vec3 uv = io_lcs_position.xyz / io_lcs_position.w;
-	uv = uv * 0.5 + 0.5;
-	return (lvs_distance - blocker_distance) / blocker_distance * u_light_size / u_frustum_width;
+	float lvs_distance = -get_lvs_position().z;
+	return (lvs_distance - blocker_distance) / blocker_distance * u_light_size * get_world_to_uv_scale();
 }
 
 float compute_pcss(float pcf_radius) {
-	vec3 uv = io_lcs_position.xyz / io_lcs_position.w;
-	uv = uv * 0.5 + 0.5;
+	vec3 uv = get_shadow_map_coordinates();
 	float real_depth = uv.z;
 	float result = 0.0;
 	float angle = mix(0.0, interleaved_gradient_noise(), u_rotate_samples);
@@ -118,7 +112,7 @@ float compute_pcss(float pcf_radius) {
 	for(int i = 0; i < u_kernel_size; i++){
 		for(int j = 0; j < u_kernel_size; j++){
 			vec2 offset = vec2(i - subtract, j - subtract) / u_kernel_size * rotator * pcf_radius * u_scale;
-			float depth = texture(u_shadow_map, uv.xy + offset).r + get_bias();
+			float depth = sample_shadow_map(uv.xy + offset).r + get_bias();
 			result += mix(u_intensity, 1.0, depth > real_depth);
 		}
 	}
@@ -127,14 +121,14 @@ float compute_pcss(float pcf_radius) {
     vec2[POISSON_SIZE] poisson = POISSON();
 	for(int i = 0; i < poisson.length(); i++) {
 		vec2 offset = poisson[i] * rotator * pcf_radius * u_scale;
-		float depth = texture(u_shadow_map, uv.xy + offset).r + get_bias();
+		float depth = sample_shadow_map(uv.xy + offset).r + get_bias();
 		result += mix(u_intensity, 1.0, depth > real_depth);
 	}
 	return result / poisson.length();
 #elif SAMPLING_MODE_VOGEL
 	for(int i = 0; i < u_vogel_sample_count; i++) {
 		vec2 offset = vogel_disk_sample(i, u_vogel_sample_count, angle) * pcf_radius * u_scale;
-		float depth = texture(u_shadow_map, uv.xy + offset).r + get_bias();
+		float depth = sample_shadow_map(uv.xy + offset).r + get_bias();
 		result += mix(u_intensity, 1.0, depth > real_depth);
 	}
 	return result / u_vogel_sample_count;
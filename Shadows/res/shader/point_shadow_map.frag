@@ -0,0 +1,75 @@
+uniform samplerCubeArray u_point_shadow_maps;
+uniform int u_kernel_size;
+uniform int u_vogel_sample_count;
+uniform bool u_rotate_samples;
+
+vec2[25] get_poisson_25();
+vec2[32] get_poisson_32();
+vec2[64] get_poisson_64();
+vec2[128] get_poisson_128();
+float interleaved_gradient_noise();
+vec2 vogel_disk_sample(int sample_index, int samples_count, float angle);
+
+#ifdef POISSON_25
+	#define POISSON_SIZE 25
+	#define POISSON() get_poisson_25()
+#elif POISSON_32
+	#define POISSON_SIZE 32
+	#define POISSON() get_poisson_32()
+#elif POISSON_64
+	#define POISSON_SIZE 64
+	#define POISSON() get_poisson_64()
+#elif POISSON_128
+	#define POISSON_SIZE 128
+	#define POISSON() get_poisson_128()
+#else
+	#define POISSON_SIZE 25
+	#define POISSON() get_poisson_25()
+#endif
+
+float sample_point_shadow_map(vec3 to_fragment, int cube, float real_depth, float bias) {
+	float depth = texture(u_point_shadow_maps, vec4(to_fragment, cube)).r + bias;
+	return depth > real_depth ? 1.0 : 0.0;
+}
+
+//the 2d kernels are laid on the plane perpendicular to the light's direction, so they work on every face and across the edges
+float compute_point_shadow(vec3 to_fragment, int cube, float range, float bias, float filter_radius) {
+	float real_depth = length(to_fragment) / range;
+	if(real_depth > 1.0) {
+		return 1.0;
+	}
+#if defined(SAMPLING_MODE_GRID) || defined(SAMPLING_MODE_POISSON) || defined(SAMPLING_MODE_VOGEL)
+	vec3 direction = to_fragment / length(to_fragment);
+	vec3 tangent = normalize(cross(direction, abs(direction.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0)));
+	vec3 bitangent = cross(direction, tangent);
+	float result = 0.0;
+	float angle = mix(0.0, interleaved_gradient_noise(), u_rotate_samples);
+	mat2 rotator = mat2(cos(angle), sin(angle), -sin(angle), cos(angle));
+#endif
+
+#ifdef SAMPLING_MODE_GRID
+	const int subtract = u_kernel_size / 2;
+	for(int i = 0; i < u_kernel_size; i++){
+		for(int j = 0; j < u_kernel_size; j++){
+			vec2 offset = vec2(i - subtract, j - subtract) / u_kernel_size * rotator * filter_radius;
+			result += sample_point_shadow_map(to_fragment + tangent * offset.x + bitangent * offset.y, cube, real_depth, bias);
+		}
+	}
+	return result / (u_kernel_size * u_kernel_size);
+#elif SAMPLING_MODE_POISSON
+	vec2[POISSON_SIZE] poisson = POISSON();
+	for(int i = 0; i < poisson.length(); i++) {
+		vec2 offset = poisson[i] * rotator * filter_radius;
+		result += sample_point_shadow_map(to_fragment + tangent * offset.x + bitangent * offset.y, cube, real_depth, bias);
+	}
+	return result / poisson.length();
+#elif SAMPLING_MODE_VOGEL
+	for(int i = 0; i < u_vogel_sample_count; i++) {
+		vec2 offset = vogel_disk_sample(i, u_vogel_sample_count, angle) * filter_radius;
+		result += sample_point_shadow_map(to_fragment + tangent * offset.x + bitangent * offset.y, cube, real_depth, bias);
+	}
+	return result / u_vogel_sample_count;
+#else
+	return sample_point_shadow_map(to_fragment, cube, real_depth, bias);
+#endif
+}
@@ -0,0 +1,49 @@
+//an instance of a loaded scene file, the same layout as the file's records
+struct scene_instance_type {
+	float position[3];
+	float rotation[4];
+	float scale[3];
+	uint color;
+	uint flags;
+	uint mesh;
+	int mesh_instance;
+};
+
+//the meshlet culling's bindings are free while drawing
+layout(std430, binding = 5) readonly buffer scene_instance_buffer {
+	scene_instance_type scene_instances[];
+};
+
+//the instance indices sorted by mesh, a draw's base instance is the start of its range
+layout(std430, binding = 6) readonly buffer scene_index_buffer {
+	uint scene_indices[];
+};
+
+#define SCENE_INSTANCE_FLAG_EDITED 4u
+
+//the drawn instance of the asset, and its transform relative to the scene instance
+uniform int u_mesh_instance;
+uniform mat4 u_instance_transform;
+
+bool get_scene_instance(out mat4 object, out vec3 color) {
+	scene_instance_type instance = scene_instances[scene_indices[gl_BaseInstance + gl_InstanceID]];
+	vec4 q = vec4(instance.rotation[0], instance.rotation[1], instance.rotation[2], instance.rotation[3]);
+	vec3 scale = vec3(instance.scale[0], instance.scale[1], instance.scale[2]);
+	mat3 rotation = mat3(
+		1.0 - 2.0 * (q.y * q.y + q.z * q.z), 2.0 * (q.x * q.y + q.w * q.z), 2.0 * (q.x * q.z - q.w * q.y),
+		2.0 * (q.x * q.y - q.w * q.z), 1.0 - 2.0 * (q.x * q.x + q.z * q.z), 2.0 * (q.y * q.z + q.w * q.x),
+		2.0 * (q.x * q.z + q.w * q.y), 2.0 * (q.y * q.z - q.w * q.x), 1.0 - 2.0 * (q.x * q.x + q.y * q.y)
+	);
+	object = mat4(
+		vec4(rotation[0] * scale.x, 0.0),
+		vec4(rotation[1] * scale.y, 0.0),
+		vec4(rotation[2] * scale.z, 0.0),
+		vec4(instance.position[0], instance.position[1], instance.position[2], 1.0)
+	);
+	//an instance placing the whole asset is relative to the asset's instances, a single one is already placed
+	if(instance.mesh_instance == -1) {
+		object = object * u_instance_transform;
+	}
+	color = unpackUnorm4x8(instance.color).rgb;
+	return (instance.flags & SCENE_INSTANCE_FLAG_EDITED) == 0u && (instance.mesh_instance == -1 || instance.mesh_instance == u_mesh_instance);
+}
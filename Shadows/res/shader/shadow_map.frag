@@ -1,5 +1,11 @@
+layout(location = 0) in float io_depth;
+
 out vec4 o_color;
 
 void main(){
-	o_color = vec4(gl_FragCoord.z, 0.0, 0.0, 1.0);
+#ifdef WARPED_DEPTH
+	//the warped depth isn't linear, the receivers compare against linear depth
+	gl_FragDepth = io_depth;
+#endif
+	o_color = vec4(clamp(io_depth, 0.0, 1.0), 0.0, 0.0, 1.0);
 }
@@ -1,9 +1,67 @@
-in vec3 i_position;
+#ifdef VERTEX_SHADER_LAYER
+#extension GL_ARB_shader_viewport_layer_array : require
+#endif
 
-uniform mat4 u_model;
-uniform mat4 u_view;
-uniform mat4 u_projection;
+layout(location = 0) in vec3 i_position;
+
+#ifdef SCENE_INSTANCES
+bool get_scene_instance(out mat4 object, out vec3 color);
+
+uniform mat4 u_dequantization;
+//the instances of a loaded scene are drawn into one layer at a time
+uniform int u_layer;
+#else
+struct draw_type {
+	mat4 model;
+	int first_layer;
+};
+
+layout(std430, binding = 0) readonly buffer draw_buffer {
+	draw_type draws[];
+};
+#endif
+
+#ifdef SHADOW_ATLAS
+//the views are atlas tiles, selected by the viewport index instead of the layer
+#define VIEW_COUNT 16
+#else
+#define VIEW_COUNT 8
+#endif
+
+uniform mat4 u_view_projections[VIEW_COUNT];
+//maps a world space position to the linear depth in the light's view space
+uniform vec4 u_depth_rows[VIEW_COUNT];
+
+out gl_PerVertex {
+	vec4 gl_Position;
+};
+
+layout(location = 0) out float io_depth;
+#ifndef VERTEX_SHADER_LAYER
+layout(location = 1) flat out int io_layer;
+#endif
 
 void main() {
-	gl_Position = u_projection * u_view * u_model * vec4(i_position, 1.0);
+#ifdef SCENE_INSTANCES
+	int layer = u_layer;
+	mat4 object;
+	vec3 color;
+	bool visible = get_scene_instance(object, color);
+	vec4 ws_position = object * u_dequantization * vec4(i_position, 1.0);
+	//outside of the clip volume, so the triangles are dropped
+	gl_Position = visible ? u_view_projections[layer] * ws_position : vec4(0.0, 0.0, 2.0, 1.0);
+#else
+	draw_type draw = draws[gl_BaseInstance];
+	int layer = draw.first_layer + gl_InstanceID;
+	vec4 ws_position = draw.model * vec4(i_position, 1.0);
+	gl_Position = u_view_projections[layer] * ws_position;
+#endif
+	io_depth = dot(u_depth_rows[layer], ws_position);
+#if defined(VERTEX_SHADER_LAYER) && defined(SHADOW_ATLAS)
+	gl_ViewportIndex = layer;
+#elif defined(VERTEX_SHADER_LAYER)
+	gl_Layer = layer;
+#else
+	io_layer = layer;
+#endif
 }
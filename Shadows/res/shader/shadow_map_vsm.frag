@@ -1,7 +1,12 @@
+layout(location = 0) in float io_depth;
+
 out vec4 o_color;
 
 void main(){
-    float depth = gl_FragCoord.z;
+#ifdef WARPED_DEPTH
+    gl_FragDepth = io_depth;
+#endif
+    float depth = clamp(io_depth, 0.0, 1.0);
     float depth_squared = depth * depth;
     o_color = vec4(depth, depth_squared, 0.0, 1.0);
-}
\ No newline at end of file
+}
@@ -0,0 +1,41 @@
+layout(location = 0) in vec3 i_position;
+
+struct draw_type {
+	mat4 model;
+	//relative to the virtual map's origin
+	ivec2 virtual_page;
+	ivec2 physical_page;
+};
+
+layout(std430, binding = 0) readonly buffer draw_buffer {
+	draw_type draws[];
+};
+
+uniform mat4 u_view_projection;
+//maps a world space position to the linear depth in the light's view space
+uniform vec4 u_depth_row;
+uniform int u_page_count;
+uniform int u_physical_page_count;
+
+out gl_PerVertex {
+	vec4 gl_Position;
+	float gl_ClipDistance[4];
+};
+
+layout(location = 0) out float io_depth;
+
+void main() {
+	draw_type draw = draws[gl_BaseInstance];
+	vec4 ws_position = draw.model * vec4(i_position, 1.0);
+	//the projection is ortho, so w is 1 and the page position is linear across the triangle
+	vec4 cs_position = u_view_projection * ws_position;
+	vec2 page_position = (cs_position.xy * 0.5 + 0.5) * u_page_count - vec2(draw.virtual_page);
+	//everything outside the page is clipped, it would be drawn into the neighboring physical pages
+	gl_ClipDistance[0] = page_position.x;
+	gl_ClipDistance[1] = 1.0 - page_position.x;
+	gl_ClipDistance[2] = page_position.y;
+	gl_ClipDistance[3] = 1.0 - page_position.y;
+	vec2 physical_position = (vec2(draw.physical_page) + page_position) / u_physical_page_count;
+	gl_Position = vec4(physical_position * 2.0 - 1.0, cs_position.z, 1.0);
+	io_depth = dot(u_depth_row, ws_position);
+}
@@ -1,18 +1,17 @@
-in vec4 io_lcs_position;
-
-uniform sampler2D u_shadow_map;
 uniform float u_intensity;
 uniform bool u_smoothstep_fix;
 uniform float u_smoothstep_fix_lower_bound;
 
+vec3 get_shadow_map_coordinates();
+vec4 sample_shadow_map(vec2 uv);
+
 float compute_shadow(){
-	vec3 uv = io_lcs_position.xyz / io_lcs_position.w;
-    uv = uv * 0.5 + 0.5;
+	vec3 uv = get_shadow_map_coordinates();
     float real_depth = uv.z;
 	if(real_depth > 1.0) {
 		return 1.0;
 	}
-    vec2 moments = texture(u_shadow_map, uv.xy).xy;
+    vec2 moments = sample_shadow_map(uv.xy).xy;
 	float variance = moments.y - (moments.x * moments.x);
 	variance = max(variance, 0.00002);
 	float d = real_depth - moments.x;